@@ -0,0 +1,37 @@
+#ifndef ALLDIFF_H
+#define ALLDIFF_H
+
+#include "colors.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Cell of a matching left without a color */
+#define ALLDIFF_UNMATCHED (-1)
+
+/**
+ * @brief Enforces the all-different constraint of a subgrid completely
+ * (Régin's filtering): removes every color of a cell that cannot be part of
+ * an assignment of distinct colors to all the cells.
+ *
+ * The cells and their colors form a bipartite graph. A maximum matching is
+ * found with Hopcroft-Karp, starting from the previous matching of the same
+ * subgrid (its edges still in the graph are kept, only the cells they leave
+ * free are augmented). A color is kept in a cell only if it is matched to it
+ * or if both colors lie in the same strongly connected component of the
+ * graph of the colors (color c pointing to the colors of the cell matched to
+ * c), i.e. on an alternating cycle.
+ *
+ * @param subgrid The subgrid to filter.
+ * @param size The size of the subgrid (as many colors as cells).
+ * @param matching The color matched to each cell (or ALLDIFF_UNMATCHED),
+ * used as a starting point and updated; any content is valid.
+ * @param eliminations Incremented by the number of colors removed.
+ * @return subgrid_changed if colors were removed, subgrid_unchanged if not,
+ * subgrid_inconsistent if the cells cannot all get distinct colors (the
+ * subgrid is then left unchanged).
+ */
+subgrid_status_t alldiff_filter(colors_t* subgrid[], const size_t size,
+                                int8_t matching[], size_t* eliminations);
+
+#endif /* ALLDIFF_H */
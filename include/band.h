@@ -0,0 +1,59 @@
+#ifndef BAND_H
+#define BAND_H
+
+#include "grid.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Cells of a 9x9 grid in the line form of band_solve_line() */
+#define BAND_CELLS 81
+
+/**
+ * @brief Solves a 9x9 grid with the band engine, the fastest one on 9x9 grids.
+ *
+ * The board is one 128-bit vector per color, each 32-bit lane holding the
+ * cells of one band (three rows, 27 cells) where the color is still possible.
+ * Placing a color is a handful of vector operations with a precomputed mask
+ * of the peers of the cell. Propagation runs each rule once the previous ones
+ * are stuck, until nothing changes:
+ * - naked singles, from the cells found in at least one and in at least two
+ *   colors, all bands at once;
+ * - hidden singles, from the places of each color in each unit;
+ * - locked candidates inside each band, looked up in a table from the
+ *   occupied mini-rows (the three cells of a row in a block) of a color.
+ * The search branches on a cell with two colors when there is one, on a cell
+ * with the fewest colors otherwise. Its whole state (160 bytes) is copied on
+ * the stack at each branch, nothing is allocated during the search.
+ *
+ * @param grid The grid to solve, left unchanged.
+ * @param mode mode_first to stop at the first solution, mode_all to hand every
+ * solution to grid_report_solution().
+ * @param solution_count Incremented for each solution found.
+ * @return A new grid holding the solution in mode_first, NULL if there is none
+ * or in mode_all.
+ */
+grid_t* band_solver(grid_t* grid, _mode_t mode, size_t* solution_count);
+
+/**
+ * @brief Checks if a grid fits the band engine (a 9x9 grid).
+ * @param grid The grid to check.
+ * @return true if band_solver() can solve the grid, false otherwise.
+ */
+bool band_accepts(const grid_t* grid);
+
+/**
+ * @brief Solves a 9x9 grid given on one line, without going through a grid_t:
+ * the bulk path for large sets of grids.
+ *
+ * @param puzzle BAND_CELLS characters, row by row: '1' to '9' for the given
+ * cells, any other character for the empty ones.
+ * @param solution Receives the first solution (BAND_CELLS characters, not
+ * terminated) when there is one, may be NULL.
+ * @param limit Number of solutions after which the search stops (1 to solve,
+ * 2 to check for a unique solution).
+ * @return The number of solutions found, at most limit.
+ */
+size_t band_solve_line(const char* puzzle, char* solution, size_t limit);
+
+#endif /* BAND_H */
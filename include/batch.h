@@ -0,0 +1,51 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Grids solved side by side, one per 32-bit lane of a vector: 4, 8 or 16,
+ * by default as many as a vector register of the target holds */
+#ifndef BATCH_LANES
+#if defined(__AVX512F__)
+#define BATCH_LANES 16
+#elif defined(__AVX2__)
+#define BATCH_LANES 8
+#else
+#define BATCH_LANES 4
+#endif
+#endif
+
+/**
+ * @brief Checks if grids of the given size can be solved in batches.
+ * @param size The size of the grids.
+ * @return true for 4x4, 9x9 and 16x16 grids, false otherwise.
+ */
+bool batch_accepts(const size_t size);
+
+/**
+ * @brief Solves a batch of independent grids of the same size in lockstep.
+ *
+ * Each grid is a set of bitboards, one per color, and BATCH_LANES grids are
+ * loaded side by side in the lanes of vectors: one pass of propagation
+ * (naked and hidden singles, and locked candidates on 16x16 grids) runs the
+ * same vector operations on all of them at once. A lane that is solved, fails or has to branch is
+ * served on its own: it takes the next grid of the queue once its grid is
+ * done, and keeps the other branches of its search on a stack of its own.
+ *
+ * @param size The size of the grids (see batch_accepts()).
+ * @param count The number of grids.
+ * @param puzzles The grids, size * size characters each, one after the other:
+ * the characters of color_table for the given cells, any other one for the
+ * empty cells.
+ * @param solutions Receives the first solution of each grid, in the same
+ * layout (grids with no solution are left unchanged). May be NULL.
+ * @param counts Receives the number of solutions of each grid, at most limit.
+ * @param limit Number of solutions after which the search of a grid stops.
+ * @return true on success, false if the size is not supported or memory
+ * runs out.
+ */
+bool batch_solve(const size_t size, const size_t count, const char* puzzles,
+                 char* solutions, size_t counts[], const size_t limit);
+
+#endif /* BATCH_H */
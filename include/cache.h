@@ -0,0 +1,73 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "canon.h"
+#include "grid.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Grids of the same canonical form per set of the cache: the least recently
+ * used one of its set makes room for a new one */
+#define CACHE_WAYS 8
+
+/* Solution cache (forward declaration to hide the implementation) */
+typedef struct _cache_t cache_t;
+
+/**
+ * @brief Allocates a cache of the first solution of grids, shared by the
+ * threads that solve them. Grids are stored by canonical form (see canon.h):
+ * a grid hits the solution of any grid it is moved to by a symmetry, as well
+ * as the fact that it has no solution.
+ *
+ * There is one table per grid size, allocated on its first grid. With a path,
+ * the table of size N is mapped from the file 'PATH.N', created if need be,
+ * and its grids are kept from one run to the next: the file holds a table of
+ * the same number of entries, or it is cleared. A file another process is
+ * using, or that cannot be mapped, is left alone: its table is then kept in
+ * memory only.
+ *
+ * @param entries The number of grids kept per grid size, at least CACHE_WAYS.
+ * @param path The prefix of the files of the tables, NULL to keep them in
+ * memory only.
+ * @return A new cache, or NULL on failure.
+ */
+cache_t* cache_alloc(const size_t entries, const char* path);
+
+/**
+ * @brief Frees a cache, writing back its files.
+ * @param cache The cache to free.
+ */
+void cache_free(cache_t* cache);
+
+/**
+ * @brief Looks up a grid by its canonical form.
+ * @param cache The cache.
+ * @param canon The canonical form of the grid, and its transform.
+ * @param grid The grid.
+ * @param solution Receives the cached solution, moved back to the grid (owned
+ * by the caller), or NULL if the grid has no solution.
+ * @return true if the grid was found. A slot whose solution is not one of the
+ * grid (a damaged file) is freed, and the grid is not found.
+ */
+bool cache_lookup(cache_t* cache, const canon_t* canon, const grid_t* grid,
+                  grid_t** solution);
+
+/**
+ * @brief Stores the first solution of the grid of a canonical form.
+ * @param cache The cache.
+ * @param canon The canonical form of the grid, and its transform.
+ * @param solution The solution of the grid, NULL if it has none.
+ */
+void cache_store(cache_t* cache, const canon_t* canon,
+                 const grid_t* solution);
+
+/**
+ * @brief Prints the hits and misses of a cache.
+ * @param cache The cache.
+ * @param fd The file descriptor to print to.
+ */
+void cache_print(cache_t* cache, FILE* fd);
+
+#endif /* CACHE_H */
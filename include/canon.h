@@ -0,0 +1,78 @@
+#ifndef CANON_H
+#define CANON_H
+
+#include "grid.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Leaves of the search of canon_compute() after which it settles for the
+ * best one found */
+#define CANON_LEAVES_MAX 512
+
+/* Canonical form of a grid, and the transform from the grid to it */
+typedef struct {
+  size_t size;
+  bool transposed; /* The grid is transposed before rows and columns move */
+  bool exact;      /* The search completed: the form is the canonical one */
+  uint8_t rows[MAX_GRID_SIZE];    /* Row of the grid of each row of the form */
+  uint8_t columns[MAX_GRID_SIZE]; /* Same for the columns */
+  uint8_t colors[MAX_GRID_SIZE];  /* Color of the form of each color */
+  uint64_t hash;                  /* Of the form */
+  uint8_t form[MAX_GRID_SIZE * MAX_GRID_SIZE];
+} canon_t;
+
+/**
+ * @brief Computes the canonical form of a grid under the symmetries that keep
+ * its solutions: relabeling the colors, moving rows within their band and
+ * columns within their stack, moving bands and stacks, and transposing.
+ *
+ * Cells are one byte each, row by row: 0 for an empty cell, 1 + its color
+ * otherwise. The form is the smallest image of the grid, cell by cell, in an
+ * order that only depends on the grid up to these symmetries. It is searched
+ * by individualization and refinement: rows, columns and colors are split
+ * by what they hold until no two of them can be told apart, then one of a
+ * group that cannot be split is picked at a time, every pick being a branch.
+ * Empty rows, columns, bands and stacks that cannot be split are all alike,
+ * only the first one is picked. Past CANON_LEAVES_MAX leaves (grids with
+ * many symmetries), the form is the best leaf found: still an image of the
+ * grid, but equivalent grids may then get different forms.
+ *
+ * @param size The size of the grid.
+ * @param cells The cells of the grid.
+ * @param canon Receives the form, its hash and the transform.
+ * @return true if the form is the canonical one, false if the search was cut.
+ */
+bool canon_compute(const size_t size, const uint8_t* cells, canon_t* canon);
+
+/**
+ * @brief Computes the canonical form of a grid (see canon_compute()), its
+ * singletons being the given cells and the cells holding every color the
+ * empty ones.
+ * @param grid The grid.
+ * @param canon Receives the form, its hash and the transform (exact or not).
+ * @return true, or false if a cell holds neither one color nor all of them:
+ * such a grid has no form.
+ */
+bool canon_compute_grid(const grid_t* grid, canon_t* canon);
+
+/**
+ * @brief Moves cells the way the transform of canon moves the grid to its
+ * form, e.g. a solution of the grid to a solution of the form.
+ * @param canon The transform.
+ * @param cells The cells, in the layout of canon_compute().
+ * @param image Receives the moved cells.
+ */
+void canon_apply(const canon_t* canon, const uint8_t* cells, uint8_t* image);
+
+/**
+ * @brief Moves cells back the way canon_apply() moves them, e.g. a solution of
+ * the form to a solution of the grid.
+ * @param canon The transform.
+ * @param image The moved cells.
+ * @param cells Receives the cells.
+ */
+void canon_restore(const canon_t* canon, const uint8_t* image, uint8_t* cells);
+
+#endif /* CANON_H */
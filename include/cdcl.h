@@ -0,0 +1,40 @@
+#ifndef CDCL_H
+#define CDCL_H
+
+#include "grid.h"
+
+#include <stdio.h>
+
+/**
+ * @brief Solves the given grid with conflict-driven clause learning.
+ *
+ * The grid is encoded with one boolean variable per (cell, color) pair still
+ * possible after grid_heuristics(), constrained to exactly one true variable
+ * per cell and per (unit, color) pair. The "at least one" halves are clauses
+ * propagated with two watched literals, the "at most one" halves are enforced
+ * natively: setting a variable to true falsifies its peers. Conflicts are
+ * analyzed down to their first unique implication point, the learnt clause is
+ * minimized, and the search jumps back to its second highest decision level.
+ * Branching follows VSIDS (variables bumped at each conflict they take part
+ * in), with restarts following the Luby sequence and a periodic reduction of
+ * the learnt clauses.
+ *
+ * @param grid The grid to solve, left unchanged.
+ * @param mode mode_first to stop at the first solution, mode_all to hand every
+ * solution to grid_report_solution() (each one being blocked by a clause on its
+ * decisions).
+ * @param solution_count Incremented for each solution found.
+ * @return A new grid holding the solution in mode_first, NULL if there is none
+ * or in mode_all.
+ */
+grid_t* cdcl_solver(grid_t* grid, _mode_t mode, size_t* solution_count);
+
+/**
+ * @brief Prints the counters of the CDCL engine (conflicts, decisions,
+ * propagations, learnt clauses) accumulated over the grids solved by the
+ * calling thread.
+ * @param fd The file where the counters are printed.
+ */
+void cdcl_print_stats(FILE* fd);
+
+#endif /* CDCL_H */
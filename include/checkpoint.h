@@ -0,0 +1,63 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "grid.h"
+#include "libsudoku.h"
+
+#include <stdbool.h>
+
+/* Seconds between two checkpoints of a search, by default */
+#define CHECKPOINT_PERIOD 60
+
+/* Seconds between two progress lines on stderr */
+#define CHECKPOINT_PROGRESS 10
+
+/* Checkpoint of a dfs search (forward declaration to hide the
+ * implementation) */
+typedef struct _checkpoint_t checkpoint_t;
+
+/**
+ * @brief Starts checkpointing the next dfs search of the calling thread, in
+ * mode_all, to a file: written every few seconds, and when SIGINT or SIGTERM
+ * comes, which then stops the search (see grid_set_monitor()). Progress goes
+ * to stderr: the solutions per second, and the fraction of the search tree
+ * covered, as estimated from the candidates of the choices on the path.
+ *
+ * The file is text: the path of the search and the number of solutions
+ * reported, then the grid as printed by grid_print(). It is written to a
+ * temporary file moved over the previous one, after stdout is flushed: the
+ * solutions it counts are out. Solutions printed after the last checkpoint
+ * are printed again on resume if the process is killed otherwise.
+ *
+ * @param path The path of the file.
+ * @param seconds The seconds between two checkpoints, at least 1.
+ * @param grid The grid about to be solved, copied.
+ * @return A new checkpoint, or NULL on failure.
+ */
+checkpoint_t* checkpoint_alloc(const char* path, const unsigned seconds,
+                               const grid_t* grid);
+
+/**
+ * @brief Reads a checkpoint file and makes the next dfs search of the
+ * calling thread resume where it stopped (see grid_set_replay()), going on
+ * checkpointing to the same file (see checkpoint_alloc()).
+ * @param path The path of the file.
+ * @param seconds The seconds between two checkpoints, at least 1.
+ * @param context The parser of the grid, which keeps its error message.
+ * @param grid Receives the grid of the search (owned by the caller).
+ * @return A new checkpoint, or NULL if the file cannot be read.
+ */
+checkpoint_t* checkpoint_resume(const char* path, const unsigned seconds,
+                                sudoku_t* context, grid_t** grid);
+
+/**
+ * @brief Ends the checkpointing of a search once grid_solver() returns: the
+ * file of a search that went through is removed, and the signals are left to
+ * their default handling again.
+ * @param checkpoint The checkpoint, freed.
+ * @return true if the search went through, false if a signal stopped it and
+ * the file holds where it stopped.
+ */
+bool checkpoint_finish(checkpoint_t* checkpoint);
+
+#endif /* CHECKPOINT_H */
@@ -4,12 +4,43 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
+#ifdef COLORS_WIDE
+/* Two-word sets of colors for grids up to 100x100: the operations stay
+ * branch-free on pairs of 64-bit words. Smaller grids keep the default
+ * single-word build, the width is chosen at compile time. */
+#define MAX_COLORS 128
+
+__extension__ typedef unsigned __int128 colors_t;
+#else
 // Define the maximum color number
 #define MAX_COLORS 64
 
 // Define colors_t as uint64_t
 typedef uint64_t colors_t;
+#endif
+
+/* Outcome of the heuristics on a subgrid */
+typedef enum {
+  subgrid_unchanged,
+  subgrid_changed,
+  subgrid_inconsistent
+} subgrid_status_t;
+
+/* Heuristics of the subgrid pipeline, in their default order */
+typedef enum {
+  heuristic_cross_hatching,
+  heuristic_lone_number,
+  heuristic_naked_subset,
+  HEURISTICS_COUNT
+} heuristic_t;
+
+/* Order of the heuristics pipeline pinned by a thread, none when adaptive */
+typedef struct {
+  heuristic_t order[HEURISTICS_COUNT];
+  size_t count;
+} subgrid_pipeline_t;
 
 /**
  * @brief Set to '1' all bits within range from 0 to size and 'O' all others.
@@ -175,10 +206,68 @@ bool subgrid_consistency(colors_t* subgrid[], const size_t size);
 /**
  * @brief Applies heuristics to the given subgrid.
  *
+ * The heuristics are run as a pipeline stopping at the first one that changes
+ * the subgrid. By default the pipeline is adaptive: it keeps yield and cost
+ * statistics per subgrid size, orders the heuristics by eliminations per
+ * microsecond and defers the ones far behind the best (see
+ * subgrid_deferred_heuristics()). Each thread keeps statistics of its own, so
+ * that threads may work on different subgrids at the same time.
+ *
+ * The heuristics stop as soon as they find the subgrid inconsistent (an empty
+ * cell, twice the same singleton, a missing color or more cells than colors
+ * in a naked subset), the subgrid is then left partially updated.
+ *
+ * @param subgrid The subgrid to apply heuristics.
+ * @param size The size of the subgrid.
+ * @return subgrid_changed if the heuristics removed colors, subgrid_unchanged
+ * if they did not, subgrid_inconsistent on a contradiction.
+ */
+subgrid_status_t subgrid_heuristics(colors_t* subgrid[], const size_t size);
+
+/**
+ * @brief Applies the heuristics deferred by the adaptive pipeline to the given
+ * subgrid. They must be run once subgrid_heuristics() changes no subgrid
+ * anymore, so that the fixpoint of the propagation stays the same.
+ *
  * @param subgrid The subgrid to apply heuristics.
  * @param size The size of the subgrid.
- * @return true if the heuristics were successfully applied, false otherwise.
+ * @return The status of the subgrid, as for subgrid_heuristics().
+ */
+subgrid_status_t subgrid_deferred_heuristics(colors_t* subgrid[],
+                                             const size_t size);
+
+/**
+ * @brief Pins the order of the heuristics pipeline, for reproducibility.
+ *
+ * @param spec A comma-separated list of heuristics among "cross", "lone" and
+ * "naked" (heuristics left out are disabled), or "adaptive" (or NULL) to let
+ * the pipeline schedule itself.
+ * @return true if spec is valid, false otherwise (the pipeline is unchanged).
+ */
+bool subgrid_pipeline_set(const char* spec);
+
+/**
+ * @brief Retrieves the order of the heuristics pipeline pinned by the calling
+ * thread, to hand it to the threads running heuristics on its behalf.
+ *
+ * @return The order, with no heuristics when the pipeline is adaptive.
+ */
+subgrid_pipeline_t subgrid_pipeline_get(void);
+
+/**
+ * @brief Pins on the calling thread an order retrieved by
+ * subgrid_pipeline_get() on another one.
+ *
+ * @param pipeline The order.
+ */
+void subgrid_pipeline_pin(const subgrid_pipeline_t* pipeline);
+
+/**
+ * @brief Prints the statistics of the heuristics pipeline per subgrid size,
+ * as kept by the calling thread.
+ *
+ * @param fd The file to print the statistics.
  */
-bool subgrid_heuristics(colors_t* subgrid[], const size_t size);
+void subgrid_pipeline_print(FILE* fd);
 
 #endif /* COLORS_H */
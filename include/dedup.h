@@ -0,0 +1,68 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Puzzles canonicalized per call of a task of the pool of a set */
+#define DEDUP_BLOCK 64
+
+/* Set of the symmetry classes of a stream of puzzles (forward declaration to
+ * hide the implementation) */
+typedef struct _dedup_t dedup_t;
+
+/**
+ * @brief Allocates a set of the symmetry classes of puzzles of one size: two
+ * puzzles are in the same class when a symmetry moves one to the other (see
+ * canon.h).
+ *
+ * A class is found by the 64-bit hash of its canonical form, in an open
+ * addressing table of hashes, then told apart from the other classes of the
+ * hash by the form itself. It keeps its form, its first puzzle and the number
+ * of puzzles in it: the memory grows with the classes, not with the
+ * puzzles.
+ * Puzzles whose canonical form is not exact (see canon_compute()) may start
+ * a class of their own.
+ *
+ * @param size The size of the puzzles (see grid_check_size()).
+ * @param threads The number of threads computing the canonical forms.
+ * @return A new set, or NULL on failure.
+ */
+dedup_t* dedup_alloc(const size_t size, const size_t threads);
+
+/**
+ * @brief Frees a set of classes.
+ * @param dedup The set, may be NULL.
+ */
+void dedup_free(dedup_t* dedup);
+
+/**
+ * @brief Adds puzzles to a set, their canonical forms computed side by side,
+ * then counted in their order.
+ *
+ * @param dedup The set.
+ * @param count The number of puzzles.
+ * @param puzzles The puzzles, size * size characters each, one after the
+ * other: the characters of color_table for the given cells, any other one for
+ * the empty cells.
+ * @return true on success, false if memory runs out.
+ */
+bool dedup_add(dedup_t* dedup, const size_t count, const char* puzzles);
+
+/**
+ * @brief Prints the first puzzle of each class, in the order the classes
+ * came, and the number of puzzles of the class after a blank.
+ * @param dedup The set.
+ * @param fd The file descriptor to print to.
+ */
+void dedup_print(const dedup_t* dedup, FILE* fd);
+
+/**
+ * @brief Prints the number of puzzles and classes of a set.
+ * @param dedup The set.
+ * @param fd The file descriptor to print to.
+ */
+void dedup_print_stats(const dedup_t* dedup, FILE* fd);
+
+#endif /* DEDUP_H */
@@ -0,0 +1,31 @@
+#ifndef DLX_H
+#define DLX_H
+
+#include "grid.h"
+
+/**
+ * @brief Solves the given grid as an exact cover problem with Algorithm X and
+ * dancing links.
+ *
+ * The matrix has one row per (cell, color) pair and one column per cell and
+ * per (row, color), (column, color) and (block, color) pair. It is built once
+ * per grid size and thread, and shared by all the grids of that size the
+ * thread solves: a grid hides the rows of the colors it rules out, covers the
+ * columns of its known cells, and every link is restored once the search is
+ * over. The search always branches on the column with the fewest rows left.
+ *
+ * @param grid The grid to solve, left unchanged.
+ * @param mode mode_first to stop at the first solution, mode_all to hand every
+ * solution to grid_report_solution().
+ * @param solution_count Incremented for each solution found.
+ * @return A new grid holding the solution in mode_first, NULL if there is none
+ * or in mode_all.
+ */
+grid_t* dlx_solver(grid_t* grid, _mode_t mode, size_t* solution_count);
+
+/**
+ * @brief Frees the matrices built by the calling thread, before it exits.
+ */
+void dlx_release(void);
+
+#endif /* DLX_H */
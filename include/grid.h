@@ -6,9 +6,14 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#ifdef COLORS_WIDE
+#define MAX_GRID_SIZE 100
+#else
 #define MAX_GRID_SIZE 64
+#endif
 #define EMPTY_CELL    '_'
 
 static const char color_table[] = "123456789"
@@ -17,6 +22,11 @@ static const char color_table[] = "123456789"
                                   "abcdefghijklmnopqrstuvwxyz"
                                   "&*";
 
+/* Colors past the table (81x81 and 100x100 grids) are written as their
+ * number between braces, e.g. '{65}' for the color after '*'. */
+#define COLOR_TOKEN_OPEN  '{'
+#define COLOR_TOKEN_CLOSE '}'
+
 /* Sudoku grid (forward declaration to hide the implementation)*/
 typedef struct _grid_t grid_t;
 
@@ -24,6 +34,26 @@ typedef enum { grid_solved, grid_unsolved, grid_inconsistent } status_t;
 
 typedef enum { mode_first, mode_all } _mode_t;
 
+typedef enum { chains_off, chains_auto, chains_on } chains_mode_t;
+
+typedef enum { bitboards_off, bitboards_auto, bitboards_on } bitboards_mode_t;
+
+typedef enum { branch_mrv, branch_degree, branch_wdeg } branching_t;
+
+typedef enum { restarts_none, restarts_luby, restarts_geometric } restarts_t;
+
+typedef enum {
+  engine_dfs,
+  engine_cdcl,
+  engine_dlx,
+  engine_lean,
+  engine_band,
+  engine_auto
+} engine_t;
+
+/* Receives each solution of mode_all, with the data given to grid_set_sink() */
+typedef void (*grid_sink_t)(const grid_t* solution, void* data);
+
 typedef struct {
   size_t row;
   size_t column;
@@ -33,6 +63,12 @@ typedef struct {
 /**
  * @brief Allocates memory for a new grid of the specified size.
  *
+ * A grid and all its arrays live in a single slab. Freed slabs are kept by
+ * the thread that freed them and handed out again, most recent first, to the
+ * next grids of the same size (grid_alloc() or grid_copy()), from one
+ * grid_solver() to the next, until grid_arena_release(). A grid may be freed
+ * by another thread than the one that allocated it (see grid_arena_print()).
+ *
  * @param size The size of the grid to be allocated.
  * @return A pointer to the newly allocated grid, or NULL on failure.
  */
@@ -45,6 +81,23 @@ grid_t* grid_alloc(size_t size);
  */
 void grid_free(grid_t* grid);
 
+/**
+ * @brief Prints the counters of the grid slabs of the calling thread, per grid
+ * size: bytes per slab, most slabs in use at the same time (the high-water
+ * mark), slabs allocated, slabs reused, and slabs taken in: allocated by other
+ * threads, then freed by this one. A slab taken in joins the slabs of this
+ * thread, but stays in use for the thread that allocated it, as threads do
+ * not update each other's counters.
+ * @param fd The file where the counters are printed.
+ */
+void grid_arena_print(FILE* fd);
+
+/**
+ * @brief Frees the slabs kept by the calling thread for its next grids, before
+ * it exits (see sudoku_release_thread()).
+ */
+void grid_arena_release(void);
+
 /**
  * @brief Prints the content of the provided grid to the specified file
  * descriptor.
@@ -111,7 +164,30 @@ void grid_set_cell(grid_t* grid, const size_t row, const size_t column,
                    const char color);
 
 /**
- * @brief Checks if the given grid is solved.
+ * @brief Retrieves the colors still possible in a specific cell.
+ * @param grid The grid from which to retrieve the cell colors.
+ * @param row The row index of the cell.
+ * @param column The column index of the cell.
+ * @return The set of colors of the cell, or an empty set if the cell is out of
+ * the grid.
+ */
+colors_t grid_get_colors(const grid_t* grid, const size_t row,
+                         const size_t column);
+
+/**
+ * @brief Sets the colors still possible in a specific cell.
+ * @param grid The grid in which to set the cell colors.
+ * @param row The row index of the cell.
+ * @param column The column index of the cell.
+ * @param colors The set of colors of the cell.
+ */
+void grid_set_colors(grid_t* grid, const size_t row, const size_t column,
+                     const colors_t colors);
+
+/**
+ * @brief Checks if the given grid is solved (every cell is a singleton).
+ *
+ * This is an O(1) query on the state the grid maintains as its cells change.
  *
  * @param grid The grid to check.
  * @return true if the grid is solved, false otherwise.
@@ -119,7 +195,12 @@ void grid_set_cell(grid_t* grid, const size_t row, const size_t column,
 bool grid_is_solved(grid_t* grid);
 
 /**
- * @brief Checks if the given grid is consistent.
+ * @brief Checks if the given grid is consistent: no cell is empty and no color
+ * is placed twice in a row, a column or a block.
+ *
+ * This is an O(1) query: contradictions are flagged as soon as a cell change
+ * introduces them. A color left with no place in a unit is found by
+ * grid_heuristics() instead.
  *
  * @param grid The grid to check.
  * @return true if the grid is consistent, false otherwise.
@@ -134,6 +215,120 @@ bool grid_is_consistent(grid_t* grid);
  */
 status_t grid_heuristics(grid_t* grid);
 
+/**
+ * @brief Enables the all-different filtering tier of grid_heuristics(): once
+ * the unit heuristics are stuck, every unit removes the colors that fit in no
+ * assignment of distinct colors to its cells (see alldiff.h), a superset of
+ * what the unit heuristics deduce.
+ * @param enabled true to enable the tier, false (default) to disable it.
+ */
+void grid_set_alldiff(const bool enabled);
+
+/**
+ * @brief Runs the unit sweeps of grid_heuristics() on 49x49 and larger grids
+ * in three phases, rows, then columns, then blocks: the units of a phase share
+ * no cell, their heuristics run side by side on a pool of threads, then their
+ * changes are applied in order once all of them are done. The deductions are
+ * the ones of a single sweep, this cuts the latency of one large grid.
+ * Smaller grids have too little work per phase to pay for the barrier.
+ * The pool belongs to the calling thread.
+ * @param threads The number of threads, 1 (default) for a single sweep.
+ * @return true on success, false if the threads cannot be started (the grids
+ * are then swept on a single thread).
+ */
+bool grid_set_threads(const size_t threads);
+
+/**
+ * @brief Selects when the chain-based deductions (simple coloring, XY-Wing and
+ * XYZ-Wing) run, once the unit heuristics reached a fixpoint without solving
+ * the grid. Each run is bounded by an effort budget.
+ *
+ * @param mode chains_off, chains_on, or chains_auto (default) to run them only
+ * on grids of size 16 and up.
+ */
+void grid_set_chains(const chains_mode_t mode);
+
+/**
+ * @brief Selects when the color bitboards tier runs, once the unit tiers are
+ * stuck. The grid keeps, for each color, the places left to it in each row and
+ * each column as one word per line, updated with every cell change. The tier
+ * reads them to find hidden singles, units left without a color, pointing and
+ * claiming intersections, X-Wings and Swordfish with a few word operations.
+ * @param mode bitboards_off, bitboards_on, or bitboards_auto (default) to run
+ * it only on grids of size 25 and up.
+ */
+void grid_set_bitboards(const bitboards_mode_t mode);
+
+/**
+ * @brief Selects the branching strategy of the solver, from a comma-separated
+ * list of:
+ * - "mrv" (default): the first cell with the fewest colors, found in constant
+ *   time as cells are indexed by number of colors as the grid changes;
+ * - "degree": among the first cells with the fewest colors, the one with the
+ *   most unresolved peers;
+ * - "wdeg": dom/wdeg, the cell with the lowest number of colors over the
+ *   weight of its units, a unit gaining weight each time it is found
+ *   inconsistent;
+ * - "lcv": try first the least constraining value, the color of the cell
+ *   found in the fewest unresolved peers (instead of the rightmost one);
+ * - "random": break ties at random (see grid_set_seed()).
+ *
+ * @param spec The strategy.
+ * @return true if spec is valid, false otherwise (the strategy is unchanged).
+ */
+bool grid_set_branching(const char* spec);
+
+/**
+ * @brief Seeds the pseudo-random generator of the solver, the same seed gives
+ * the same search.
+ *
+ * @param seed The seed.
+ */
+void grid_set_seed(const uint64_t seed);
+
+/**
+ * @brief Sets up randomized restarts for mode_first: the solver runs searches
+ * with random tie-breaking under a node cutoff, starting over with the next
+ * cutoff until a search finds a solution or completes. The unit weights of
+ * dom/wdeg are kept across restarts. The spec is a comma-separated list of:
+ * - "luby" (default) or "geometric": cutoffs follow the Luby sequence
+ *   (1, 1, 2, 1, 1, 2, 4, ...) or grow by 1.5 each time;
+ * - a number: the cutoff unit, in search nodes, from 1 to 10^9 (default:
+ *   128);
+ * - "reset": reset the unit weights at each restart;
+ * - "none": disable restarts (default).
+ *
+ * @param spec The restart policy.
+ * @return true if spec is valid, false otherwise (the policy is unchanged).
+ */
+bool grid_set_restarts(const char* spec);
+
+/**
+ * @brief Enables conflict-directed backjumping: the solver records, per unit,
+ * the choices its cells depend on, and when a choice fails for reasons that
+ * do not involve it, jumps straight back to the deepest choice that did.
+ *
+ * @param enabled true to enable backjumping, false (default) to backtrack
+ * chronologically.
+ */
+void grid_set_backjumping(const bool enabled);
+
+/**
+ * @brief Selects the engine behind grid_solver():
+ * - engine_dfs (default): depth-first search over grid copies, with the
+ *   propagation of grid_heuristics() at each node;
+ * - engine_cdcl: clause learning on an exactly-one encoding of the grid (see
+ *   cdcl.h);
+ * - engine_dlx: exact cover with dancing links (see dlx.h);
+ * - engine_lean: in place backtracking on the colors used per unit (see
+ *   lean.h), for high volumes of small grids;
+ * - engine_band: vectors of bitboards for 9x9 grids only (see band.h);
+ * - engine_auto: engine_band on 9x9 grids, engine_lean on smaller ones,
+ *   engine_dlx up to 16x16 and engine_cdcl on larger ones.
+ * @param engine The engine.
+ */
+void grid_set_engine(const engine_t engine);
+
 /**
  * @brief Checks if the given choice is empty.
  *
@@ -166,13 +361,98 @@ void grid_choice_discard(grid_t* grid, const choice_t choice);
  */
 void grid_choice_print(const choice_t choice, FILE* fd);
 
+/**
+ * @brief Sets where the solutions found in mode_all by the calling thread go.
+ * @param sink The function receiving each solution, NULL (default) to print
+ * each one on stdout, followed by an empty line, and their number at the end
+ * of grid_solver().
+ * @param data Passed on to the sink.
+ */
+void grid_set_sink(grid_sink_t sink, void* data);
+
+/**
+ * @brief Sets the number of solutions mode_all reports on the calling thread
+ * before its search stops.
+ * @param limit The number of solutions, SIZE_MAX (default) for all of them.
+ */
+void grid_set_solution_limit(const size_t limit);
+
+/**
+ * @brief Hands a solution found in mode_all to the sink of the calling thread
+ * (see grid_set_sink()), the way every engine reports its solutions.
+ * @param solution The solution, which the sink may not keep, or NULL if
+ * memory ran out building it (see grid_report_failure()).
+ * @return false once the limit is reached (see grid_set_solution_limit()), or
+ * for a NULL solution: the engine stops its search.
+ */
+bool grid_report_solution(const grid_t* solution);
+
+/**
+ * @brief Records that memory ran out during the search of the calling thread,
+ * the way every engine reports a part of the search it had to skip.
+ */
+void grid_report_failure(void);
+
+/* Step of the path from the root of a dfs search to one of its nodes: a
+ * choice taken, or one discarded once the subtree where it was taken has
+ * been searched */
+typedef struct {
+  choice_t choice;
+  bool discarded;
+  size_t candidates; /* Colors of the cell of the choice, it included */
+} grid_step_t;
+
+/* Watches a dfs search: called at a node with the path to it and the number
+ * of solutions reported so far (none of the node), returns false to stop the
+ * search there */
+typedef bool (*grid_monitor_t)(const grid_step_t* path, const size_t length,
+                               const size_t solutions, void* data);
+
+/**
+ * @brief Sets the monitor of the dfs searches of the calling thread. The
+ * solutions of a search are the ones under the last node it reached, and the
+ * ones of the subtrees of the choices its path discards: a path is where a
+ * stopped search resumes (see grid_set_replay()).
+ * @param monitor The monitor, NULL (default) for none.
+ * @param data Passed on to the monitor.
+ * @param period The number of nodes between two calls of the monitor.
+ */
+void grid_set_monitor(grid_monitor_t monitor, void* data, const size_t period);
+
+/**
+ * @brief Makes the next dfs search of the calling thread start where a path
+ * handed to a monitor leads (see grid_set_monitor()): it takes and discards
+ * the choices of the path in order, then searches on from there, the
+ * solutions of the discarded subtrees being counted but not reported again.
+ * The grid must be the one the path comes from, the strategies may differ.
+ * @param path The path, copied.
+ * @param length The number of steps of the path.
+ * @param solutions The number of solutions reported before.
+ * @return false if memory runs out.
+ */
+bool grid_set_replay(const grid_step_t* path, const size_t length,
+                     const size_t solutions);
+
 /**
  * @brief Solves the given grid using the specified mode.
  *
+ * The engine, the strategies and the sink are the ones set by the calling
+ * thread (grid_set_*()): threads solve side by side without sharing any of
+ * them. A dfs search its monitor stops (see grid_set_monitor()) returns
+ * NULL, without printing the number of solutions in mode_all.
+ *
  * @param grid The grid to solve.
  * @param mode The mode to use for solving.
  * @return A pointer to the solved grid.
  */
 grid_t* grid_solver(grid_t* grid, _mode_t mode);
 
+/**
+ * @brief Tells whether the last grid_solver() of the calling thread searched
+ * all it had to: a grid it found no solution of is then proved to have none.
+ * @return false if memory ran out (see grid_report_failure()), or if its
+ * monitor or its limit of solutions stopped it.
+ */
+bool grid_solver_completed(void);
+
 #endif /* GRID_H */
@@ -0,0 +1,38 @@
+#ifndef LEAN_H
+#define LEAN_H
+
+#include "grid.h"
+
+/**
+ * @brief Solves the given grid with the lean engine, meant for high volumes of
+ * small grids.
+ *
+ * The search state is only the value placed in each cell and the set of
+ * colors used in each row, column and block: the colors of an empty cell are
+ * the ones none of its three units uses, computed when needed. Placing or
+ * removing a value updates three masks, so the search runs in place, without
+ * copies, on a state of a few hundred bytes for 9x9 and 16x16 grids. It
+ * branches on the empty cell with the fewest colors, and first places the
+ * colors that fit in a single cell of a unit.
+ *
+ * Grids with cells restricted to some colors (neither empty nor set) do not
+ * fit the model, they are solved by the default engine instead.
+ *
+ * @param grid The grid to solve, left unchanged.
+ * @param mode mode_first to stop at the first solution, mode_all to hand every
+ * solution to grid_report_solution().
+ * @param solution_count Incremented for each solution found.
+ * @return A new grid holding the solution in mode_first, NULL if there is none
+ * or in mode_all.
+ */
+grid_t* lean_solver(grid_t* grid, _mode_t mode, size_t* solution_count);
+
+/**
+ * @brief Checks if a grid fits the model of the lean engine: each cell either
+ * holds a single color or may hold any color.
+ * @param grid The grid to check.
+ * @return true if lean_solver() can solve the grid, false otherwise.
+ */
+bool lean_accepts(const grid_t* grid);
+
+#endif /* LEAN_H */
@@ -0,0 +1,139 @@
+#ifndef LIBSUDOKU_H
+#define LIBSUDOKU_H
+
+#include "cache.h"
+#include "grid.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Solver context: the settings, the sink and the last error of one client,
+ * used by one thread at a time (forward declaration to hide the
+ * implementation) */
+typedef struct _sudoku_t sudoku_t;
+
+typedef enum {
+  sudoku_ok,
+  sudoku_error_memory,    /* Out of memory */
+  sudoku_error_option,    /* Unknown option or invalid value */
+  sudoku_error_grid,      /* Malformed grid */
+  sudoku_error_unsolvable /* No solution, in mode_first */
+} sudoku_error_t;
+
+/**
+ * @brief Allocates a solver context with the default settings: the band engine
+ * on 9x9 grids and the dfs one on others (on every grid once an option of
+ * the dfs engine is set, see sudoku_set_option()), the default strategies of
+ * grid.h, and no sink.
+ *
+ * Contexts share nothing: threads solve side by side, each one with its own
+ * contexts. The settings of the grid module on a thread (grid_set_*()) are
+ * the ones of the last context used on it.
+ *
+ * @return A new context, or NULL on failure.
+ */
+sudoku_t* sudoku_alloc(void);
+
+/**
+ * @brief Frees a solver context.
+ * @param context The context to free.
+ */
+void sudoku_free(sudoku_t* context);
+
+/**
+ * @brief Sets an option of the context, named after the long options of the
+ * command line:
+ * - "engine": dfs, cdcl, dlx, lean, band or auto (see grid_set_engine());
+ * - "branch": a strategy of grid_set_branching();
+ * - "restarts": a policy of grid_set_restarts() (NULL for luby);
+ * - "pipeline": an order of subgrid_pipeline_set();
+ * - "chains", "bitboards": on (or NULL), off or auto;
+ * - "alldiff", "backjump": on (or NULL) or off;
+ * - "seed": a number (see grid_set_seed());
+ * - "limit": the number of solutions of mode_all after which the search
+ *   stops, at least 1 (see grid_set_solution_limit()), all of them by
+ *   default.
+ *
+ * @param context The context.
+ * @param name The name of the option.
+ * @param value The value of the option, NULL when it is optional.
+ * @return sudoku_ok, or sudoku_error_option if the name or the value is
+ * invalid (the context is unchanged).
+ */
+sudoku_error_t sudoku_set_option(sudoku_t* context, const char* name,
+                                 const char* value);
+
+/**
+ * @brief Sets where the solutions of mode_all go.
+ * @param context The context.
+ * @param sink The function receiving each solution, NULL (default) to only
+ * count them.
+ * @param data Passed on to the sink.
+ */
+void sudoku_set_sink(sudoku_t* context, grid_sink_t sink, void* data);
+
+/**
+ * @brief Sets the cache of the solutions of mode_first: a grid found in it,
+ * up to its symmetries, is not solved again, and the grids solved go to it.
+ * @param context The context.
+ * @param cache The cache (see cache.h), shared by any number of contexts and
+ * threads, or NULL (default) to solve every grid.
+ */
+void sudoku_set_cache(sudoku_t* context, cache_t* cache);
+
+/**
+ * @brief Reads a grid from a string, in the format of the grid files: one row
+ * per line, cells separated or not by blanks, '#' starting a comment.
+ *
+ * @param context The context, which keeps the message of an error.
+ * @param text The grid, terminated by a null character.
+ * @param grid Receives the new grid, owned by the caller.
+ * @return sudoku_ok, sudoku_error_grid if the text is not a valid grid, or
+ * sudoku_error_memory.
+ */
+sudoku_error_t sudoku_parse(sudoku_t* context, const char* text,
+                            grid_t** grid);
+
+/**
+ * @brief Reads a grid from an open file, up to its end (see sudoku_parse()).
+ *
+ * @param context The context, which keeps the message of an error.
+ * @param file The file, left open.
+ * @param grid Receives the new grid, owned by the caller.
+ * @return sudoku_ok, sudoku_error_grid if the file is not a valid grid, or
+ * sudoku_error_memory.
+ */
+sudoku_error_t sudoku_parse_file(sudoku_t* context, FILE* file,
+                                 grid_t** grid);
+
+/**
+ * @brief Solves a grid with the settings of the context, on the calling
+ * thread. Nothing is printed: in mode_all, the solutions go to the sink.
+ *
+ * @param context The context.
+ * @param grid The grid to solve, left unchanged.
+ * @param mode mode_first for a solution, mode_all for all of them.
+ * @param solution Receives the solution in mode_first, owned by the caller,
+ * NULL otherwise. May be NULL.
+ * @param count Receives the number of solutions found. May be NULL.
+ * @return sudoku_ok, sudoku_error_unsolvable if the grid has no solution in
+ * mode_first, or sudoku_error_memory.
+ */
+sudoku_error_t sudoku_solve(sudoku_t* context, const grid_t* grid,
+                            const _mode_t mode, grid_t** solution,
+                            size_t* count);
+
+/**
+ * @brief Retrieves the message of the last error of the context.
+ * @param context The context.
+ * @return The message, empty if the last call succeeded.
+ */
+const char* sudoku_error_message(const sudoku_t* context);
+
+/**
+ * @brief Frees the caches the calling thread keeps across grids (matrices of
+ * the dlx engine, threads of grid_set_threads(), grid slabs), before it exits.
+ */
+void sudoku_release_thread(void);
+
+#endif /* LIBSUDOKU_H */
@@ -0,0 +1,48 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pool of worker threads (forward declaration to hide the implementation) */
+typedef struct _pool_t pool_t;
+
+/* Task of a pool: called once per index of a run, from any thread */
+typedef void (*pool_task_t)(void* context, const size_t index);
+
+/**
+ * @brief Starts a pool of threads running the tasks of pool_run().
+ * @param threads The number of threads taking part in a run, the calling one
+ * included (threads - 1 workers are started).
+ * @return A new pool, NULL if threads is 0 or the threads cannot be started.
+ */
+pool_t* pool_alloc(const size_t threads);
+
+/**
+ * @brief Stops the workers of a pool and frees it.
+ * @param pool The pool, may be NULL.
+ */
+void pool_free(pool_t* pool);
+
+/**
+ * @brief Number of threads taking part in a run of a pool.
+ * @param pool The pool.
+ * @return The number of threads given to pool_alloc().
+ */
+size_t pool_threads(const pool_t* pool);
+
+/**
+ * @brief Runs task(context, i) for every i in [0, count) on the threads of
+ * the pool, the calling one included, and returns once all of them are done:
+ * a barrier, after which everything the tasks wrote is visible to the caller.
+ * The indexes are handed out one at a time, in increasing order.
+ *
+ * @param pool The pool.
+ * @param task The task to run.
+ * @param context Passed to each call of the task.
+ * @param count The number of calls.
+ */
+void pool_run(pool_t* pool, pool_task_t task, void* context,
+              const size_t count);
+
+#endif /* POOL_H */
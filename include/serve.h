@@ -0,0 +1,44 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "cache.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Solves the grids of a stream of requests in a resident process, on
+ * a pool of worker threads that keep their caches (dlx matrices, heuristics
+ * statistics, unit topologies, grid slabs) from one request to the next.
+ *
+ * A request is a header line, then the grid in the format of the grid files:
+ *   ID MODE LENGTH [OPTION[=VALUE]]...
+ * - ID: any word, repeated in the response;
+ * - MODE: 'first' for a solution, 'all' for all of them;
+ * - LENGTH: the number of bytes of the grid, after the header line;
+ * - OPTION: an option of sudoku_set_option() (see libsudoku.h), such as
+ *   'limit=N' to stop the search of mode 'all' after N solutions.
+ * Requests are solved side by side: their responses come in the order they
+ * are done, each one a header line then LENGTH bytes:
+ *   ID STATUS COUNT SOLVE_US WAIT_US LENGTH
+ * - STATUS: 'ok', 'unsolvable' (mode 'first' only) or 'error';
+ * - COUNT: the number of solutions, up to the limit;
+ * - SOLVE_US, WAIT_US: the microseconds spent solving the request, and
+ *   waiting for a worker before;
+ * - then the solutions as printed by grid_print(), each one followed by an
+ *   empty line in mode 'all', or the message of the error.
+ * A request that cannot be framed (no length, or fewer bytes than announced)
+ * is answered with an error, then its connection is closed.
+ *
+ * @param path The path of the Unix domain socket to listen on, each connection
+ * sending its requests and getting its responses, or NULL to serve the
+ * requests of stdin on stdout.
+ * @param workers The number of worker threads.
+ * @param cache The solutions of mode 'first' kept by the workers (see
+ * sudoku_set_cache()), or NULL.
+ * @return true once stdin is done, false if the socket or the threads cannot
+ * be set up (listening on a socket only returns on failure).
+ */
+bool serve(const char* path, const size_t workers, cache_t* cache);
+
+#endif /* SERVE_H */
@@ -0,0 +1,218 @@
+#include "alldiff.h"
+
+#include <colors.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hopcroft-Karp layers and Tarjan indexes of unvisited vertices */
+#define UNVISITED SIZE_MAX
+
+/* Bipartite graph of a subgrid and its current matching */
+typedef struct {
+  size_t size;
+  colors_t domains[MAX_COLORS];
+  int8_t color_of[MAX_COLORS]; /* Color matched to each cell */
+  int8_t cell_of[MAX_COLORS];  /* Cell matched to each color */
+  size_t layers[MAX_COLORS];
+} matching_t;
+
+/* Index of the lowest color of a non-empty set */
+static size_t
+colors_first(const colors_t colors) {
+  return colors_count(colors_rightmost(colors) - 1);
+}
+
+static void
+matching_set(matching_t* graph, const size_t cell, const size_t color) {
+  graph->color_of[cell] = color;
+  graph->cell_of[color] = cell;
+}
+
+/* Layer the free cells and the cells reachable from them by alternating
+ * paths, true if such a path reaches a free color. */
+static bool
+matching_layers(matching_t* graph) {
+  size_t queue[MAX_COLORS];
+  size_t head = 0;
+  size_t tail = 0;
+  bool found = false;
+
+  for (size_t cell = 0; cell < graph->size; cell++) {
+    if (graph->color_of[cell] == ALLDIFF_UNMATCHED) {
+      graph->layers[cell] = 0;
+      queue[tail++] = cell;
+    } else {
+      graph->layers[cell] = UNVISITED;
+    }
+  }
+
+  while (head < tail) {
+    size_t cell = queue[head++];
+    for (colors_t left = graph->domains[cell]; left != colors_empty();
+         left = colors_subtract(left, colors_rightmost(left))) {
+      int8_t next = graph->cell_of[colors_first(left)];
+      if (next == ALLDIFF_UNMATCHED) {
+        found = true;
+      } else if (graph->layers[next] == UNVISITED) {
+        graph->layers[next] = graph->layers[cell] + 1;
+        queue[tail++] = next;
+      }
+    }
+  }
+
+  return found;
+}
+
+/* Augment along a shortest alternating path from a free cell */
+static bool
+matching_augment(matching_t* graph, const size_t cell) {
+  for (colors_t left = graph->domains[cell]; left != colors_empty();
+       left = colors_subtract(left, colors_rightmost(left))) {
+    size_t color = colors_first(left);
+    int8_t next = graph->cell_of[color];
+    if (next == ALLDIFF_UNMATCHED
+        || (graph->layers[next] == graph->layers[cell] + 1
+            && matching_augment(graph, next))) {
+      matching_set(graph, cell, color);
+      return true;
+    }
+  }
+
+  graph->layers[cell] = UNVISITED;
+  return false;
+}
+
+/* Hopcroft-Karp from the current matching, false if it is not perfect */
+static bool
+matching_complete(matching_t* graph) {
+  size_t matched = 0;
+
+  for (size_t cell = 0; cell < graph->size; cell++) {
+    matched += graph->color_of[cell] != ALLDIFF_UNMATCHED;
+  }
+
+  while (matched < graph->size && matching_layers(graph)) {
+    for (size_t cell = 0; cell < graph->size; cell++) {
+      if (graph->color_of[cell] == ALLDIFF_UNMATCHED
+          && matching_augment(graph, cell)) {
+        matched++;
+      }
+    }
+  }
+
+  return matched == graph->size;
+}
+
+/* Tarjan's strongly connected components on the graph of the colors */
+typedef struct {
+  const matching_t* graph;
+  size_t index[MAX_COLORS];
+  size_t lowlink[MAX_COLORS];
+  size_t stack[MAX_COLORS];
+  size_t stack_size;
+  colors_t on_stack;
+  size_t counter;
+  colors_t components[MAX_COLORS]; /* Component of each color */
+} tarjan_t;
+
+static void
+tarjan_visit(tarjan_t* tarjan, const size_t color) {
+  const matching_t* graph = tarjan->graph;
+  colors_t successors = colors_discard(
+      graph->domains[(size_t)graph->cell_of[color]], color);
+
+  tarjan->index[color] = tarjan->lowlink[color] = tarjan->counter++;
+  tarjan->stack[tarjan->stack_size++] = color;
+  tarjan->on_stack = colors_add(tarjan->on_stack, color);
+
+  for (; successors != colors_empty();
+       successors = colors_subtract(successors, colors_rightmost(successors))) {
+    size_t next = colors_first(successors);
+    if (tarjan->index[next] == UNVISITED) {
+      tarjan_visit(tarjan, next);
+      if (tarjan->lowlink[next] < tarjan->lowlink[color]) {
+        tarjan->lowlink[color] = tarjan->lowlink[next];
+      }
+    } else if (colors_is_in(tarjan->on_stack, next)
+               && tarjan->index[next] < tarjan->lowlink[color]) {
+      tarjan->lowlink[color] = tarjan->index[next];
+    }
+  }
+
+  if (tarjan->lowlink[color] == tarjan->index[color]) {
+    colors_t component = colors_empty();
+    size_t member;
+    do {
+      member = tarjan->stack[--tarjan->stack_size];
+      component = colors_add(component, member);
+    } while (member != color);
+
+    tarjan->on_stack = colors_subtract(tarjan->on_stack, component);
+    for (colors_t left = component; left != colors_empty();
+         left = colors_subtract(left, colors_rightmost(left))) {
+      tarjan->components[colors_first(left)] = component;
+    }
+  }
+}
+
+subgrid_status_t
+alldiff_filter(colors_t* subgrid[], const size_t size, int8_t matching[],
+               size_t* eliminations) {
+  matching_t graph;
+
+  graph.size = size;
+  for (size_t i = 0; i < size; i++) {
+    graph.domains[i] = *subgrid[i];
+    graph.cell_of[i] = ALLDIFF_UNMATCHED;
+  }
+
+  /* Keep the edges of the previous matching still in the graph */
+  for (size_t cell = 0; cell < size; cell++) {
+    int8_t color = matching[cell];
+    graph.color_of[cell] = ALLDIFF_UNMATCHED;
+    if (color >= 0 && (size_t)color < size
+        && colors_is_in(graph.domains[cell], color)
+        && graph.cell_of[(size_t)color] == ALLDIFF_UNMATCHED) {
+      matching_set(&graph, cell, color);
+    }
+  }
+
+  bool complete = matching_complete(&graph);
+  for (size_t cell = 0; cell < size; cell++) {
+    matching[cell] = graph.color_of[cell];
+  }
+  if (!complete) {
+    return subgrid_inconsistent;
+  }
+
+  /* The matching is perfect: every color is matched, a color is usable by a
+   * cell iff it shares a component with the color matched to the cell. */
+  tarjan_t tarjan;
+  tarjan.graph = &graph;
+  tarjan.stack_size = 0;
+  tarjan.on_stack = colors_empty();
+  tarjan.counter = 0;
+  for (size_t color = 0; color < size; color++) {
+    tarjan.index[color] = UNVISITED;
+  }
+  for (size_t color = 0; color < size; color++) {
+    if (tarjan.index[color] == UNVISITED) {
+      tarjan_visit(&tarjan, color);
+    }
+  }
+
+  size_t removed = 0;
+  for (size_t cell = 0; cell < size; cell++) {
+    colors_t kept = colors_and(
+        graph.domains[cell], tarjan.components[(size_t)graph.color_of[cell]]);
+    if (kept != graph.domains[cell]) {
+      removed += colors_count(graph.domains[cell]) - colors_count(kept);
+      *subgrid[cell] = kept;
+    }
+  }
+
+  *eliminations += removed;
+  return removed > 0 ? subgrid_changed : subgrid_unchanged;
+}
@@ -0,0 +1,423 @@
+#include "band.h"
+
+#include <colors.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BAND_COLORS 9
+#define BAND_COUNT  3
+
+/* Cells of a band (three rows of nine cells) */
+#define BAND_BITS 27
+#define BAND_FULL ((1U << BAND_BITS) - 1)
+
+/* One lane per band, the fourth one is always empty */
+typedef uint32_t band_vector_t __attribute__((vector_size(16)));
+
+typedef struct {
+  band_vector_t colors[BAND_COLORS]; /* Cells where each color is possible */
+  band_vector_t solved;              /* Cells holding a single placed color */
+} band_t;
+
+/* Where the search stands: solutions found, and what to do with them */
+typedef struct {
+  size_t count;
+  size_t limit;
+  char* solution; /* First solution in line form, or NULL */
+  const grid_t* grid;
+  _mode_t mode;
+  grid_t* result;
+} band_search_t;
+
+static band_vector_t cell_bits[BAND_CELLS];
+static band_vector_t peers[BAND_CELLS];
+static band_vector_t units[3 * BAND_COLORS]; /* Rows, columns, then blocks */
+static const band_vector_t all_cells = {BAND_FULL, BAND_FULL, BAND_FULL, 0};
+
+/* Locked candidates of a color in a band, by its occupied mini-rows: bit
+ * 3 * row + block stands for the three cells of a row in a block. */
+static uint16_t minirows_kept[1 << BAND_COLORS];
+static uint32_t minirows_cells[1 << BAND_COLORS];
+static uint8_t row_minirows[1 << BAND_COLORS]; /* Of the 9 cells of a row */
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static bool
+vector_is_empty(const band_vector_t vector) {
+  return (vector[0] | vector[1] | vector[2]) == 0;
+}
+
+/* A single cell, without counting them */
+static bool
+vector_is_singleton(const band_vector_t vector) {
+  band_vector_t lower = vector & (vector - 1);
+  return (lower[0] | lower[1] | lower[2]) == 0
+         && (vector[0] != 0) + (vector[1] != 0) + (vector[2] != 0) == 1;
+}
+
+/* First cell of a non-empty vector */
+static size_t
+vector_first(const band_vector_t vector) {
+  for (size_t band = 0; band < BAND_COUNT; band++) {
+    if (vector[band] != 0) {
+      return band * BAND_BITS + __builtin_ctz(vector[band]);
+    }
+  }
+  return BAND_CELLS;
+}
+
+/* Apply the pointing and claiming rules to a set of mini-rows until nothing
+ * changes, 0 if a row or a block of the band is left without the color. */
+static uint16_t
+minirows_lock(uint16_t minirows) {
+  uint16_t previous;
+
+  do {
+    previous = minirows;
+    for (size_t i = 0; i < BAND_COUNT; i++) {
+      uint16_t row = (minirows >> (3 * i)) & 7;
+      uint16_t block = 0;
+      for (size_t j = 0; j < BAND_COUNT; j++) {
+        block |= ((minirows >> (3 * j + i)) & 1) << j;
+      }
+      if (row == 0 || block == 0) {
+        return 0;
+      }
+
+      /* The color of the row is in a single block: not in its other rows */
+      if (colors_is_singleton(row)) {
+        for (size_t j = 0; j < BAND_COUNT; j++) {
+          if (j != i) {
+            minirows &= ~(row << (3 * j));
+          }
+        }
+      }
+      /* The color of the block is in a single row: not in its other blocks */
+      if (colors_is_singleton(block)) {
+        size_t j = colors_count(block - 1);
+        minirows &= ~(7 << (3 * j)) | (1 << (3 * j + i));
+      }
+    }
+  } while (minirows != previous);
+
+  return minirows;
+}
+
+static void
+band_tables_init(void) {
+  for (size_t cell = 0; cell < BAND_CELLS; cell++) {
+    size_t row = cell / BAND_COLORS, column = cell % BAND_COLORS;
+    size_t block = (row / 3) * 3 + column / 3;
+    band_vector_t bit = {0};
+
+    bit[cell / BAND_BITS] = 1U << (cell % BAND_BITS);
+    cell_bits[cell] = bit;
+    units[row] |= bit;
+    units[BAND_COLORS + column] |= bit;
+    units[2 * BAND_COLORS + block] |= bit;
+  }
+  for (size_t cell = 0; cell < BAND_CELLS; cell++) {
+    size_t row = cell / BAND_COLORS, column = cell % BAND_COLORS;
+    size_t block = (row / 3) * 3 + column / 3;
+
+    peers[cell] = (units[row] | units[BAND_COLORS + column]
+                   | units[2 * BAND_COLORS + block])
+                  & ~cell_bits[cell];
+  }
+
+  for (uint16_t cells = 0; cells < (1 << BAND_COLORS); cells++) {
+    row_minirows[cells] = ((cells & 07) != 0) | ((cells & 070) != 0) << 1
+                          | ((cells & 0700) != 0) << 2;
+  }
+  for (uint16_t minirows = 0; minirows < (1 << BAND_COLORS); minirows++) {
+    minirows_kept[minirows] = minirows_lock(minirows);
+    for (size_t i = 0; i < BAND_COLORS; i++) {
+      if (minirows & (1 << i)) {
+        minirows_cells[minirows] |= 7U << (3 * i);
+      }
+    }
+  }
+}
+
+/* Place a color in a cell which may hold it */
+static void
+band_place(band_t* band, const size_t color, const size_t cell) {
+  for (size_t i = 0; i < BAND_COLORS; i++) {
+    band->colors[i] &= ~cell_bits[cell];
+  }
+  band->colors[color] = (band->colors[color] & ~peers[cell]) | cell_bits[cell];
+  band->solved |= cell_bits[cell];
+}
+
+/* Locked candidates of every color in every band, false on a contradiction.
+ * Sets *changed when colors were removed. */
+static bool
+band_lock(band_t* band, bool* changed) {
+  for (size_t color = 0; color < BAND_COLORS; color++) {
+    for (size_t i = 0; i < BAND_COUNT; i++) {
+      uint32_t cells = band->colors[color][i];
+      uint16_t minirows = row_minirows[cells & 0777]
+                          | row_minirows[(cells >> 9) & 0777] << 3
+                          | row_minirows[cells >> 18] << 6;
+      uint16_t kept = minirows_kept[minirows];
+      if (kept == 0) {
+        return false;
+      }
+      if (kept != minirows) {
+        band->colors[color][i] = cells & minirows_cells[kept];
+        *changed = true;
+      }
+    }
+  }
+  return true;
+}
+
+/* Deduce until nothing changes, false on a contradiction */
+static bool
+band_propagate(band_t* band) {
+  bool changed = true;
+
+  while (changed) {
+    changed = false;
+
+    /* Cells with at least one, and at least two, colors */
+    band_vector_t once = {0};
+    band_vector_t twice = {0};
+    for (size_t color = 0; color < BAND_COLORS; color++) {
+      twice |= once & band->colors[color];
+      once |= band->colors[color];
+    }
+    if (!vector_is_empty(all_cells & ~once)) {
+      return false;
+    }
+
+    /* Naked singles */
+    band_vector_t singles = once & ~twice & ~band->solved;
+    while (!vector_is_empty(singles)) {
+      size_t cell = vector_first(singles);
+      singles &= ~cell_bits[cell];
+      for (size_t color = 0; color < BAND_COLORS; color++) {
+        if (!vector_is_empty(band->colors[color] & cell_bits[cell])) {
+          band_place(band, color, cell);
+          changed = true;
+          break;
+        }
+      }
+    }
+    if (changed) {
+      continue;
+    }
+
+    /* Hidden singles */
+    for (size_t color = 0; color < BAND_COLORS; color++) {
+      for (size_t unit = 0; unit < 3 * BAND_COLORS; unit++) {
+        band_vector_t places = band->colors[color] & units[unit];
+        if (vector_is_empty(places)) {
+          return false;
+        }
+        if (vector_is_singleton(places)
+            && vector_is_empty(places & band->solved)) {
+          band_place(band, color, vector_first(places));
+          changed = true;
+        }
+      }
+    }
+    if (changed) {
+      continue;
+    }
+
+    if (!band_lock(band, &changed)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Cell to branch on: one with two colors if any, else one with the fewest */
+static size_t
+band_choose_cell(const band_t* band) {
+  band_vector_t once = {0};
+  band_vector_t twice = {0};
+  band_vector_t more = {0};
+
+  for (size_t color = 0; color < BAND_COLORS; color++) {
+    more |= twice & band->colors[color];
+    twice |= once & band->colors[color];
+    once |= band->colors[color];
+  }
+  band_vector_t pairs = twice & ~more & ~band->solved;
+  if (!vector_is_empty(pairs)) {
+    return vector_first(pairs);
+  }
+
+  size_t best = BAND_CELLS;
+  size_t best_count = BAND_COLORS + 1;
+  band_vector_t left = all_cells & ~band->solved;
+  while (!vector_is_empty(left)) {
+    size_t cell = vector_first(left);
+    size_t count = 0;
+    left &= ~cell_bits[cell];
+    for (size_t color = 0; color < BAND_COLORS; color++) {
+      count += !vector_is_empty(band->colors[color] & cell_bits[cell]);
+    }
+    if (count < best_count) {
+      best = cell;
+      best_count = count;
+    }
+  }
+  return best;
+}
+
+static void
+band_to_line(const band_t* band, char* line) {
+  for (size_t color = 0; color < BAND_COLORS; color++) {
+    for (band_vector_t left = band->colors[color]; !vector_is_empty(left);) {
+      size_t cell = vector_first(left);
+      left &= ~cell_bits[cell];
+      line[cell] = color_table[color];
+    }
+  }
+}
+
+static grid_t*
+band_to_grid(const band_t* band, const grid_t* grid) {
+  grid_t* result = grid_copy(grid);
+  if (result == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  for (size_t color = 0; color < BAND_COLORS; color++) {
+    for (band_vector_t left = band->colors[color]; !vector_is_empty(left);) {
+      size_t cell = vector_first(left);
+      left &= ~cell_bits[cell];
+      grid_set_colors(result, cell / BAND_COLORS, cell % BAND_COLORS,
+                      colors_set(color));
+    }
+  }
+  return result;
+}
+
+static void
+band_solution(const band_t* band, band_search_t* search) {
+  if (search->count == 0 && search->solution != NULL) {
+    band_to_line(band, search->solution);
+  }
+  if (search->grid != NULL && search->mode == mode_first) {
+    search->result = band_to_grid(band, search->grid);
+  } else if (search->grid != NULL) {
+    grid_t* solution = band_to_grid(band, search->grid);
+    if (!grid_report_solution(solution)) {
+      search->limit = search->count + 1;
+    }
+    grid_free(solution);
+  }
+  search->count++;
+}
+
+/* Depth-first search on copies of the board, true once the limit is hit */
+static bool
+band_search(const band_t* band, band_search_t* search) {
+  if (vector_is_empty(all_cells & ~band->solved)) {
+    band_solution(band, search);
+    return search->count >= search->limit;
+  }
+
+  size_t cell = band_choose_cell(band);
+  for (size_t color = 0; color < BAND_COLORS; color++) {
+    if (vector_is_empty(band->colors[color] & cell_bits[cell])) {
+      continue;
+    }
+
+    band_t next = *band;
+    band_place(&next, color, cell);
+    if (band_propagate(&next) && band_search(&next, search)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Start the search from a board whose given cells are placed in order */
+static void
+band_run(band_t* band, const colors_t givens[BAND_CELLS],
+         band_search_t* search) {
+  for (size_t cell = 0; cell < BAND_CELLS; cell++) {
+    if (!colors_is_singleton(givens[cell])) {
+      continue;
+    }
+    size_t color = colors_count(colors_rightmost(givens[cell]) - 1);
+    if (vector_is_empty(band->colors[color] & cell_bits[cell])) {
+      return;
+    }
+    band_place(band, color, cell);
+  }
+
+  if (band_propagate(band)) {
+    band_search(band, search);
+  }
+}
+
+static void
+band_load(band_t* band, const colors_t givens[BAND_CELLS]) {
+  pthread_once(&tables_once, band_tables_init);
+  memset(band, 0, sizeof(band_t));
+
+  for (size_t cell = 0; cell < BAND_CELLS; cell++) {
+    for (size_t color = 0; color < BAND_COLORS; color++) {
+      if (colors_is_in(givens[cell], color)) {
+        band->colors[color] |= cell_bits[cell];
+      }
+    }
+  }
+}
+
+bool
+band_accepts(const grid_t* grid) {
+  return grid_get_size(grid) == BAND_COLORS;
+}
+
+grid_t*
+band_solver(grid_t* grid, _mode_t mode, size_t* solution_count) {
+  if (grid == NULL || !band_accepts(grid)) {
+    return NULL;
+  }
+
+  colors_t givens[BAND_CELLS];
+  for (size_t cell = 0; cell < BAND_CELLS; cell++) {
+    givens[cell] =
+        grid_get_colors(grid, cell / BAND_COLORS, cell % BAND_COLORS);
+  }
+
+  band_t band;
+  band_search_t search = {0, mode == mode_first ? 1 : SIZE_MAX, NULL, grid,
+                          mode, NULL};
+  band_load(&band, givens);
+  band_run(&band, givens, &search);
+
+  *solution_count += search.count;
+  return search.result;
+}
+
+size_t
+band_solve_line(const char* puzzle, char* solution, size_t limit) {
+  colors_t givens[BAND_CELLS];
+
+  for (size_t cell = 0; cell < BAND_CELLS; cell++) {
+    char c = puzzle[cell];
+    givens[cell] = c >= '1' && c <= '9' ? colors_set(c - '1')
+                                        : colors_full(BAND_COLORS);
+  }
+
+  band_t band;
+  band_search_t search = {0, limit, solution, NULL, mode_first, NULL};
+  band_load(&band, givens);
+  band_run(&band, givens, &search);
+
+  return search.count;
+}
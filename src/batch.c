@@ -0,0 +1,89 @@
+#include "batch.h"
+
+#include <grid.h>
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+
+#if BATCH_LANES != 4 && BATCH_LANES != 8 && BATCH_LANES != 16
+#error "BATCH_LANES must be 4, 8 or 16"
+#endif
+
+/* One word of each grid of the batch, and the lanes where a test holds (all
+ * bits set) or not (no bit set) */
+typedef uint32_t batch_lanes_t
+    __attribute__((vector_size(BATCH_LANES * sizeof(uint32_t))));
+typedef int32_t batch_mask_t
+    __attribute__((vector_size(BATCH_LANES * sizeof(int32_t))));
+
+/* The grid in a lane: its index, the branches on its stack, its solutions */
+typedef struct {
+  size_t puzzle;
+  size_t depth;
+  size_t count;
+} batch_lane_t;
+
+/* Color of each character, -1 for the empty cells */
+static signed char color_indices[UCHAR_MAX + 1];
+
+/* Locked candidates cut the search on the harder 16x16 grids by orders of
+ * magnitude, but cost more than they save on 4x4 and 9x9 ones */
+#define KERNEL_SIZE   4
+#define KERNEL_SUFFIX 4
+#define KERNEL_BLOCK  2
+#define KERNEL_LOCK   0
+#include "batch_kernels.h"
+
+#define KERNEL_SIZE   9
+#define KERNEL_SUFFIX 9
+#define KERNEL_BLOCK  3
+#define KERNEL_LOCK   0
+#include "batch_kernels.h"
+
+#define KERNEL_SIZE   16
+#define KERNEL_SUFFIX 16
+#define KERNEL_BLOCK  4
+#define KERNEL_LOCK   1
+#include "batch_kernels.h"
+
+static pthread_once_t color_indices_once = PTHREAD_ONCE_INIT;
+
+static void
+color_indices_init(void) {
+  memset(color_indices, -1, sizeof(color_indices));
+  for (size_t color = 0; color < 16; color++) {
+    color_indices[(unsigned char)color_table[color]] = color;
+  }
+}
+
+bool
+batch_accepts(const size_t size) {
+  return size == 4 || size == 9 || size == 16;
+}
+
+bool
+batch_solve(const size_t size, const size_t count, const char* puzzles,
+            char* solutions, size_t counts[], const size_t limit) {
+  pthread_once(&color_indices_once, color_indices_init);
+
+  switch (size) {
+    case 4:
+      return batch_solve_4(count, puzzles, solutions, counts, limit);
+
+    case 9:
+      return batch_solve_9(count, puzzles, solutions, counts, limit);
+
+    case 16:
+      return batch_solve_16(count, puzzles, solutions, counts, limit);
+
+    default:
+      return false;
+  }
+}
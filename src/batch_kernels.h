@@ -0,0 +1,468 @@
+/* Batch kernels, included once per grid size by batch.c (see kernels.h),
+ * with KERNEL_BLOCK for the block size and KERNEL_LOCK set when the locked
+ * candidates are worth a pass of their own. */
+
+/* Rows of the grid in a 32-bit word, cells of a word, words of a bitboard,
+ * words of a block */
+#define BATCH_ROWS \
+  (KERNEL_SIZE < 32 / KERNEL_SIZE ? KERNEL_SIZE : 32 / KERNEL_SIZE)
+#define BATCH_BITS  (BATCH_ROWS * KERNEL_SIZE)
+#define BATCH_WORDS ((KERNEL_SIZE * KERNEL_SIZE + BATCH_BITS - 1) / BATCH_BITS)
+#define BATCH_BLOCK_WORDS ((KERNEL_BLOCK + BATCH_ROWS - 1) / BATCH_ROWS)
+#define BATCH_ROW_MASK    ((uint32_t)((1ULL << KERNEL_SIZE) - 1))
+#define BATCH_WORD_MASK   ((uint32_t)((1ULL << BATCH_BITS) - 1))
+
+/* One grid: the cells where each color is still possible */
+typedef struct {
+  uint32_t colors[KERNEL_SIZE][BATCH_WORDS];
+} KERNEL(board_t);
+
+/* BATCH_LANES grids, one per lane of each word */
+typedef struct {
+  batch_lanes_t colors[KERNEL_SIZE][BATCH_WORDS];
+} KERNEL(lanes_t);
+
+/* Cells of each block in the words from its first one */
+static uint32_t KERNEL(block_cells)[KERNEL_SIZE][BATCH_BLOCK_WORDS];
+static size_t KERNEL(block_words)[KERNEL_SIZE];
+
+static pthread_once_t KERNEL(tables_once) = PTHREAD_ONCE_INIT;
+
+static void
+KERNEL(tables_init)(void) {
+  for (size_t cell = 0; cell < KERNEL_SIZE * KERNEL_SIZE; cell++) {
+    size_t row = cell / KERNEL_SIZE, column = cell % KERNEL_SIZE;
+    size_t block = (row / KERNEL_BLOCK) * KERNEL_BLOCK + column / KERNEL_BLOCK;
+    size_t first = (row / KERNEL_BLOCK) * KERNEL_BLOCK / BATCH_ROWS;
+
+    KERNEL(block_words)[block] = first;
+    KERNEL(block_cells)[block][cell / BATCH_BITS - first] |=
+        1U << (cell % BATCH_BITS);
+  }
+}
+
+/* A row of the grid given as row bits in each of the rows of a word */
+static inline void
+KERNEL(spread)(const batch_lanes_t* row, batch_lanes_t* word) {
+  *word = *row;
+  for (size_t i = 1; i < BATCH_ROWS; i++) {
+    *word |= *row << (KERNEL_SIZE * i);
+  }
+}
+
+/* One pass of propagation on all lanes at once, from the state they start
+ * in, one color after the other:
+ * - naked singles: a color alone in its cell leaves the other cells of its
+ *   units, and a unit with two such cells of the color is inconsistent;
+ * - hidden singles: a color with a single place in a unit takes its cell,
+ *   and a unit with no place for the color is inconsistent.
+ * Rows and columns are read from the rows of the words, blocks from their
+ * cells. Sets *stuck to the lanes where nothing changed, *failed to the lanes
+ * found inconsistent, *open to the lanes with cells of several colors. */
+static void
+KERNEL(pass)(KERNEL(lanes_t) * lanes, batch_mask_t* stuck,
+             batch_mask_t* failed, batch_mask_t* open) {
+  batch_lanes_t once[BATCH_WORDS];
+  batch_lanes_t twice[BATCH_WORDS];
+  batch_lanes_t hidden[KERNEL_SIZE][BATCH_WORDS];
+  batch_lanes_t hidden_all[BATCH_WORDS];
+  batch_lanes_t removed = {0};
+  batch_lanes_t unsolved = {0};
+  batch_mask_t bad = {0};
+
+  for (size_t word = 0; word < BATCH_WORDS; word++) {
+    once[word] = twice[word] = hidden_all[word] = (batch_lanes_t){0};
+  }
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      twice[word] |= once[word] & lanes->colors[color][word];
+      once[word] |= lanes->colors[color][word];
+    }
+  }
+  for (size_t word = 0; word < BATCH_WORDS; word++) {
+    bad |= (BATCH_WORD_MASK & ~once[word]) != 0;
+    unsolved |= twice[word];
+  }
+  *open = unsolved != 0;
+
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    batch_lanes_t* cells = lanes->colors[color];
+    batch_lanes_t fixed[BATCH_WORDS];
+    batch_lanes_t taken[BATCH_WORDS];
+    batch_lanes_t* single = hidden[color];
+    batch_lanes_t column_once = {0}, column_twice = {0};
+    batch_lanes_t fixed_once = {0}, fixed_twice = {0};
+
+    /* Rows, and the columns from the rows one after the other */
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      fixed[word] = cells[word] & ~twice[word];
+      taken[word] = single[word] = (batch_lanes_t){0};
+      for (size_t i = 0; i < BATCH_ROWS; i++) {
+        const size_t shift = KERNEL_SIZE * i;
+        batch_lanes_t row = (cells[word] >> shift) & BATCH_ROW_MASK;
+        batch_lanes_t row_fixed = (fixed[word] >> shift) & BATCH_ROW_MASK;
+
+        column_twice |= column_once & row;
+        column_once |= row;
+        fixed_twice |= fixed_once & row_fixed;
+        fixed_once |= row_fixed;
+        bad |= (row == 0) | ((row_fixed & (row_fixed - 1)) != 0);
+        single[word] |= (row & (batch_lanes_t)((row & (row - 1)) == 0))
+                        << shift;
+        taken[word] |= (batch_lanes_t)(row_fixed != 0)
+                       & (BATCH_ROW_MASK << shift);
+      }
+    }
+    bad |= (column_once != BATCH_ROW_MASK) | (fixed_twice != 0);
+    column_once &= ~column_twice;
+
+    batch_lanes_t column_single, column_taken;
+    KERNEL(spread)(&column_once, &column_single);
+    KERNEL(spread)(&fixed_once, &column_taken);
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      single[word] |= cells[word] & column_single;
+      taken[word] |= column_taken;
+    }
+
+    /* Blocks */
+    for (size_t block = 0; block < KERNEL_SIZE; block++) {
+      const size_t first = KERNEL(block_words)[block];
+      const uint32_t* block_cells = KERNEL(block_cells)[block];
+      batch_lanes_t place[BATCH_BLOCK_WORDS];
+      batch_lanes_t places = {0}, lower = {0};
+      batch_lanes_t fixed_places = {0}, fixed_lower = {0};
+      batch_mask_t words = {0}, fixed_words = {0};
+
+      for (size_t i = 0; i < BATCH_BLOCK_WORDS; i++) {
+        batch_lanes_t place_fixed = fixed[first + i] & block_cells[i];
+        place[i] = cells[first + i] & block_cells[i];
+        places |= place[i];
+        lower |= place[i] & (place[i] - 1);
+        words += place[i] != 0;
+        fixed_places |= place_fixed;
+        fixed_lower |= place_fixed & (place_fixed - 1);
+        fixed_words += place_fixed != 0;
+      }
+      bad |= (places == 0) | (fixed_lower != 0) | (fixed_words < -1);
+
+      batch_lanes_t has = (batch_lanes_t)(fixed_places != 0);
+      batch_lanes_t alone = (batch_lanes_t)((lower == 0) & (words == -1));
+      for (size_t i = 0; i < BATCH_BLOCK_WORDS; i++) {
+        taken[first + i] |= has & block_cells[i];
+        single[first + i] |= place[i] & alone;
+      }
+    }
+
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      batch_lanes_t gone = cells[word] & taken[word] & ~fixed[word];
+      cells[word] ^= gone;
+      removed |= gone;
+      hidden_all[word] |= single[word];
+    }
+  }
+
+  /* The hidden singles take their cells */
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      batch_lanes_t gone = lanes->colors[color][word] & hidden_all[word]
+                           & ~hidden[color][word];
+      lanes->colors[color][word] ^= gone;
+      removed |= gone;
+    }
+  }
+
+  *stuck = removed == 0;
+  *failed = bad;
+}
+
+/* Locked candidates of every color on all lanes at once, inside each band of
+ * blocks (KERNEL_BLOCK rows) for the rows and across the bands for the
+ * columns: a color of a block confined to one of its rows (or columns) leaves
+ * the rest of that row (or column), and a color of a row (or column) confined
+ * to one block leaves the rest of that block. Sets *stuck to the lanes where
+ * nothing changed. */
+static void
+KERNEL(lock)(KERNEL(lanes_t) * lanes, batch_mask_t* stuck) {
+  batch_lanes_t removed = {0};
+
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    batch_lanes_t* cells = lanes->colors[color];
+    batch_lanes_t rows[KERNEL_SIZE];
+    batch_lanes_t remove[KERNEL_SIZE];
+    batch_lanes_t bands[KERNEL_BLOCK];
+
+    for (size_t row = 0; row < KERNEL_SIZE; row++) {
+      const size_t shift = KERNEL_SIZE * (row % BATCH_ROWS);
+      rows[row] = (cells[row / BATCH_ROWS] >> shift) & BATCH_ROW_MASK;
+      remove[row] = (batch_lanes_t){0};
+    }
+    for (size_t band = 0; band < KERNEL_BLOCK; band++) {
+      bands[band] = (batch_lanes_t){0};
+      for (size_t i = 0; i < KERNEL_BLOCK; i++) {
+        bands[band] |= rows[band * KERNEL_BLOCK + i];
+      }
+    }
+
+    for (size_t band = 0; band < KERNEL_BLOCK; band++) {
+      batch_lanes_t* band_rows = &rows[band * KERNEL_BLOCK];
+      batch_lanes_t* band_remove = &remove[band * KERNEL_BLOCK];
+      batch_lanes_t outside = {0};
+      batch_lanes_t others[KERNEL_BLOCK];
+      batch_lanes_t band_columns = {0};
+
+      for (size_t i = 0; i < KERNEL_BLOCK; i++) {
+        if (i != band) {
+          outside |= bands[i];
+        }
+        others[i] = (batch_lanes_t){0};
+        for (size_t j = 0; j < KERNEL_BLOCK; j++) {
+          if (j != i) {
+            others[i] |= band_rows[j];
+          }
+        }
+      }
+      /* Columns of the band found in no other band */
+      batch_lanes_t claimed = bands[band] & ~outside;
+
+      for (size_t block = 0; block < KERNEL_BLOCK; block++) {
+        const uint32_t columns = ((1U << KERNEL_BLOCK) - 1)
+                                 << (KERNEL_BLOCK * block);
+        batch_lanes_t places = bands[band] & columns;
+        batch_lanes_t block_claimed = claimed & columns;
+
+        /* A block confined to a column: not in the other bands */
+        band_columns |=
+            places & (batch_lanes_t)((places & (places - 1)) == 0);
+
+        /* A column confined to the block: not in its other columns */
+        batch_lanes_t rest = (columns & ~block_claimed)
+                             & (batch_lanes_t)(block_claimed != 0);
+
+        for (size_t i = 0; i < KERNEL_BLOCK; i++) {
+          /* A block confined to a row: not in the rest of the row */
+          batch_mask_t alone =
+              ((others[i] & columns) == 0) & ((band_rows[i] & columns) != 0);
+          band_remove[i] |=
+              rest | ((batch_lanes_t)alone & (BATCH_ROW_MASK & ~columns));
+
+          /* A row confined to the block: not in its other rows */
+          batch_lanes_t within =
+              (batch_lanes_t)((band_rows[i] & ~columns) == 0) & columns;
+          for (size_t j = 0; j < KERNEL_BLOCK; j++) {
+            if (j != i) {
+              band_remove[j] |= within;
+            }
+          }
+        }
+      }
+      for (size_t row = 0; row < KERNEL_SIZE; row++) {
+        if (row / KERNEL_BLOCK != band) {
+          remove[row] |= band_columns;
+        }
+      }
+    }
+
+    for (size_t row = 0; row < KERNEL_SIZE; row++) {
+      batch_lanes_t* word = &cells[row / BATCH_ROWS];
+      batch_lanes_t gone =
+          *word & (remove[row] << (KERNEL_SIZE * (row % BATCH_ROWS)));
+      *word ^= gone;
+      removed |= gone;
+    }
+  }
+
+  *stuck = removed == 0;
+}
+
+static void
+KERNEL(lane_get)(const KERNEL(lanes_t) * lanes, const size_t lane,
+                 KERNEL(board_t) * board) {
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      board->colors[color][word] = lanes->colors[color][word][lane];
+    }
+  }
+}
+
+static void
+KERNEL(lane_put)(KERNEL(lanes_t) * lanes, const size_t lane,
+                 const KERNEL(board_t) * board) {
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      lanes->colors[color][word][lane] = board->colors[color][word];
+    }
+  }
+}
+
+static void
+KERNEL(board_load)(KERNEL(board_t) * board, const char* puzzle) {
+  memset(board, 0, sizeof(*board));
+  for (size_t cell = 0; cell < KERNEL_SIZE * KERNEL_SIZE; cell++) {
+    int color = color_indices[(unsigned char)puzzle[cell]];
+    uint32_t bit = 1U << (cell % BATCH_BITS);
+
+    for (size_t i = 0; i < KERNEL_SIZE; i++) {
+      if (color < 0 || color >= KERNEL_SIZE || (size_t)color == i) {
+        board->colors[i][cell / BATCH_BITS] |= bit;
+      }
+    }
+  }
+}
+
+static void
+KERNEL(board_write)(const KERNEL(board_t) * board, char* solution) {
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      for (uint32_t left = board->colors[color][word]; left != 0;
+           left &= left - 1) {
+        solution[word * BATCH_BITS + __builtin_ctz(left)] = color_table[color];
+      }
+    }
+  }
+}
+
+/* Split an open board on a cell with two colors if any, else on one with the
+ * fewest: the board takes its first color, *other every other one. */
+static void
+KERNEL(board_branch)(KERNEL(board_t) * board, KERNEL(board_t) * other) {
+  uint32_t once[BATCH_WORDS] = {0};
+  uint32_t twice[BATCH_WORDS] = {0};
+  uint32_t more[BATCH_WORDS] = {0};
+  size_t best = KERNEL_SIZE * KERNEL_SIZE;
+  size_t best_count = KERNEL_SIZE + 1;
+
+  for (size_t color = 0; color < KERNEL_SIZE; color++) {
+    for (size_t word = 0; word < BATCH_WORDS; word++) {
+      more[word] |= twice[word] & board->colors[color][word];
+      twice[word] |= once[word] & board->colors[color][word];
+      once[word] |= board->colors[color][word];
+    }
+  }
+  for (size_t word = 0; word < BATCH_WORDS && best_count > 2; word++) {
+    if ((twice[word] & ~more[word]) != 0) {
+      best = word * BATCH_BITS + __builtin_ctz(twice[word] & ~more[word]);
+      best_count = 2;
+    }
+  }
+  for (size_t word = 0; word < BATCH_WORDS && best_count > 2; word++) {
+    for (uint32_t left = twice[word]; left != 0; left &= left - 1) {
+      uint32_t bit = left & -left;
+      size_t count = 0;
+      for (size_t color = 0; color < KERNEL_SIZE; color++) {
+        count += (board->colors[color][word] & bit) != 0;
+      }
+      if (count < best_count) {
+        best = word * BATCH_BITS + __builtin_ctz(left);
+        best_count = count;
+      }
+    }
+  }
+
+  size_t word = best / BATCH_BITS;
+  uint32_t bit = 1U << (best % BATCH_BITS);
+  size_t color = 0;
+  while ((board->colors[color][word] & bit) == 0) {
+    color++;
+  }
+  *other = *board;
+  other->colors[color][word] &= ~bit;
+  for (size_t i = color + 1; i < KERNEL_SIZE; i++) {
+    board->colors[i][word] &= ~bit;
+  }
+}
+
+static bool
+KERNEL(batch_solve)(const size_t count, const char* puzzles, char* solutions,
+                    size_t counts[], const size_t limit) {
+  const size_t cells = KERNEL_SIZE * KERNEL_SIZE;
+  KERNEL(lanes_t) lanes;
+  KERNEL(board_t) board;
+  batch_lane_t states[BATCH_LANES];
+  size_t next = 0;
+  size_t active = 0;
+
+  /* A lane branches at most once per cell before its grid is done */
+  KERNEL(board_t)* stacks = malloc(BATCH_LANES * cells * sizeof(board));
+  if (stacks == NULL) {
+    return false;
+  }
+  pthread_once(&KERNEL(tables_once), KERNEL(tables_init));
+
+  memset(&lanes, 0, sizeof(lanes));
+  for (size_t lane = 0; lane < BATCH_LANES; lane++) {
+    states[lane].puzzle = count;
+    if (next < count) {
+      KERNEL(board_load)(&board, &puzzles[next * cells]);
+      KERNEL(lane_put)(&lanes, lane, &board);
+      states[lane] = (batch_lane_t){next++, 0, 0};
+      active++;
+    }
+  }
+
+  while (active > 0) {
+    batch_mask_t stuck, failed, open;
+    KERNEL(pass)(&lanes, &stuck, &failed, &open);
+
+    /* Locked candidates once singles are not enough for a lane */
+    for (size_t lane = 0; KERNEL_LOCK && lane < BATCH_LANES; lane++) {
+      if (states[lane].puzzle != count && stuck[lane] && !failed[lane]
+          && open[lane]) {
+        batch_mask_t locked;
+        KERNEL(lock)(&lanes, &locked);
+        stuck &= locked;
+        break;
+      }
+    }
+
+    for (size_t lane = 0; lane < BATCH_LANES; lane++) {
+      batch_lane_t* state = &states[lane];
+      KERNEL(board_t)* stack = &stacks[lane * cells];
+
+      if (state->puzzle == count || !(failed[lane] || stuck[lane])) {
+        continue;
+      }
+
+      /* Solved or inconsistent: next branch, or next grid once none is left */
+      if (failed[lane] || !open[lane]) {
+        if (!failed[lane]) {
+          if (state->count == 0 && solutions != NULL) {
+            KERNEL(lane_get)(&lanes, lane, &board);
+            KERNEL(board_write)(&board, &solutions[state->puzzle * cells]);
+          }
+          state->count++;
+        }
+        if (state->depth > 0 && state->count < limit) {
+          KERNEL(lane_put)(&lanes, lane, &stack[--state->depth]);
+          continue;
+        }
+
+        counts[state->puzzle] = state->count;
+        if (next == count) {
+          state->puzzle = count;
+          active--;
+          continue;
+        }
+        KERNEL(board_load)(&board, &puzzles[next * cells]);
+        *state = (batch_lane_t){next++, 0, 0};
+      } else {
+        KERNEL(lane_get)(&lanes, lane, &board);
+        KERNEL(board_branch)(&board, &stack[state->depth++]);
+      }
+      KERNEL(lane_put)(&lanes, lane, &board);
+    }
+  }
+
+  free(stacks);
+  return true;
+}
+
+#undef BATCH_ROWS
+#undef BATCH_BITS
+#undef BATCH_WORDS
+#undef BATCH_BLOCK_WORDS
+#undef BATCH_ROW_MASK
+#undef BATCH_WORD_MASK
+#undef KERNEL_SIZE
+#undef KERNEL_SUFFIX
+#undef KERNEL_BLOCK
+#undef KERNEL_LOCK
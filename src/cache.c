@@ -0,0 +1,364 @@
+#define _DEFAULT_SOURCE
+
+#include "cache.h"
+
+#include <colors.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* First bytes of a file of the cache, ending with its version */
+#define CACHE_MAGIC "SKUCACH1"
+
+/* Longest path of a file of the cache */
+#define PATH_LENGTH 4096
+
+/* What a slot holds */
+enum { slot_free, slot_solved, slot_unsolvable };
+
+/* Head of a table, the first bytes of its file */
+typedef struct {
+  char magic[8];
+  uint64_t size;
+  uint64_t sets;
+  uint64_t clock; /* Stamp of the last use of a slot */
+} header_t;
+
+/* Head of a slot, followed by the form of its grid and the solution of the
+ * form, size * size bytes each */
+typedef struct {
+  uint64_t hash;
+  uint64_t stamp;
+  uint64_t status;
+} slot_t;
+
+/* The slots of one grid size: sets of CACHE_WAYS slots, a grid going to the
+ * set of its hash */
+typedef struct {
+  header_t* header;
+  unsigned char* slots;
+  size_t stride;
+  size_t length; /* Of the mapping */
+  int fd;        /* Of the file, -1 for a table in memory */
+} table_t;
+
+struct _cache_t {
+  pthread_mutex_t lock;
+  size_t sets;
+  char path[PATH_LENGTH];
+  bool persistent;
+  size_t hits;
+  size_t misses;
+  table_t* tables[MAX_GRID_SIZE + 1];
+};
+
+cache_t*
+cache_alloc(const size_t entries, const char* path) {
+  if (entries < CACHE_WAYS
+      || (path != NULL && strlen(path) >= PATH_LENGTH)) {
+    return NULL;
+  }
+
+  cache_t* cache = calloc(1, sizeof(cache_t));
+  if (cache == NULL) {
+    return NULL;
+  }
+  if (pthread_mutex_init(&cache->lock, NULL)) {
+    free(cache);
+    return NULL;
+  }
+
+  cache->sets = entries / CACHE_WAYS;
+  if (path != NULL) {
+    strcpy(cache->path, path);
+    cache->persistent = true;
+  }
+  return cache;
+}
+
+static void
+table_free(table_t* table) {
+  munmap(table->header, table->length);
+  if (table->fd >= 0) {
+    close(table->fd);
+  }
+  free(table);
+}
+
+void
+cache_free(cache_t* cache) {
+  if (cache == NULL) {
+    return;
+  }
+
+  for (size_t size = 0; size <= MAX_GRID_SIZE; size++) {
+    if (cache->tables[size] != NULL) {
+      table_free(cache->tables[size]);
+    }
+  }
+  pthread_mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+/* Map the table of a size from its file, locked for this process, or from
+ * memory: the file keeps its slots if it holds a table of the same shape */
+static table_t*
+table_alloc(cache_t* cache, const size_t size) {
+  table_t* table = malloc(sizeof(table_t));
+  if (table == NULL) {
+    return NULL;
+  }
+
+  table->stride = (sizeof(slot_t) + 2 * size * size + 7) & ~(size_t)7;
+  table->length = sizeof(header_t) + cache->sets * CACHE_WAYS * table->stride;
+  table->fd = -1;
+  table->header = MAP_FAILED;
+
+  if (cache->persistent) {
+    char path[PATH_LENGTH + 32];
+
+    snprintf(path, sizeof(path), "%s.%zu", cache->path, size);
+    table->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (table->fd >= 0
+        && (flock(table->fd, LOCK_EX | LOCK_NB)
+            || ftruncate(table->fd, table->length))) {
+      close(table->fd);
+      table->fd = -1;
+    }
+    if (table->fd >= 0) {
+      table->header = mmap(NULL, table->length, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, table->fd, 0);
+    }
+  }
+  if (table->header == MAP_FAILED) {
+    if (table->fd >= 0) {
+      close(table->fd);
+      table->fd = -1;
+    }
+    table->header = mmap(NULL, table->length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (table->header == MAP_FAILED) {
+    free(table);
+    return NULL;
+  }
+  table->slots = (unsigned char*)(table->header + 1);
+
+  header_t* header = table->header;
+
+  if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic))
+      || header->size != size || header->sets != cache->sets) {
+    memset(table->header, 0, table->length);
+    memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+    header->size = size;
+    header->sets = cache->sets;
+  }
+  return table;
+}
+
+static slot_t*
+table_slot(const table_t* table, const size_t index) {
+  return (slot_t*)(table->slots + index * table->stride);
+}
+
+/* The slot of a form in its set, NULL if it is not in the cache */
+static slot_t*
+table_find(const table_t* table, const canon_t* canon) {
+  const size_t first = canon->hash % table->header->sets * CACHE_WAYS;
+
+  for (size_t i = first; i < first + CACHE_WAYS; i++) {
+    slot_t* slot = table_slot(table, i);
+
+    if (slot->status != slot_free && slot->hash == canon->hash
+        && !memcmp(slot + 1, canon->form, canon->size * canon->size)) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+/* The table of a size, allocated on first use, with the cache locked */
+static table_t*
+cache_table(cache_t* cache, const size_t size) {
+  if (cache->tables[size] == NULL) {
+    cache->tables[size] = table_alloc(cache, size);
+  }
+  return cache->tables[size];
+}
+
+/* Move the solution of a slot back to the grid, checking it is one of the
+ * grid: each unit holds every color once, and each cell one of the colors
+ * the grid leaves it (the slot of a damaged file holds anything) */
+static bool
+solution_restore(const canon_t* canon, const uint8_t* image,
+                 const grid_t* grid, uint8_t* cells) {
+  const size_t size = canon->size;
+  size_t block_size = 1;
+
+  for (size_t cell = 0; cell < size * size; cell++) {
+    if (image[cell] == 0 || image[cell] > size) {
+      return false;
+    }
+  }
+  canon_restore(canon, image, cells);
+
+  while (block_size * block_size < size) {
+    block_size++;
+  }
+  for (size_t unit = 0; unit < size; unit++) {
+    colors_t row = colors_empty();
+    colors_t column = colors_empty();
+    colors_t block = colors_empty();
+
+    for (size_t i = 0; i < size; i++) {
+      size_t block_cell = (unit / block_size * block_size + i / block_size)
+                              * size
+                          + unit % block_size * block_size + i % block_size;
+      uint8_t color = cells[unit * size + i] - 1;
+
+      if (!colors_is_in(grid_get_colors(grid, unit, i), color)) {
+        return false;
+      }
+      row = colors_or(row, colors_set(color));
+      column = colors_or(column, colors_set(cells[i * size + unit] - 1));
+      block = colors_or(block, colors_set(cells[block_cell] - 1));
+    }
+    if (row != colors_full(size) || column != colors_full(size)
+        || block != colors_full(size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+cache_lookup(cache_t* cache, const canon_t* canon, const grid_t* grid,
+             grid_t** solution) {
+  const size_t size = canon->size;
+  uint8_t image[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  uint64_t status = slot_free;
+
+  *solution = NULL;
+
+  pthread_mutex_lock(&cache->lock);
+  table_t* table = cache_table(cache, size);
+  slot_t* slot = table != NULL ? table_find(table, canon) : NULL;
+
+  if (slot != NULL) {
+    slot->stamp = ++table->header->clock;
+    status = slot->status;
+    if (status == slot_solved) {
+      memcpy(image, (unsigned char*)(slot + 1) + size * size, size * size);
+    }
+  } else {
+    cache->misses++;
+  }
+  pthread_mutex_unlock(&cache->lock);
+
+  uint8_t cells[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  bool valid = status == slot_unsolvable;
+
+  if (status == slot_solved) {
+    valid = solution_restore(canon, image, grid, cells);
+  }
+  if (slot != NULL) {
+    pthread_mutex_lock(&cache->lock);
+    if (valid) {
+      cache->hits++;
+    } else {
+      /* Freed, the grid being solved again and stored anew */
+      cache->misses++;
+      slot = table_find(table, canon);
+      if (slot != NULL) {
+        slot->status = slot_free;
+      }
+    }
+    pthread_mutex_unlock(&cache->lock);
+  }
+
+  if (status == slot_solved && valid) {
+    grid_t* result = grid_copy(grid);
+
+    if (result == NULL) {
+      return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+      for (size_t j = 0; j < size; j++) {
+        grid_set_colors(result, i, j, colors_set(cells[i * size + j] - 1));
+      }
+    }
+    *solution = result;
+  }
+  return valid;
+}
+
+void
+cache_store(cache_t* cache, const canon_t* canon, const grid_t* solution) {
+  const size_t size = canon->size;
+  uint8_t cells[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  uint8_t image[MAX_GRID_SIZE * MAX_GRID_SIZE];
+
+  if (solution != NULL) {
+    for (size_t i = 0; i < size; i++) {
+      for (size_t j = 0; j < size; j++) {
+        colors_t colors = grid_get_colors(solution, i, j);
+        uint8_t cell = 0;
+
+        while (!colors_is_in(colors, cell)) {
+          cell++;
+        }
+        cells[i * size + j] = cell + 1;
+      }
+    }
+    canon_apply(canon, cells, image);
+  }
+
+  pthread_mutex_lock(&cache->lock);
+  table_t* table = cache_table(cache, size);
+
+  if (table != NULL && table_find(table, canon) == NULL) {
+    const size_t first = canon->hash % table->header->sets * CACHE_WAYS;
+    slot_t* slot = table_slot(table, first);
+
+    /* A free slot, or the least recently used one */
+    for (size_t i = first; i < first + CACHE_WAYS; i++) {
+      slot_t* other = table_slot(table, i);
+
+      if (other->status == slot_free || other->stamp < slot->stamp) {
+        slot = other;
+      }
+      if (other->status == slot_free) {
+        break;
+      }
+    }
+
+    unsigned char* form = (unsigned char*)(slot + 1);
+
+    slot->hash = canon->hash;
+    slot->stamp = ++table->header->clock;
+    slot->status = solution != NULL ? slot_solved : slot_unsolvable;
+    memcpy(form, canon->form, size * size);
+    if (solution != NULL) {
+      memcpy(form + size * size, image, size * size);
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+void
+cache_print(cache_t* cache, FILE* fd) {
+  pthread_mutex_lock(&cache->lock);
+  fprintf(fd, "Solution cache: %zu hits, %zu misses\n", cache->hits,
+          cache->misses);
+  pthread_mutex_unlock(&cache->lock);
+}
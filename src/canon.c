@@ -0,0 +1,394 @@
+#include "canon.h"
+
+#include <colors.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* What the search tells apart, in the order it picks them */
+typedef enum {
+  kind_bands,
+  kind_stacks,
+  kind_rows,
+  kind_columns,
+  kind_labels,
+  kinds
+} kind_t;
+
+/* A given cell */
+typedef struct {
+  uint8_t row;
+  uint8_t column;
+  uint8_t label;
+} given_t;
+
+/* The grid being searched, and the best leaf so far */
+typedef struct {
+  size_t size;
+  size_t block;
+  size_t counts[kinds];
+  const uint8_t* cells;
+  given_t givens[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  size_t givens_count;
+  bool empty[kind_columns + 1][MAX_GRID_SIZE]; /* No given in it */
+  bool transposed;
+  size_t leaves;
+  bool found;
+  canon_t* best;
+  uint8_t image[MAX_GRID_SIZE * MAX_GRID_SIZE];
+} search_t;
+
+/* The color of everything, the rank of its class: the class of color c holds
+ * the elements of colors c to c + its length - 1 once sorted */
+typedef struct {
+  uint8_t of[kinds][MAX_GRID_SIZE];
+} coloring_t;
+
+static uint64_t
+mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static uint64_t
+mix2(const uint64_t a, const uint64_t b) {
+  return mix(mix(a) ^ b);
+}
+
+/* Splits the classes of one kind by the hashes of their elements, keeping
+ * their order: returns the number of classes */
+static size_t
+rerank(uint8_t* colors, const uint64_t* hashes, const size_t count) {
+  uint8_t order[MAX_GRID_SIZE];
+
+  for (size_t i = 0; i < count; i++) {
+    size_t j = i;
+
+    for (; j > 0; j--) {
+      uint8_t k = order[j - 1];
+
+      if (colors[k] < colors[i]
+          || (colors[k] == colors[i] && hashes[k] <= hashes[i])) {
+        break;
+      }
+      order[j] = k;
+    }
+    order[j] = i;
+  }
+
+  uint8_t ranks[MAX_GRID_SIZE];
+  size_t classes = 0;
+
+  for (size_t j = 0; j < count; j++) {
+    uint8_t k = order[j];
+
+    if (j == 0 || colors[k] != colors[order[j - 1]]
+        || hashes[k] != hashes[order[j - 1]]) {
+      ranks[k] = j;
+      classes++;
+    } else {
+      ranks[k] = ranks[order[j - 1]];
+    }
+  }
+  memcpy(colors, ranks, count);
+  return classes;
+}
+
+/* Splits the classes by what their elements hold, until no class splits */
+static void
+refine(const search_t* search, coloring_t* coloring) {
+  const size_t block = search->block;
+  size_t classes = 0;
+  size_t previous;
+
+  do {
+    uint64_t hashes[kinds][MAX_GRID_SIZE];
+    uint8_t(*of)[MAX_GRID_SIZE] = coloring->of;
+
+    for (size_t i = 0; i < search->size; i++) {
+      hashes[kind_rows][i] = mix2(kind_bands, of[kind_bands][i / block]);
+      hashes[kind_columns][i] = mix2(kind_stacks, of[kind_stacks][i / block]);
+      hashes[kind_labels][i] = 0;
+    }
+    for (size_t i = 0; i < search->givens_count; i++) {
+      const given_t* given = &search->givens[i];
+      uint64_t row = of[kind_rows][given->row];
+      uint64_t column = of[kind_columns][given->column];
+      uint64_t label = of[kind_labels][given->label];
+
+      hashes[kind_rows][given->row] += mix2(column, label);
+      hashes[kind_columns][given->column] += mix2(row, label);
+      hashes[kind_labels][given->label] += mix2(row, column);
+    }
+    for (size_t i = 0; i < block; i++) {
+      hashes[kind_bands][i] = 0;
+      hashes[kind_stacks][i] = 0;
+      for (size_t j = i * block; j < (i + 1) * block; j++) {
+        hashes[kind_bands][i] += mix(of[kind_rows][j]);
+        hashes[kind_stacks][i] += mix(of[kind_columns][j]);
+      }
+    }
+
+    previous = classes;
+    classes = 0;
+    for (kind_t kind = 0; kind < kinds; kind++) {
+      classes += rerank(of[kind], hashes[kind], search->counts[kind]);
+    }
+  } while (classes != previous);
+}
+
+/* Orders the rows (or columns) of the leaf: bands by color, then the rows of
+ * each band by color */
+static void
+leaf_order(const search_t* search, const uint8_t* outer, const uint8_t* inner,
+           uint8_t* order) {
+  const size_t block = search->block;
+
+  for (size_t band = 0; band < block; band++) {
+    uint8_t* lines = order + outer[band] * block;
+
+    for (size_t i = band * block; i < (band + 1) * block; i++) {
+      size_t j = i - band * block;
+
+      for (; j > 0 && inner[lines[j - 1]] > inner[i]; j--) {
+        lines[j] = lines[j - 1];
+      }
+      lines[j] = i;
+    }
+  }
+}
+
+/* Builds the form of a leaf, the colors being numbered in the order they come,
+ * and keeps it if it is the smallest one */
+static void
+leaf(search_t* search, const coloring_t* coloring) {
+  const size_t size = search->size;
+  uint8_t rows[MAX_GRID_SIZE];
+  uint8_t columns[MAX_GRID_SIZE];
+  uint8_t labels[MAX_GRID_SIZE + 1] = {0};
+  uint8_t next = 1;
+
+  search->leaves++;
+  leaf_order(search, coloring->of[kind_bands], coloring->of[kind_rows], rows);
+  leaf_order(search, coloring->of[kind_stacks], coloring->of[kind_columns],
+             columns);
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      uint8_t cell = search->cells[rows[i] * size + columns[j]];
+
+      if (cell && !labels[cell]) {
+        labels[cell] = next++;
+      }
+      search->image[i * size + j] = labels[cell];
+    }
+  }
+
+  canon_t* best = search->best;
+
+  if (search->found && memcmp(search->image, best->form, size * size) >= 0) {
+    return;
+  }
+  search->found = true;
+  memcpy(best->form, search->image, size * size);
+  memcpy(best->rows, rows, size);
+  memcpy(best->columns, columns, size);
+  best->transposed = search->transposed;
+  for (size_t color = 0; color < size; color++) {
+    if (!labels[color + 1]) {
+      labels[color + 1] = next++;
+    }
+    best->colors[color] = labels[color + 1] - 1;
+  }
+}
+
+/* Picks each element of the first class that does not split, and refines,
+ * down to the leaves where every line is told apart */
+static void
+search_tree(search_t* search, const coloring_t* coloring) {
+  for (kind_t kind = kind_bands; kind <= kind_columns; kind++) {
+    const uint8_t* of = coloring->of[kind];
+    size_t count = search->counts[kind];
+    size_t target = count;
+
+    /* The smallest color held by two elements */
+    for (size_t i = 0; i < count; i++) {
+      for (size_t j = i + 1; j < count; j++) {
+        if (of[i] == of[j] && (target == count || of[i] < of[target])) {
+          target = i;
+        }
+      }
+    }
+    if (target == count) {
+      continue;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      if (of[i] != of[target]) {
+        continue;
+      }
+      if (search->leaves >= CANON_LEAVES_MAX) {
+        return;
+      }
+
+      coloring_t child = *coloring;
+
+      for (size_t j = 0; j < count; j++) {
+        if (j != i && of[j] == of[target]) {
+          child.of[kind][j]++;
+        }
+      }
+      refine(search, &child);
+      search_tree(search, &child);
+
+      /* Empty lines of a class are alike: the first one stands for all */
+      if (search->empty[kind][i]) {
+        return;
+      }
+    }
+    return;
+  }
+  leaf(search, coloring);
+}
+
+static void
+search_grid(search_t* search, const uint8_t* cells, const bool transposed) {
+  const size_t size = search->size;
+  const size_t block = search->block;
+  coloring_t coloring;
+
+  search->cells = cells;
+  search->transposed = transposed;
+  search->givens_count = 0;
+  memset(search->empty, true, sizeof(search->empty));
+  memset(&coloring, 0, sizeof(coloring));
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      uint8_t cell = cells[i * size + j];
+
+      if (cell) {
+        search->givens[search->givens_count++]
+            = (given_t){.row = i, .column = j, .label = cell - 1};
+        search->empty[kind_rows][i] = false;
+        search->empty[kind_columns][j] = false;
+        search->empty[kind_bands][i / block] = false;
+        search->empty[kind_stacks][j / block] = false;
+      }
+    }
+  }
+
+  refine(search, &coloring);
+  search_tree(search, &coloring);
+}
+
+static uint64_t
+form_hash(const canon_t* canon) {
+  const size_t cells = canon->size * canon->size;
+  uint64_t hash = mix(canon->size);
+
+  for (size_t i = 0; i < cells; i += 8) {
+    uint64_t word = 0;
+
+    memcpy(&word, canon->form + i, cells - i < 8 ? cells - i : 8);
+    hash = mix(hash ^ word);
+  }
+  return hash;
+}
+
+bool
+canon_compute(const size_t size, const uint8_t* cells, canon_t* canon) {
+  static _Thread_local search_t search;
+  static _Thread_local uint8_t transpose[MAX_GRID_SIZE * MAX_GRID_SIZE];
+
+  search.size = size;
+  search.block = (size_t)sqrt((double)size);
+  search.counts[kind_bands] = search.block;
+  search.counts[kind_stacks] = search.block;
+  search.counts[kind_rows] = size;
+  search.counts[kind_columns] = size;
+  search.counts[kind_labels] = size;
+  search.leaves = 0;
+  search.found = false;
+  search.best = canon;
+  canon->size = size;
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      transpose[j * size + i] = cells[i * size + j];
+    }
+  }
+  search_grid(&search, cells, false);
+  search_grid(&search, transpose, true);
+
+  canon->exact = search.leaves < CANON_LEAVES_MAX;
+  canon->hash = form_hash(canon);
+  return canon->exact;
+}
+
+bool
+canon_compute_grid(const grid_t* grid, canon_t* canon) {
+  static _Thread_local uint8_t cells[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  const size_t size = grid_get_size(grid);
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      colors_t colors = grid_get_colors(grid, i, j);
+      uint8_t cell = 0;
+
+      if (colors_is_singleton(colors)) {
+        while (!colors_is_in(colors, cell)) {
+          cell++;
+        }
+        cell++;
+      } else if (colors_count(colors) != size) {
+        return false;
+      }
+      cells[i * size + j] = cell;
+    }
+  }
+  canon_compute(size, cells, canon);
+  return true;
+}
+
+void
+canon_apply(const canon_t* canon, const uint8_t* cells, uint8_t* image) {
+  const size_t size = canon->size;
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      size_t row = canon->rows[i];
+      size_t column = canon->columns[j];
+      uint8_t cell = canon->transposed ? cells[column * size + row]
+                                       : cells[row * size + column];
+
+      image[i * size + j] = cell ? canon->colors[cell - 1] + 1 : 0;
+    }
+  }
+}
+
+void
+canon_restore(const canon_t* canon, const uint8_t* image, uint8_t* cells) {
+  const size_t size = canon->size;
+  uint8_t labels[MAX_GRID_SIZE];
+
+  for (size_t color = 0; color < size; color++) {
+    labels[canon->colors[color]] = color;
+  }
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      size_t row = canon->rows[i];
+      size_t column = canon->columns[j];
+      uint8_t cell = image[i * size + j];
+      uint8_t* target = canon->transposed ? &cells[column * size + row]
+                                          : &cells[row * size + column];
+
+      *target = cell ? labels[cell - 1] + 1 : 0;
+    }
+  }
+}
@@ -0,0 +1,983 @@
+#include "cdcl.h"
+
+#include <colors.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Literals are 2 * variable + sign, the variable cell * size + color being true
+ * when the cell holds the color. */
+typedef uint32_t lit_t;
+
+#define LIT_POS(var) ((lit_t)(var) << 1)
+#define LIT_NEG(var) (((lit_t)(var) << 1) | 1)
+#define LIT_VAR(lit) ((lit) >> 1)
+#define LIT_NOT(lit) ((lit) ^ 1)
+
+/* Value of a variable, or of a literal once its sign is applied */
+typedef enum { value_true, value_false, value_undef } value_t;
+
+/* Reason of an assignment: a decision (or a level 0 fact), the index of the
+ * clause which became unit, or REASON_AMO(var) when it was falsified by the
+ * "at most one" constraint of a true variable. */
+#define REASON_NONE   (-1)
+#define REASON_AMO(v) (-2 - (int32_t)(v))
+#define AMO_VAR(r)    ((uint32_t)(-2 - (r)))
+
+/* Conflicts between two restarts, times the Luby sequence */
+#define RESTART_BASE 64
+
+/* Learnt clauses kept before the first reduction, grows by 10% each time */
+#define LEARNTS_MIN 4000
+
+#define VAR_DECAY    0.95
+#define CLAUSE_DECAY 0.999
+
+typedef struct {
+  uint32_t* data;
+  uint32_t size;
+  uint32_t capacity;
+} vec_t;
+
+typedef struct {
+  lit_t* lits; /* The two first literals are the watched ones */
+  uint32_t size;
+  uint32_t lbd; /* Number of decision levels in the clause when learnt */
+  double activity;
+  bool learnt;
+} clause_t;
+
+typedef struct {
+  size_t size;
+  size_t block_size;
+  size_t vars;
+  bool failed; /* Out of memory, the search is abandoned */
+
+  uint8_t* assigns;
+  uint32_t* levels;
+  int32_t* reasons;
+
+  lit_t* trail;
+  size_t trail_size;
+  size_t qhead;
+  size_t* trail_lim; /* Start of each decision level in the trail */
+  size_t decision_level;
+
+  clause_t* clauses;
+  size_t clause_count;
+  size_t clause_capacity;
+  size_t learnt_count;
+  size_t max_learnts;
+  vec_t* watches; /* Clauses watching each literal */
+
+  const lit_t* conflict;
+  size_t conflict_size;
+  int32_t conflict_index; /* Clause of the conflict, if any */
+  lit_t conflict_pair[2];
+
+  double* activity;
+  double var_inc;
+  double clause_inc;
+  uint32_t* heap; /* Binary max-heap of variables by activity */
+  uint32_t* heap_index;
+  size_t heap_size;
+
+  uint8_t* seen;
+  uint32_t* level_stamps;
+  uint32_t stamp;
+  vec_t learnt;
+  vec_t to_clear;
+} solver_t;
+
+/* Counters of the calling thread */
+static _Thread_local struct {
+  size_t conflicts;
+  size_t decisions;
+  size_t propagations;
+  size_t learnts;
+  size_t restarts;
+} stats;
+
+static bool
+vec_push(vec_t* vec, const uint32_t value) {
+  if (vec->size == vec->capacity) {
+    uint32_t capacity = vec->capacity ? 2 * vec->capacity : 4;
+    uint32_t* data = realloc(vec->data, capacity * sizeof(uint32_t));
+    if (data == NULL) {
+      return false;
+    }
+    vec->data = data;
+    vec->capacity = capacity;
+  }
+  vec->data[vec->size++] = value;
+  return true;
+}
+
+static value_t
+lit_value(const solver_t* solver, const lit_t lit) {
+  uint8_t value = solver->assigns[LIT_VAR(lit)];
+  return value == value_undef ? value_undef : (value_t)(value ^ (lit & 1));
+}
+
+/* VSIDS heap */
+
+static bool
+heap_less(const solver_t* solver, const uint32_t var1, const uint32_t var2) {
+  return solver->activity[var1] > solver->activity[var2];
+}
+
+static void
+heap_up(solver_t* solver, size_t index) {
+  uint32_t var = solver->heap[index];
+
+  while (index > 0 && heap_less(solver, var, solver->heap[(index - 1) / 2])) {
+    solver->heap[index] = solver->heap[(index - 1) / 2];
+    solver->heap_index[solver->heap[index]] = index;
+    index = (index - 1) / 2;
+  }
+  solver->heap[index] = var;
+  solver->heap_index[var] = index;
+}
+
+static void
+heap_down(solver_t* solver, size_t index) {
+  uint32_t var = solver->heap[index];
+
+  while (2 * index + 1 < solver->heap_size) {
+    size_t child = 2 * index + 1;
+    if (child + 1 < solver->heap_size
+        && heap_less(solver, solver->heap[child + 1], solver->heap[child])) {
+      child++;
+    }
+    if (!heap_less(solver, solver->heap[child], var)) {
+      break;
+    }
+    solver->heap[index] = solver->heap[child];
+    solver->heap_index[solver->heap[index]] = index;
+    index = child;
+  }
+  solver->heap[index] = var;
+  solver->heap_index[var] = index;
+}
+
+static void
+heap_insert(solver_t* solver, const uint32_t var) {
+  if (solver->heap_index[var] != UINT32_MAX) {
+    return;
+  }
+  solver->heap[solver->heap_size] = var;
+  heap_up(solver, solver->heap_size++);
+}
+
+static uint32_t
+heap_pop(solver_t* solver) {
+  uint32_t var = solver->heap[0];
+
+  solver->heap_index[var] = UINT32_MAX;
+  if (--solver->heap_size > 0) {
+    solver->heap[0] = solver->heap[solver->heap_size];
+    heap_down(solver, 0);
+  }
+  return var;
+}
+
+static void
+var_bump(solver_t* solver, const uint32_t var) {
+  if ((solver->activity[var] += solver->var_inc) > 1e100) {
+    for (size_t i = 0; i < solver->vars; i++) {
+      solver->activity[i] *= 1e-100;
+    }
+    solver->var_inc *= 1e-100;
+  }
+  if (solver->heap_index[var] != UINT32_MAX) {
+    heap_up(solver, solver->heap_index[var]);
+  }
+}
+
+static void
+clause_bump(solver_t* solver, clause_t* clause) {
+  if ((clause->activity += solver->clause_inc) > 1e20) {
+    for (size_t i = 0; i < solver->clause_count; i++) {
+      solver->clauses[i].activity *= 1e-20;
+    }
+    solver->clause_inc *= 1e-20;
+  }
+}
+
+/* Assignments and propagation */
+
+static void
+enqueue(solver_t* solver, const lit_t lit, const int32_t reason) {
+  uint32_t var = LIT_VAR(lit);
+
+  solver->assigns[var] = lit & 1;
+  solver->levels[var] = solver->decision_level;
+  solver->reasons[var] = reason;
+  solver->trail[solver->trail_size++] = lit;
+}
+
+static void
+backtrack(solver_t* solver, const size_t level) {
+  if (solver->decision_level <= level) {
+    return;
+  }
+
+  for (size_t i = solver->trail_size; i-- > solver->trail_lim[level + 1];) {
+    uint32_t var = LIT_VAR(solver->trail[i]);
+    solver->assigns[var] = value_undef;
+    solver->reasons[var] = REASON_NONE;
+    heap_insert(solver, var);
+  }
+  solver->trail_size = solver->trail_lim[level + 1];
+  solver->qhead = solver->trail_size;
+  solver->decision_level = level;
+}
+
+/* Falsify 'peer' because 'var' is true, false on a conflict */
+static bool
+amo_falsify(solver_t* solver, const uint32_t var, const uint32_t peer) {
+  switch (solver->assigns[peer]) {
+    case value_undef:
+      enqueue(solver, LIT_NEG(peer), REASON_AMO(var));
+      return true;
+
+    case value_true:
+      solver->conflict_pair[0] = LIT_NEG(var);
+      solver->conflict_pair[1] = LIT_NEG(peer);
+      solver->conflict = solver->conflict_pair;
+      solver->conflict_size = 2;
+      solver->conflict_index = REASON_NONE;
+      return false;
+
+    default:
+      return true;
+  }
+}
+
+/* Enforce the "at most one" constraints of the cell and of the row, column
+ * and block of a variable which became true. */
+static bool
+amo_propagate(solver_t* solver, const uint32_t var) {
+  size_t size = solver->size;
+  size_t block_size = solver->block_size;
+  size_t cell = var / size;
+  size_t color = var % size;
+  size_t row = cell / size;
+  size_t column = cell % size;
+  size_t start_row = row - row % block_size;
+  size_t start_column = column - column % block_size;
+
+  for (size_t other = 0; other < size; other++) {
+    if (other != color && !amo_falsify(solver, var, cell * size + other)) {
+      return false;
+    }
+    if (other != column
+        && !amo_falsify(solver, var, (row * size + other) * size + color)) {
+      return false;
+    }
+    if (other != row
+        && !amo_falsify(solver, var, (other * size + column) * size + color)) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    size_t peer_row = start_row + i / block_size;
+    size_t peer_column = start_column + i % block_size;
+    if (peer_row != row && peer_column != column
+        && !amo_falsify(solver, var,
+                        (peer_row * size + peer_column) * size + color)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Visit the clauses watching a literal which became false */
+static bool
+watches_propagate(solver_t* solver, const lit_t lit) {
+  vec_t* watches = &solver->watches[lit];
+  uint32_t i = 0;
+  uint32_t j = 0;
+
+  while (i < watches->size) {
+    uint32_t index = watches->data[i++];
+    clause_t* clause = &solver->clauses[index];
+    lit_t* lits = clause->lits;
+
+    if (lits[0] == lit) {
+      lits[0] = lits[1];
+      lits[1] = lit;
+    }
+
+    if (lit_value(solver, lits[0]) == value_true) {
+      watches->data[j++] = index;
+      continue;
+    }
+
+    bool moved = false;
+    for (uint32_t k = 2; k < clause->size; k++) {
+      if (lit_value(solver, lits[k]) != value_false) {
+        lits[1] = lits[k];
+        lits[k] = lit;
+        if (!vec_push(&solver->watches[lits[1]], index)) {
+          solver->failed = true;
+        }
+        moved = true;
+        break;
+      }
+    }
+    if (moved) {
+      continue;
+    }
+
+    watches->data[j++] = index;
+    if (lit_value(solver, lits[0]) == value_false) {
+      solver->conflict = lits;
+      solver->conflict_size = clause->size;
+      solver->conflict_index = index;
+      while (i < watches->size) {
+        watches->data[j++] = watches->data[i++];
+      }
+      watches->size = j;
+      return false;
+    }
+    enqueue(solver, lits[0], index);
+  }
+
+  watches->size = j;
+  return true;
+}
+
+static bool
+propagate(solver_t* solver) {
+  while (solver->qhead < solver->trail_size) {
+    lit_t lit = solver->trail[solver->qhead++];
+    stats.propagations++;
+
+    if ((lit & 1) == 0 && !amo_propagate(solver, LIT_VAR(lit))) {
+      return false;
+    }
+    if (!watches_propagate(solver, LIT_NOT(lit))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Conflict analysis */
+
+/* Literals of the reason of an assignment, but the assigned one */
+static const lit_t*
+reason_lits(solver_t* solver, const uint32_t var, size_t* count,
+            lit_t* buffer) {
+  int32_t reason = solver->reasons[var];
+
+  if (reason == REASON_NONE) {
+    *count = 0;
+    return NULL;
+  }
+  if (reason < REASON_NONE) {
+    buffer[0] = LIT_NEG(AMO_VAR(reason));
+    *count = 1;
+    return buffer;
+  }
+
+  clause_t* clause = &solver->clauses[reason];
+  if (clause->learnt) {
+    clause_bump(solver, clause);
+  }
+  *count = clause->size - 1;
+  return clause->lits + 1;
+}
+
+/* A literal of the learnt clause is redundant when its reason only holds
+ * literals of the clause or level 0 facts. */
+static bool
+lit_redundant(solver_t* solver, const lit_t lit) {
+  lit_t buffer[1];
+  size_t count;
+  const lit_t* lits = reason_lits(solver, LIT_VAR(lit), &count, buffer);
+
+  if (lits == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    uint32_t var = LIT_VAR(lits[i]);
+    if (!solver->seen[var] && solver->levels[var] > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Derive the first UIP clause of the conflict into solver->learnt, the
+ * asserting literal first and a literal of the backjump level second. */
+static size_t
+analyze(solver_t* solver) {
+  vec_t* learnt = &solver->learnt;
+  const lit_t* lits = solver->conflict;
+  size_t count = solver->conflict_size;
+  lit_t buffer[1];
+  size_t path = 0;
+  size_t index = solver->trail_size;
+  lit_t lit;
+
+  learnt->size = 0;
+  vec_push(learnt, 0);
+
+  if (solver->conflict_index != REASON_NONE
+      && solver->clauses[solver->conflict_index].learnt) {
+    clause_bump(solver, &solver->clauses[solver->conflict_index]);
+  }
+
+  while (true) {
+    for (size_t i = 0; i < count; i++) {
+      uint32_t var = LIT_VAR(lits[i]);
+      if (solver->seen[var] || solver->levels[var] == 0) {
+        continue;
+      }
+      solver->seen[var] = 1;
+      var_bump(solver, var);
+      if (solver->levels[var] >= solver->decision_level) {
+        path++;
+      } else if (!vec_push(learnt, lits[i])) {
+        solver->failed = true;
+      }
+    }
+
+    while (!solver->seen[LIT_VAR(solver->trail[--index])])
+      ;
+    lit = solver->trail[index];
+    solver->seen[LIT_VAR(lit)] = 0;
+    if (--path == 0) {
+      break;
+    }
+    lits = reason_lits(solver, LIT_VAR(lit), &count, buffer);
+  }
+  learnt->data[0] = LIT_NOT(lit);
+
+  solver->to_clear.size = 0;
+  for (uint32_t i = 1; i < learnt->size; i++) {
+    if (!vec_push(&solver->to_clear, learnt->data[i])) {
+      solver->failed = true;
+    }
+  }
+
+  uint32_t j = 1;
+  for (uint32_t i = 1; i < learnt->size; i++) {
+    if (!lit_redundant(solver, learnt->data[i])) {
+      learnt->data[j++] = learnt->data[i];
+    }
+  }
+  learnt->size = j;
+
+  for (uint32_t i = 0; i < solver->to_clear.size; i++) {
+    solver->seen[LIT_VAR(solver->to_clear.data[i])] = 0;
+  }
+
+  size_t backjump_level = 0;
+  for (uint32_t i = 1; i < learnt->size; i++) {
+    size_t level = solver->levels[LIT_VAR(learnt->data[i])];
+    if (level > backjump_level) {
+      backjump_level = level;
+      lit_t swap = learnt->data[1];
+      learnt->data[1] = learnt->data[i];
+      learnt->data[i] = swap;
+    }
+  }
+  return backjump_level;
+}
+
+/* Clause database */
+
+static int32_t
+clause_add(solver_t* solver, const lit_t* lits, const size_t size,
+           const bool learnt) {
+  if (solver->clause_count == solver->clause_capacity) {
+    size_t capacity = 2 * solver->clause_capacity;
+    clause_t* clauses = realloc(solver->clauses, capacity * sizeof(clause_t));
+    if (clauses == NULL) {
+      solver->failed = true;
+      return REASON_NONE;
+    }
+    solver->clauses = clauses;
+    solver->clause_capacity = capacity;
+  }
+
+  clause_t* clause = &solver->clauses[solver->clause_count];
+  clause->lits = malloc(size * sizeof(lit_t));
+  if (clause->lits == NULL) {
+    solver->failed = true;
+    return REASON_NONE;
+  }
+  memcpy(clause->lits, lits, size * sizeof(lit_t));
+  clause->size = size;
+  clause->learnt = learnt;
+  clause->lbd = 0;
+  clause->activity = 0.0;
+
+  if (learnt) {
+    solver->stamp++;
+    for (size_t i = 0; i < size; i++) {
+      uint32_t level = solver->levels[LIT_VAR(lits[i])];
+      if (solver->level_stamps[level] != solver->stamp) {
+        solver->level_stamps[level] = solver->stamp;
+        clause->lbd++;
+      }
+    }
+    clause_bump(solver, clause);
+    solver->learnt_count++;
+    stats.learnts++;
+  }
+
+  if (!vec_push(&solver->watches[lits[0]], solver->clause_count)
+      || !vec_push(&solver->watches[lits[1]], solver->clause_count)) {
+    solver->failed = true;
+  }
+  return solver->clause_count++;
+}
+
+typedef struct {
+  uint32_t index;
+  uint32_t lbd;
+  double activity;
+} candidate_t;
+
+/* Clauses with the most levels, then the least active, go first */
+static int
+candidate_compare(const void* a, const void* b) {
+  const candidate_t* c1 = a;
+  const candidate_t* c2 = b;
+
+  if (c1->lbd != c2->lbd) {
+    return c1->lbd > c2->lbd ? -1 : 1;
+  }
+  return (c1->activity > c2->activity) - (c1->activity < c2->activity);
+}
+
+static bool
+clause_locked(const solver_t* solver, const uint32_t index) {
+  uint32_t var = LIT_VAR(solver->clauses[index].lits[0]);
+  return solver->assigns[var] != value_undef
+         && solver->reasons[var] == (int32_t)index;
+}
+
+/* Drop half of the learnt clauses (but binary, glue and reason ones), then
+ * compact the database and rebuild the watches. */
+static void
+reduce_learnts(solver_t* solver) {
+  candidate_t* candidates =
+      malloc(solver->learnt_count * sizeof(candidate_t));
+  int32_t* remap = malloc(solver->clause_count * sizeof(int32_t));
+  if (candidates == NULL || remap == NULL) {
+    free(candidates);
+    free(remap);
+    solver->max_learnts *= 2;
+    return;
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < solver->clause_count; i++) {
+    clause_t* clause = &solver->clauses[i];
+    remap[i] = i;
+    if (clause->learnt && clause->size > 2 && clause->lbd > 2
+        && !clause_locked(solver, i)) {
+      candidates[count++] = (candidate_t){i, clause->lbd, clause->activity};
+    }
+  }
+  qsort(candidates, count, sizeof(candidate_t), candidate_compare);
+
+  for (size_t i = 0; i < count / 2; i++) {
+    remap[candidates[i].index] = REASON_NONE;
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < solver->clause_count; i++) {
+    if (remap[i] == REASON_NONE) {
+      free(solver->clauses[i].lits);
+      solver->learnt_count--;
+      continue;
+    }
+    remap[i] = kept;
+    solver->clauses[kept++] = solver->clauses[i];
+  }
+  solver->clause_count = kept;
+
+  for (size_t lit = 0; lit < 2 * solver->vars; lit++) {
+    solver->watches[lit].size = 0;
+  }
+  for (size_t i = 0; i < kept; i++) {
+    clause_t* clause = &solver->clauses[i];
+    vec_push(&solver->watches[clause->lits[0]], i);
+    vec_push(&solver->watches[clause->lits[1]], i);
+  }
+
+  for (size_t i = 0; i < solver->trail_size; i++) {
+    uint32_t var = LIT_VAR(solver->trail[i]);
+    if (solver->reasons[var] >= 0) {
+      solver->reasons[var] = remap[solver->reasons[var]];
+    }
+  }
+
+  free(candidates);
+  free(remap);
+  solver->max_learnts += solver->max_learnts / 10;
+}
+
+/* Solver setup */
+
+static void
+solver_free(solver_t* solver) {
+  if (solver->watches != NULL) {
+    for (size_t lit = 0; lit < 2 * solver->vars; lit++) {
+      free(solver->watches[lit].data);
+    }
+  }
+  if (solver->clauses != NULL) {
+    for (size_t i = 0; i < solver->clause_count; i++) {
+      free(solver->clauses[i].lits);
+    }
+  }
+
+  free(solver->assigns);
+  free(solver->levels);
+  free(solver->reasons);
+  free(solver->trail);
+  free(solver->trail_lim);
+  free(solver->clauses);
+  free(solver->watches);
+  free(solver->activity);
+  free(solver->heap);
+  free(solver->heap_index);
+  free(solver->seen);
+  free(solver->level_stamps);
+  free(solver->learnt.data);
+  free(solver->to_clear.data);
+}
+
+static bool
+solver_init(solver_t* solver, const size_t size) {
+  size_t vars = size * size * size;
+
+  memset(solver, 0, sizeof(solver_t));
+  solver->size = size;
+  solver->block_size = sqrt(size);
+  solver->vars = vars;
+  solver->var_inc = 1.0;
+  solver->clause_inc = 1.0;
+  solver->max_learnts = LEARNTS_MIN;
+  solver->clause_capacity = 4 * size * size;
+
+  solver->assigns = malloc(vars * sizeof(uint8_t));
+  solver->levels = calloc(vars, sizeof(uint32_t));
+  solver->reasons = malloc(vars * sizeof(int32_t));
+  solver->trail = malloc(vars * sizeof(lit_t));
+  solver->trail_lim = malloc((vars + 2) * sizeof(size_t));
+  solver->clauses = malloc(solver->clause_capacity * sizeof(clause_t));
+  solver->watches = calloc(2 * vars, sizeof(vec_t));
+  solver->activity = calloc(vars, sizeof(double));
+  solver->heap = malloc(vars * sizeof(uint32_t));
+  solver->heap_index = malloc(vars * sizeof(uint32_t));
+  solver->seen = calloc(vars, sizeof(uint8_t));
+  solver->level_stamps = calloc(vars + 2, sizeof(uint32_t));
+
+  if (solver->assigns == NULL || solver->levels == NULL
+      || solver->reasons == NULL || solver->trail == NULL
+      || solver->trail_lim == NULL || solver->clauses == NULL
+      || solver->watches == NULL || solver->activity == NULL
+      || solver->heap == NULL || solver->heap_index == NULL
+      || solver->seen == NULL || solver->level_stamps == NULL) {
+    return false;
+  }
+
+  memset(solver->assigns, value_undef, vars * sizeof(uint8_t));
+  for (size_t var = 0; var < vars; var++) {
+    solver->reasons[var] = REASON_NONE;
+    solver->heap_index[var] = UINT32_MAX;
+  }
+  solver->trail_lim[0] = 0;
+  return true;
+}
+
+/* Add an "at least one" constraint over the candidate variables, false if it
+ * cannot be satisfied. */
+static bool
+solver_add_alo(solver_t* solver, const lit_t* lits, const size_t count) {
+  if (count == 0) {
+    return false;
+  }
+  if (count > 1) {
+    clause_add(solver, lits, count, false);
+    return true;
+  }
+
+  switch (lit_value(solver, lits[0])) {
+    case value_undef:
+      enqueue(solver, lits[0], REASON_NONE);
+      return true;
+
+    case value_true:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+/* Encode the candidates of the grid, false if it is trivially inconsistent */
+static bool
+solver_encode(solver_t* solver, const grid_t* grid) {
+  size_t size = solver->size;
+  size_t block_size = solver->block_size;
+  lit_t lits[MAX_GRID_SIZE];
+
+  for (size_t cell = 0; cell < size * size; cell++) {
+    colors_t colors = grid_get_colors(grid, cell / size, cell % size);
+    for (size_t color = 0; color < size; color++) {
+      uint32_t var = cell * size + color;
+      if (!colors_is_in(colors, color)) {
+        solver->assigns[var] = value_false;
+        continue;
+      }
+      /* Favor the cells with the fewest colors until conflicts take over */
+      solver->activity[var] = 1e-3 / colors_count(colors);
+      heap_insert(solver, var);
+    }
+  }
+
+  for (size_t cell = 0; cell < size * size; cell++) {
+    size_t count = 0;
+    for (size_t color = 0; color < size; color++) {
+      if (solver->assigns[cell * size + color] == value_undef) {
+        lits[count++] = LIT_POS(cell * size + color);
+      }
+    }
+    if (!solver_add_alo(solver, lits, count)) {
+      return false;
+    }
+  }
+
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    size_t index = unit % size;
+    for (size_t color = 0; color < size; color++) {
+      size_t count = 0;
+      for (size_t i = 0; i < size; i++) {
+        size_t cell;
+        if (unit < size) {
+          cell = index * size + i;
+        } else if (unit < 2 * size) {
+          cell = i * size + index;
+        } else {
+          cell = ((index / block_size) * block_size + i / block_size) * size
+                 + (index % block_size) * block_size + i % block_size;
+        }
+        if (solver->assigns[cell * size + color] != value_false) {
+          lits[count++] = LIT_POS(cell * size + color);
+        }
+      }
+      if (!solver_add_alo(solver, lits, count)) {
+        return false;
+      }
+    }
+  }
+
+  return !solver->failed;
+}
+
+static grid_t*
+solver_grid(const solver_t* solver, const grid_t* grid) {
+  size_t size = solver->size;
+  grid_t* result = grid_copy(grid);
+  if (result == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  for (size_t cell = 0; cell < size * size; cell++) {
+    for (size_t color = 0; color < size; color++) {
+      if (solver->assigns[cell * size + color] == value_true) {
+        grid_set_colors(result, cell / size, cell % size, colors_set(color));
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+/* Block the solution just found by a clause on its decisions: any assignment
+ * extending them propagates to the same solution. False when every solution
+ * has been found. */
+static bool
+solver_block(solver_t* solver) {
+  size_t level = solver->decision_level;
+
+  if (level == 0) {
+    return false;
+  }
+
+  solver->learnt.size = 0;
+  for (size_t i = level; i > 0; i--) {
+    lit_t decision = solver->trail[solver->trail_lim[i]];
+    if (!vec_push(&solver->learnt, LIT_NOT(decision))) {
+      solver->failed = true;
+      return false;
+    }
+  }
+
+  backtrack(solver, level - 1);
+  if (level == 1) {
+    enqueue(solver, solver->learnt.data[0], REASON_NONE);
+  } else {
+    int32_t index =
+        clause_add(solver, solver->learnt.data, solver->learnt.size, false);
+    enqueue(solver, solver->learnt.data[0], index);
+  }
+  return !solver->failed;
+}
+
+static size_t
+luby(size_t index) {
+  size_t power = 1;
+
+  while (power < index + 1) {
+    power = 2 * power + 1;
+  }
+  while (power - 1 != index) {
+    power = (power - 1) / 2;
+    index %= power;
+  }
+  return (power + 1) / 2;
+}
+
+static grid_t*
+solver_search(solver_t* solver, const grid_t* grid, const _mode_t mode,
+              size_t* solution_count) {
+  size_t restarts = 0;
+  size_t restart_conflicts = 0;
+  size_t restart_limit = RESTART_BASE * luby(restarts);
+
+  while (!solver->failed) {
+    if (!propagate(solver)) {
+      stats.conflicts++;
+      if (solver->decision_level == 0) {
+        return NULL;
+      }
+
+      size_t backjump_level = analyze(solver);
+      backtrack(solver, backjump_level);
+      if (solver->learnt.size == 1) {
+        enqueue(solver, solver->learnt.data[0], REASON_NONE);
+      } else {
+        int32_t index = clause_add(solver, solver->learnt.data,
+                                   solver->learnt.size, true);
+        enqueue(solver, solver->learnt.data[0], index);
+      }
+
+      solver->var_inc /= VAR_DECAY;
+      solver->clause_inc /= CLAUSE_DECAY;
+      restart_conflicts++;
+      continue;
+    }
+
+    if (restart_conflicts >= restart_limit) {
+      backtrack(solver, 0);
+      restart_conflicts = 0;
+      restart_limit = RESTART_BASE * luby(++restarts);
+      stats.restarts++;
+    }
+
+    if (solver->learnt_count >= solver->max_learnts) {
+      reduce_learnts(solver);
+    }
+
+    uint32_t var = UINT32_MAX;
+    while (solver->heap_size > 0) {
+      var = heap_pop(solver);
+      if (solver->assigns[var] == value_undef) {
+        break;
+      }
+      var = UINT32_MAX;
+    }
+
+    if (var == UINT32_MAX) {
+      if (mode == mode_first) {
+        return solver_grid(solver, grid);
+      }
+
+      grid_t* solution = solver_grid(solver, grid);
+      bool more = grid_report_solution(solution);
+      grid_free(solution);
+      (*solution_count)++;
+
+      if (!more || !solver_block(solver)) {
+        return NULL;
+      }
+      continue;
+    }
+
+    stats.decisions++;
+    solver->trail_lim[++solver->decision_level] = solver->trail_size;
+    enqueue(solver, LIT_POS(var), REASON_NONE);
+  }
+
+  return NULL;
+}
+
+grid_t*
+cdcl_solver(grid_t* grid, _mode_t mode, size_t* solution_count) {
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  /* The unit heuristics are cheaper than clauses at the root */
+  grid_t* copy = grid_copy(grid);
+  if (copy == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  status_t status = grid_heuristics(copy);
+  if (status != grid_unsolved) {
+    if (status == grid_solved) {
+      if (mode == mode_first) {
+        return copy;
+      }
+      grid_report_solution(copy);
+      (*solution_count)++;
+    }
+    grid_free(copy);
+    return NULL;
+  }
+
+  solver_t solver;
+  grid_t* result = NULL;
+
+  if (solver_init(&solver, grid_get_size(copy))
+      && solver_encode(&solver, copy)) {
+    result = solver_search(&solver, copy, mode, solution_count);
+  }
+
+  if (solver.failed) {
+    fprintf(stderr, "Error: out of memory in the CDCL engine.\n");
+    grid_report_failure();
+  }
+
+  solver_free(&solver);
+  grid_free(copy);
+  return result;
+}
+
+void
+cdcl_print_stats(FILE* fd) {
+  fprintf(fd,
+          "cdcl: %zu conflicts, %zu decisions, %zu propagations, "
+          "%zu learnt clauses, %zu restarts\n",
+          stats.conflicts, stats.decisions, stats.propagations, stats.learnts,
+          stats.restarts);
+}
@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "checkpoint.h"
+
+#include <colors.h>
+#include <grid.h>
+#include <libsudoku.h>
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* First line of a checkpoint file, ending with its version */
+#define CHECKPOINT_MAGIC "sudoku checkpoint 1"
+
+/* Nodes between two calls of the monitor */
+#define CHECKPOINT_NODES 1024
+
+/* Longest path of a checkpoint file */
+#define PATH_LENGTH 4096
+
+/* Longest line of the head of a checkpoint file */
+#define LINE_LENGTH 256
+
+struct _checkpoint_t {
+  char path[PATH_LENGTH];
+  grid_t* grid;     /* As it was before the search */
+  double seconds;   /* Spent searching by the runs before this one */
+  size_t solutions; /* Reported by the runs before this one */
+  unsigned period;
+  struct timespec start;
+  double saved;    /* Seconds into this run of the last checkpoint */
+  double reported; /* Seconds into this run of the last progress line */
+  bool stopped;
+  struct sigaction interrupt;
+  struct sigaction terminate;
+};
+
+/* Signal the search is asked to stop by */
+static volatile sig_atomic_t signaled = 0;
+
+static void
+checkpoint_signal(int number) {
+  signaled = number;
+}
+
+static double
+checkpoint_elapsed(const checkpoint_t* checkpoint) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - checkpoint->start.tv_sec)
+         + (now.tv_nsec - checkpoint->start.tv_nsec) / 1e9;
+}
+
+/* Fraction of the tree left of a path: the subtree of a choice taken weighs
+ * 1/m of its node, m the candidates of its cell, and the subtree of a
+ * discarded choice is covered */
+static double
+checkpoint_covered(const grid_step_t* path, const size_t length) {
+  double covered = 0.0;
+  double weight = 1.0;
+
+  for (size_t i = 0; i < length; i++) {
+    double candidates = path[i].candidates ? path[i].candidates : 1;
+
+    if (path[i].discarded) {
+      covered += weight / candidates;
+      weight *= (candidates - 1) / candidates;
+    } else {
+      weight /= candidates;
+    }
+  }
+  return covered;
+}
+
+static bool
+checkpoint_write(const checkpoint_t* checkpoint, const grid_step_t* path,
+                 const size_t length, const size_t solutions,
+                 const double seconds) {
+  char temporary[PATH_LENGTH + 8];
+
+  /* The solutions the file counts are out before it is */
+  fflush(stdout);
+
+  snprintf(temporary, sizeof(temporary), "%s.tmp", checkpoint->path);
+  FILE* file = fopen(temporary, "w");
+  if (file == NULL) {
+    return false;
+  }
+
+  fprintf(file, "%s\nsolutions %zu\nseconds %.3f\nsteps %zu\n",
+          CHECKPOINT_MAGIC, solutions, seconds, length);
+  for (size_t i = 0; i < length; i++) {
+    size_t color = 0;
+
+    while (!colors_is_in(path[i].choice.color, color)) {
+      color++;
+    }
+    fprintf(file, "%c %zu %zu %zu %zu\n", path[i].discarded ? '-' : '+',
+            path[i].choice.row, path[i].choice.column, color,
+            path[i].candidates);
+  }
+  fprintf(file, "grid\n");
+  grid_print(checkpoint->grid, file);
+
+  bool written = !ferror(file);
+  if (fclose(file) || !written || rename(temporary, checkpoint->path)) {
+    remove(temporary);
+    return false;
+  }
+  return true;
+}
+
+static bool
+checkpoint_monitor(const grid_step_t* path, const size_t length,
+                   const size_t solutions, void* data) {
+  checkpoint_t* checkpoint = data;
+  const double elapsed = checkpoint_elapsed(checkpoint);
+
+  if (elapsed - checkpoint->reported >= CHECKPOINT_PROGRESS) {
+    checkpoint->reported = elapsed;
+    fprintf(stderr,
+            "checkpoint: %zu solutions, %.1f solutions/s, %.6f%% of the tree"
+            " covered\n",
+            solutions, (solutions - checkpoint->solutions) / elapsed,
+            100.0 * checkpoint_covered(path, length));
+  }
+
+  if (signaled || elapsed - checkpoint->saved >= checkpoint->period) {
+    checkpoint->saved = elapsed;
+    if (!checkpoint_write(checkpoint, path, length, solutions,
+                          checkpoint->seconds + elapsed)) {
+      fprintf(stderr, "checkpoint: cannot write %s\n", checkpoint->path);
+    }
+  }
+
+  if (signaled) {
+    checkpoint->stopped = true;
+    return false;
+  }
+  return true;
+}
+
+static checkpoint_t*
+checkpoint_start(const char* path, const unsigned seconds) {
+  if (strlen(path) >= PATH_LENGTH || seconds == 0) {
+    return NULL;
+  }
+
+  checkpoint_t* checkpoint = calloc(1, sizeof(checkpoint_t));
+  if (checkpoint == NULL) {
+    return NULL;
+  }
+
+  strcpy(checkpoint->path, path);
+  checkpoint->period = seconds;
+  return checkpoint;
+}
+
+/* Watch the next search and catch the signals that stop it */
+static void
+checkpoint_watch(checkpoint_t* checkpoint) {
+  struct sigaction action;
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = checkpoint_signal;
+  sigemptyset(&action.sa_mask);
+  signaled = 0;
+  sigaction(SIGINT, &action, &checkpoint->interrupt);
+  sigaction(SIGTERM, &action, &checkpoint->terminate);
+
+  clock_gettime(CLOCK_MONOTONIC, &checkpoint->start);
+  grid_set_monitor(checkpoint_monitor, checkpoint, CHECKPOINT_NODES);
+}
+
+checkpoint_t*
+checkpoint_alloc(const char* path, const unsigned seconds,
+                 const grid_t* grid) {
+  checkpoint_t* checkpoint = checkpoint_start(path, seconds);
+  if (checkpoint == NULL) {
+    return NULL;
+  }
+
+  checkpoint->grid = grid_copy(grid);
+  if (checkpoint->grid == NULL) {
+    free(checkpoint);
+    return NULL;
+  }
+
+  checkpoint_watch(checkpoint);
+  return checkpoint;
+}
+
+/* Read the head of a checkpoint file, up to its grid: the path of the
+ * search, allocated, and its length */
+static bool
+checkpoint_read(checkpoint_t* checkpoint, FILE* file, grid_step_t** path,
+                size_t* length) {
+  char line[LINE_LENGTH];
+
+  if (fgets(line, sizeof(line), file) == NULL
+      || strcmp(line, CHECKPOINT_MAGIC "\n")
+      || fscanf(file, "solutions %zu\n", &checkpoint->solutions) != 1
+      || fscanf(file, "seconds %lf\n", &checkpoint->seconds) != 1
+      || fscanf(file, "steps %zu\n", length) != 1
+      || (*path = malloc((*length + 1) * sizeof(grid_step_t))) == NULL) {
+    return false;
+  }
+
+  for (size_t i = 0; i < *length; i++) {
+    grid_step_t* step = &(*path)[i];
+    char kind;
+    size_t color;
+
+    if (fscanf(file, "%c %zu %zu %zu %zu\n", &kind, &step->choice.row,
+               &step->choice.column, &color, &step->candidates)
+            != 5
+        || (kind != '+' && kind != '-') || color >= MAX_COLORS) {
+      return false;
+    }
+    step->choice.color = colors_set(color);
+    step->discarded = kind == '-';
+  }
+  return fgets(line, sizeof(line), file) != NULL && !strcmp(line, "grid\n");
+}
+
+/* Whether the choices of a path are in a grid */
+static bool
+checkpoint_check(const grid_step_t* path, const size_t length,
+                 const grid_t* grid) {
+  const size_t size = grid_get_size(grid);
+
+  for (size_t i = 0; i < length; i++) {
+    if (path[i].choice.row >= size || path[i].choice.column >= size
+        || !colors_is_subset(path[i].choice.color, colors_full(size))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+checkpoint_t*
+checkpoint_resume(const char* path, const unsigned seconds, sudoku_t* context,
+                  grid_t** grid) {
+  checkpoint_t* checkpoint = checkpoint_start(path, seconds);
+  if (checkpoint == NULL) {
+    return NULL;
+  }
+
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    free(checkpoint);
+    return NULL;
+  }
+
+  grid_step_t* steps = NULL;
+  size_t length = 0;
+  bool resumed =
+      checkpoint_read(checkpoint, file, &steps, &length)
+      && sudoku_parse_file(context, file, &checkpoint->grid) == sudoku_ok
+      && checkpoint_check(steps, length, checkpoint->grid)
+      && grid_set_replay(steps, length, checkpoint->solutions)
+      && (*grid = grid_copy(checkpoint->grid)) != NULL;
+
+  free(steps);
+  fclose(file);
+  if (!resumed) {
+    /* A replay set up before a failure is dropped */
+    grid_set_replay(NULL, 0, 0);
+    grid_free(checkpoint->grid);
+    free(checkpoint);
+    return NULL;
+  }
+
+  checkpoint_watch(checkpoint);
+  return checkpoint;
+}
+
+bool
+checkpoint_finish(checkpoint_t* checkpoint) {
+  bool finished = !checkpoint->stopped;
+
+  grid_set_monitor(NULL, NULL, 0);
+  sigaction(SIGINT, &checkpoint->interrupt, NULL);
+  sigaction(SIGTERM, &checkpoint->terminate, NULL);
+
+  if (finished) {
+    remove(checkpoint->path);
+  }
+  grid_free(checkpoint->grid);
+  free(checkpoint);
+  return finished;
+}
@@ -1,4 +1,7 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "colors.h"
+#include "kernels.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -11,14 +14,14 @@ colors_t
 colors_full(const size_t size) {
   static const int BITS_PER_BYTE = 8;
   if (size == 0) {
-    return 0ULL;
+    return colors_empty();
   }
 
   if (size >= sizeof(colors_t) * BITS_PER_BYTE) {
     return (colors_t)-1;
   }
 
-  return (1ULL << size) - 1;
+  return ((colors_t)1 << size) - 1;
 }
 
 colors_t
@@ -29,10 +32,10 @@ colors_empty(void) {
 colors_t
 colors_set(const size_t color_id) {
   if (color_id >= MAX_COLORS) {
-    return 0ULL;
+    return colors_empty();
   }
 
-  return 1ULL << color_id;
+  return (colors_t)1 << color_id;
 }
 
 colors_t
@@ -41,7 +44,7 @@ colors_add(const colors_t colors, const size_t color_id) {
     return colors;
   }
 
-  return colors | (1ULL << color_id);
+  return colors | ((colors_t)1 << color_id);
 }
 
 colors_t
@@ -50,7 +53,7 @@ colors_discard(const colors_t colors, const size_t color_id) {
     return colors;
   }
 
-  return colors & ~(1ULL << color_id);
+  return colors & ~((colors_t)1 << color_id);
 }
 
 bool
@@ -59,7 +62,7 @@ colors_is_in(const colors_t colors, const size_t color_id) {
     return false;
   }
 
-  return (colors & (1ULL << color_id)) != 0;
+  return (colors & ((colors_t)1 << color_id)) != 0;
 }
 
 colors_t
@@ -104,6 +107,12 @@ colors_is_singleton(const colors_t colors) {
 
 size_t
 colors_count(const colors_t colors) {
+#if defined(__GNUC__) && defined(COLORS_WIDE)
+  return __builtin_popcountll((uint64_t)colors)
+         + __builtin_popcountll((uint64_t)(colors >> 64));
+#elif defined(__GNUC__)
+  return __builtin_popcountll(colors);
+#else
   size_t count = 0;
   colors_t temp = colors;
 
@@ -113,6 +122,7 @@ colors_count(const colors_t colors) {
   }
 
   return count;
+#endif
 }
 
 colors_t
@@ -126,7 +136,7 @@ colors_leftmost(const colors_t colors) {
     return 0;
   }
 
-  colors_t mask = 1ULL << (MAX_COLORS - 1);
+  colors_t mask = (colors_t)1 << (MAX_COLORS - 1);
   for (size_t i = 0; i < MAX_COLORS; i++) {
     if (colors & mask) {
       return mask;
@@ -142,7 +152,7 @@ colors_random(const colors_t colors) {
   srand(time(NULL));
 
   size_t num_colors = 0;
-  colors_t mask = 1ULL;
+  colors_t mask = 1;
   for (size_t i = 0; i < MAX_COLORS; i++) {
     if (colors & mask) {
       num_colors++;
@@ -156,7 +166,7 @@ colors_random(const colors_t colors) {
 
   size_t random_index = rand() % num_colors;
 
-  mask = 1ULL;
+  mask = 1;
   for (size_t i = 0; i < MAX_COLORS; i++) {
     if (colors & mask) {
       if (random_index == 0) {
@@ -198,85 +208,338 @@ subgrid_consistency(colors_t* subgrid[], const size_t size) {
   return true;
 }
 
-static bool
-cross_hatching_heuristics(colors_t* subgrid[], const size_t size) {
-  bool result = false;
-  colors_t singletons = colors_empty();
+/* Returned by the heuristics as soon as they find the subgrid inconsistent */
+#define CONTRADICTION SIZE_MAX
+
+/* The heuristics, one instance per subgrid size */
+#define KERNEL_SIZE   size
+#define KERNEL_SUFFIX any
+#include "colors_kernels.h"
+#define KERNEL_SIZE   1
+#define KERNEL_SUFFIX 1
+#include "colors_kernels.h"
+#define KERNEL_SIZE   4
+#define KERNEL_SUFFIX 4
+#include "colors_kernels.h"
+#define KERNEL_SIZE   9
+#define KERNEL_SUFFIX 9
+#include "colors_kernels.h"
+#define KERNEL_SIZE   16
+#define KERNEL_SUFFIX 16
+#include "colors_kernels.h"
+#define KERNEL_SIZE   25
+#define KERNEL_SUFFIX 25
+#include "colors_kernels.h"
+#define KERNEL_SIZE   36
+#define KERNEL_SUFFIX 36
+#include "colors_kernels.h"
+#define KERNEL_SIZE   49
+#define KERNEL_SUFFIX 49
+#include "colors_kernels.h"
+#define KERNEL_SIZE   64
+#define KERNEL_SUFFIX 64
+#include "colors_kernels.h"
+#ifdef COLORS_WIDE
+#define KERNEL_SIZE   81
+#define KERNEL_SUFFIX 81
+#include "colors_kernels.h"
+#define KERNEL_SIZE   100
+#define KERNEL_SUFFIX 100
+#include "colors_kernels.h"
+#endif
+
+/* Heuristics pipeline */
+
+/* Calls of a pipeline before the first reordering, and between two of them */
+#define PIPELINE_WARMUP_CALLS   256
+#define PIPELINE_REORDER_PERIOD 1024
+
+/* One call out of PIPELINE_SAMPLE_PERIOD is timed */
+#define PIPELINE_SAMPLE_PERIOD 16
+
+/* A heuristic yielding less than 1/PIPELINE_DEFER_RATIO of the eliminations
+ * per microsecond of the best one, and changing the subgrid in less than one
+ * run out of PIPELINE_DEFER_HITS, is deferred: it leaves the pipeline and only
+ * runs from subgrid_deferred_heuristics(), once the grid is stuck. Skipping it
+ * altogether would weaken the fixpoint of the propagation (and blow up the
+ * search), deferring it keeps the fixpoint and drops most of its runs. */
+#define PIPELINE_DEFER_RATIO 64
+#define PIPELINE_DEFER_HITS  16
+
+typedef size_t (*heuristic_fn_t)(colors_t* subgrid[], const size_t size);
+
+static const char* heuristic_names[HEURISTICS_COUNT] = {
+    [heuristic_cross_hatching] = "cross",
+    [heuristic_lone_number] = "lone",
+    [heuristic_naked_subset] = "naked",
+};
+
+#define KERNELS(suffix)                                                        \
+  {                                                                            \
+    [heuristic_cross_hatching] = cross_hatching_##suffix,                      \
+    [heuristic_lone_number] = lone_number_##suffix,                            \
+    [heuristic_naked_subset] = naked_subset_##suffix,                          \
+  }
 
-  for (size_t i = 0; i < size; i++) {
-    if (colors_is_singleton(*subgrid[i])) {
-      singletons = colors_or(singletons, *subgrid[i]);
+/* Instances of the heuristics by subgrid size, the generic ones at 0 */
+static const heuristic_fn_t kernels[MAX_COLORS + 1][HEURISTICS_COUNT] = {
+    [0] = KERNELS(any),  [1] = KERNELS(1),   [4] = KERNELS(4),
+    [9] = KERNELS(9),    [16] = KERNELS(16), [25] = KERNELS(25),
+    [36] = KERNELS(36),  [49] = KERNELS(49), [64] = KERNELS(64),
+#ifdef COLORS_WIDE
+    [81] = KERNELS(81),  [100] = KERNELS(100),
+#endif
+};
+
+typedef struct {
+  size_t calls;
+  size_t runs[HEURISTICS_COUNT];
+  size_t hits[HEURISTICS_COUNT];
+  size_t eliminations[HEURISTICS_COUNT];
+  size_t timed_runs[HEURISTICS_COUNT];
+  uint64_t timed_ns[HEURISTICS_COUNT];
+  heuristic_t order[HEURISTICS_COUNT];
+  bool deferred[HEURISTICS_COUNT];
+  const heuristic_fn_t* kernels; /* Picked on the first call */
+} pipeline_t;
+
+/* Statistics and current order of the adaptive pipeline, per subgrid size
+ * and per thread */
+static _Thread_local pipeline_t pipelines[MAX_COLORS + 1];
+
+/* Order pinned by the calling thread (adaptive scheduling when empty) */
+static _Thread_local subgrid_pipeline_t pinned = {{0}, 0};
+
+static uint64_t
+clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Observed eliminations per nanosecond of a heuristic */
+static double
+pipeline_rate(const pipeline_t* pipeline, const heuristic_t heuristic) {
+  if (pipeline->timed_runs[heuristic] == 0) {
+    return 0.0;
+  }
+
+  double cost_per_run = (double)pipeline->timed_ns[heuristic]
+                        / (double)pipeline->timed_runs[heuristic];
+  double total_cost = cost_per_run * (double)pipeline->runs[heuristic];
+
+  return total_cost > 0.0 ? pipeline->eliminations[heuristic] / total_cost
+                          : 0.0;
+}
+
+static void
+pipeline_reorder(pipeline_t* pipeline) {
+  double rates[HEURISTICS_COUNT];
+  double best_rate = 0.0;
+
+  for (size_t i = 0; i < HEURISTICS_COUNT; i++) {
+    rates[i] = pipeline_rate(pipeline, i);
+    if (rates[i] > best_rate) {
+      best_rate = rates[i];
     }
   }
 
-  for (size_t i = 0; i < size; i++) {
-    if (!colors_is_singleton(*subgrid[i])) {
-      colors_t temp = *subgrid[i];
-      *subgrid[i] = colors_subtract(*subgrid[i], singletons);
-      if (temp != *subgrid[i]) {
-        result = true;
-      }
+  /* Insertion sort by decreasing rate, ties keep the default order */
+  for (size_t i = 0; i < HEURISTICS_COUNT; i++) {
+    pipeline->order[i] = i;
+  }
+  for (size_t i = 1; i < HEURISTICS_COUNT; i++) {
+    heuristic_t current = pipeline->order[i];
+    size_t j = i;
+    while (j > 0 && rates[pipeline->order[j - 1]] < rates[current]) {
+      pipeline->order[j] = pipeline->order[j - 1];
+      j--;
     }
+    pipeline->order[j] = current;
   }
 
-  return result;
+  /* Never defer the head of the pipeline */
+  for (size_t i = 0; i < HEURISTICS_COUNT; i++) {
+    pipeline->deferred[i] =
+        rates[i] * PIPELINE_DEFER_RATIO < best_rate
+        && pipeline->hits[i] * PIPELINE_DEFER_HITS < pipeline->runs[i]
+        && i != pipeline->order[0];
+  }
 }
 
-static bool
-lone_number_heuristic(colors_t* subgrid[], size_t size) {
-  int position = 0;
-  bool result = false;
-  for (size_t i = 0; i < size; i++) {
-    int cpt = 0;
-    for (size_t j = 0; j < size; j++) {
-      if (colors_is_in(*subgrid[j], i)) {
-        position = j;
-        cpt++;
-      }
-      if (cpt > 1) {
-        break;
+static subgrid_status_t
+pipeline_run(pipeline_t* pipeline, const heuristic_t heuristic,
+              colors_t* subgrid[], const size_t size) {
+  size_t eliminations;
+
+  if (pipeline->runs[heuristic] % PIPELINE_SAMPLE_PERIOD == 0) {
+    uint64_t start = clock_ns();
+    eliminations = pipeline->kernels[heuristic](subgrid, size);
+    pipeline->timed_ns[heuristic] += clock_ns() - start;
+    pipeline->timed_runs[heuristic]++;
+  } else {
+    eliminations = pipeline->kernels[heuristic](subgrid, size);
+  }
+
+  pipeline->runs[heuristic]++;
+  if (eliminations == CONTRADICTION) {
+    return subgrid_inconsistent;
+  }
+  pipeline->hits[heuristic] += eliminations > 0;
+  pipeline->eliminations[heuristic] += eliminations;
+
+  return eliminations > 0 ? subgrid_changed : subgrid_unchanged;
+}
+
+/* Pipeline of a subgrid size, with the instances of the heuristics for it */
+static pipeline_t*
+pipeline_get(const size_t size) {
+  pipeline_t* pipeline = &pipelines[size <= MAX_COLORS ? size : 0];
+
+  if (pipeline->kernels == NULL) {
+    bool specialized = size <= MAX_COLORS && kernels[size][0] != NULL;
+    pipeline->kernels = kernels[specialized ? size : 0];
+  }
+  return pipeline;
+}
+
+bool
+subgrid_pipeline_set(const char* spec) {
+  if (spec == NULL || !strcmp(spec, "adaptive")) {
+    pinned.count = 0;
+    return true;
+  }
+
+  heuristic_t order[HEURISTICS_COUNT];
+  size_t count = 0;
+  const char* name = spec;
+
+  while (*name != '\0') {
+    size_t length = strcspn(name, ",");
+    size_t i = 0;
+
+    while (i < HEURISTICS_COUNT
+           && (strlen(heuristic_names[i]) != length
+               || strncmp(heuristic_names[i], name, length))) {
+      i++;
+    }
+    if (i == HEURISTICS_COUNT || count == HEURISTICS_COUNT) {
+      return false;
+    }
+    for (size_t j = 0; j < count; j++) {
+      if (order[j] == i) {
+        return false;
       }
     }
-    if (cpt == 1 && !colors_is_singleton(*subgrid[position])) {
-      *subgrid[position] = colors_set(i);
-      result = true;
+    order[count++] = i;
+
+    name += length;
+    if (*name == ',') {
+      name++;
     }
   }
 
-  return result;
+  if (count == 0) {
+    return false;
+  }
+
+  memcpy(pinned.order, order, sizeof(order));
+  pinned.count = count;
+  return true;
 }
 
-static bool
-naked_subset_heuristic(colors_t* subgrid[], size_t size) {
-  bool result = false;
+subgrid_pipeline_t
+subgrid_pipeline_get(void) {
+  return pinned;
+}
 
-  for (size_t i = 0; i < size; i++) {
-    int cpt = 0;
-    int color_count = colors_count(*subgrid[i]);
-    for (size_t j = 0; j < size; j++) {
-      if (*subgrid[i] == *subgrid[j]) {
-        cpt++;
+void
+subgrid_pipeline_pin(const subgrid_pipeline_t* pipeline) {
+  pinned = *pipeline;
+}
+
+void
+subgrid_pipeline_print(FILE* fd) {
+  for (size_t size = 0; size <= MAX_COLORS; size++) {
+    const pipeline_t* pipeline = &pipelines[size];
+    if (pipeline->calls == 0) {
+      continue;
+    }
+
+    fprintf(fd, "Heuristics pipeline for size %zu (%zu calls):\n", size,
+            pipeline->calls);
+    const heuristic_t* order = pinned.count ? pinned.order : pipeline->order;
+    size_t count = pinned.count ? pinned.count : HEURISTICS_COUNT;
+
+    for (size_t i = 0; i < count; i++) {
+      heuristic_t heuristic = order[i];
+      fprintf(fd, "  %-6s %10zu runs %10zu eliminations %8.3f elim/us%s\n",
+              heuristic_names[heuristic], pipeline->runs[heuristic],
+              pipeline->eliminations[heuristic],
+              pipeline_rate(pipeline, heuristic) * 1000.0,
+              pipeline->deferred[heuristic] ? " (deferred)" : "");
+    }
+  }
+}
+
+subgrid_status_t
+subgrid_heuristics(colors_t* subgrid[], const size_t size) {
+  pipeline_t* pipeline = pipeline_get(size);
+
+  if (pinned.count > 0) {
+    pipeline->calls++;
+    for (size_t i = 0; i < pinned.count; i++) {
+      subgrid_status_t status =
+          pipeline_run(pipeline, pinned.order[i], subgrid, size);
+      if (status != subgrid_unchanged) {
+        return status;
       }
     }
-    if (cpt == color_count) {
-      for (size_t j = 0; j < size; j++) {
-        if (*subgrid[i] != *subgrid[j]) {
-          colors_t temp = *subgrid[j];
-          *subgrid[j] = colors_subtract(*subgrid[j], *subgrid[i]);
-          if (temp != *subgrid[j]) {
-            result = true;
-          }
-        }
+    return subgrid_unchanged;
+  }
+
+  if (pipeline->calls == 0) {
+    for (size_t i = 0; i < HEURISTICS_COUNT; i++) {
+      pipeline->order[i] = i;
+    }
+  } else if (pipeline->calls >= PIPELINE_WARMUP_CALLS
+             && pipeline->calls % PIPELINE_REORDER_PERIOD == 0) {
+    pipeline_reorder(pipeline);
+  }
+  pipeline->calls++;
+
+  for (size_t i = 0; i < HEURISTICS_COUNT; i++) {
+    heuristic_t heuristic = pipeline->order[i];
+    if (!pipeline->deferred[heuristic]) {
+      subgrid_status_t status =
+          pipeline_run(pipeline, heuristic, subgrid, size);
+      if (status != subgrid_unchanged) {
+        return status;
       }
     }
   }
-  return result;
+
+  return subgrid_unchanged;
 }
 
-bool
-subgrid_heuristics(colors_t* subgrid[], const size_t size) {
+subgrid_status_t
+subgrid_deferred_heuristics(colors_t* subgrid[], const size_t size) {
+  pipeline_t* pipeline = pipeline_get(size);
+
+  if (pinned.count > 0) {
+    return subgrid_unchanged;
+  }
+
+  for (size_t i = 0; i < HEURISTICS_COUNT; i++) {
+    heuristic_t heuristic = pipeline->order[i];
+    if (pipeline->deferred[heuristic]) {
+      subgrid_status_t status =
+          pipeline_run(pipeline, heuristic, subgrid, size);
+      if (status != subgrid_unchanged) {
+        return status;
+      }
+    }
+  }
 
-  return cross_hatching_heuristics(subgrid, size)
-         || lone_number_heuristic(subgrid, size)
-         || naked_subset_heuristic(subgrid, size);
+  return subgrid_unchanged;
 }
@@ -0,0 +1,133 @@
+/* Subgrid heuristics, included once per subgrid size by colors.c (see
+ * kernels.h): each one returns the number of colors it removed, or
+ * CONTRADICTION as soon as it finds the subgrid inconsistent. They work on a
+ * local copy of the cells, written back when something was removed. */
+
+static size_t
+KERNEL(cross_hatching)(colors_t* subgrid[], const size_t size) {
+  (void)size;
+  colors_t cells[KERNEL_SIZE];
+  size_t result = 0;
+  colors_t singletons = colors_empty();
+
+  for (size_t i = 0; i < KERNEL_SIZE; i++) {
+    cells[i] = *subgrid[i];
+  }
+
+  for (size_t i = 0; i < KERNEL_SIZE; i++) {
+    if (colors_is_singleton(cells[i])) {
+      if (colors_and(singletons, cells[i]) != colors_empty()) {
+        return CONTRADICTION;
+      }
+      singletons = colors_or(singletons, cells[i]);
+    }
+  }
+
+  for (size_t i = 0; i < KERNEL_SIZE; i++) {
+    if (!colors_is_singleton(cells[i])) {
+      colors_t removed = colors_and(cells[i], singletons);
+      if (removed != colors_empty()) {
+        cells[i] = colors_subtract(cells[i], singletons);
+        *subgrid[i] = cells[i];
+        result += colors_count(removed);
+      }
+      if (cells[i] == colors_empty()) {
+        return CONTRADICTION;
+      }
+    }
+  }
+
+  return result;
+}
+
+static size_t
+KERNEL(lone_number)(colors_t* subgrid[], const size_t size) {
+  (void)size;
+  colors_t cells[KERNEL_SIZE];
+  colors_t full = colors_full(KERNEL_SIZE);
+  colors_t once = colors_empty();
+  colors_t twice = colors_empty();
+  size_t result = 0;
+
+  /* Colors found in at least one, and at least two, cells */
+  for (size_t i = 0; i < KERNEL_SIZE; i++) {
+    cells[i] = *subgrid[i];
+    twice = colors_or(twice, colors_and(once, cells[i]));
+    once = colors_or(once, cells[i]);
+  }
+  if (once != full) {
+    return CONTRADICTION;
+  }
+
+  /* Colors in a single cell, by increasing color: placing one removes the
+   * other colors of its cell, the counts are then taken again. */
+  colors_t lone = colors_subtract(once, twice);
+  for (colors_t left = lone; left != colors_empty();) {
+    colors_t color = colors_rightmost(left);
+    size_t position = 0;
+
+    while (colors_and(cells[position], color) == colors_empty()) {
+      position++;
+    }
+    if (!colors_is_singleton(cells[position])) {
+      result += colors_count(cells[position]) - 1;
+      cells[position] = color;
+      *subgrid[position] = color;
+
+      once = twice = colors_empty();
+      for (size_t i = 0; i < KERNEL_SIZE; i++) {
+        twice = colors_or(twice, colors_and(once, cells[i]));
+        once = colors_or(once, cells[i]);
+      }
+      if (once != full) {
+        return CONTRADICTION;
+      }
+      lone = colors_subtract(once, twice);
+    }
+    left = colors_subtract(lone, colors_or(color, color - 1));
+  }
+
+  return result;
+}
+
+static size_t
+KERNEL(naked_subset)(colors_t* subgrid[], const size_t size) {
+  (void)size;
+  colors_t cells[KERNEL_SIZE];
+  size_t result = 0;
+
+  for (size_t i = 0; i < KERNEL_SIZE; i++) {
+    cells[i] = *subgrid[i];
+  }
+
+  for (size_t i = 0; i < KERNEL_SIZE; i++) {
+    size_t cpt = 0;
+    size_t color_count = colors_count(cells[i]);
+    for (size_t j = 0; j < KERNEL_SIZE; j++) {
+      cpt += cells[i] == cells[j];
+    }
+    /* More cells than colors to share between them */
+    if (cpt > color_count) {
+      return CONTRADICTION;
+    }
+    if (cpt == color_count) {
+      for (size_t j = 0; j < KERNEL_SIZE; j++) {
+        if (cells[i] != cells[j]) {
+          colors_t removed = colors_and(cells[j], cells[i]);
+          if (removed != colors_empty()) {
+            cells[j] = colors_subtract(cells[j], cells[i]);
+            *subgrid[j] = cells[j];
+            result += colors_count(removed);
+          }
+          if (cells[j] == colors_empty()) {
+            return CONTRADICTION;
+          }
+        }
+      }
+    }
+  }
+  return result;
+}
+
+#undef KERNEL_SIZE
+#undef KERNEL_SUFFIX
@@ -0,0 +1,255 @@
+#include "dedup.h"
+
+#include <canon.h>
+#include <grid.h>
+#include <pool.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Slots of the table of hashes at first, doubled when half of them are used */
+#define DEDUP_SLOTS 1024
+
+struct _dedup_t {
+  size_t size;
+  pool_t* pool;
+  uint8_t cells[UINT8_MAX + 1]; /* Cell of each character */
+
+  /* Table of the hashes of the classes, 0 for a free slot */
+  uint64_t* hashes;
+  uint32_t* indexes; /* Class of each slot */
+  size_t slots;
+
+  /* Classes, in the order they came: their first puzzle, their canonical
+   * form and their count */
+  char* puzzles;
+  uint8_t* forms;
+  size_t* counts;
+  size_t classes;
+  size_t capacity;
+
+  size_t total;   /* Puzzles added */
+  size_t inexact; /* Puzzles whose form is not exact */
+};
+
+/* Puzzles of a call of dedup_add(), their forms and the hashes of them */
+typedef struct {
+  const dedup_t* dedup;
+  const char* puzzles;
+  size_t count;
+  uint8_t* forms;
+  uint64_t* hashes;
+  bool* exact;
+} dedup_run_t;
+
+dedup_t*
+dedup_alloc(const size_t size, const size_t threads) {
+  if (!grid_check_size(size)) {
+    return NULL;
+  }
+
+  dedup_t* dedup = calloc(1, sizeof(dedup_t));
+  if (dedup == NULL) {
+    return NULL;
+  }
+
+  dedup->size = size;
+  dedup->slots = DEDUP_SLOTS;
+  dedup->pool = pool_alloc(threads);
+  dedup->hashes = calloc(dedup->slots, sizeof(uint64_t));
+  dedup->indexes = malloc(dedup->slots * sizeof(uint32_t));
+  if (dedup->pool == NULL || dedup->hashes == NULL
+      || dedup->indexes == NULL) {
+    dedup_free(dedup);
+    return NULL;
+  }
+
+  for (size_t color = 0; color < size; color++) {
+    dedup->cells[(unsigned char)color_table[color]] = color + 1;
+  }
+  return dedup;
+}
+
+void
+dedup_free(dedup_t* dedup) {
+  if (dedup == NULL) {
+    return;
+  }
+
+  pool_free(dedup->pool);
+  free(dedup->hashes);
+  free(dedup->indexes);
+  free(dedup->puzzles);
+  free(dedup->forms);
+  free(dedup->counts);
+  free(dedup);
+}
+
+/* Canonical forms of a block of puzzles */
+static void
+dedup_task(void* context, const size_t index) {
+  dedup_run_t* run = context;
+  const dedup_t* dedup = run->dedup;
+  const size_t cells = dedup->size * dedup->size;
+  const size_t end = (index + 1) * DEDUP_BLOCK < run->count
+                         ? (index + 1) * DEDUP_BLOCK
+                         : run->count;
+  uint8_t grid[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  canon_t canon;
+
+  for (size_t i = index * DEDUP_BLOCK; i < end; i++) {
+    const char* puzzle = &run->puzzles[i * cells];
+
+    for (size_t cell = 0; cell < cells; cell++) {
+      grid[cell] = dedup->cells[(unsigned char)puzzle[cell]];
+    }
+    run->exact[i] = canon_compute(dedup->size, grid, &canon);
+    memcpy(&run->forms[i * cells], canon.form, cells);
+
+    /* 0 stands for a free slot */
+    run->hashes[i] = canon.hash ? canon.hash : 1;
+  }
+}
+
+/* The slot of the class of a form, or the free slot where it goes: forms of
+ * the same hash are told apart by their cells */
+static size_t
+dedup_slot(const dedup_t* dedup, const uint64_t hash, const uint8_t* form) {
+  const size_t cells = dedup->size * dedup->size;
+  size_t slot = hash & (dedup->slots - 1);
+
+  while (dedup->hashes[slot] != 0
+         && (dedup->hashes[slot] != hash
+             || memcmp(&dedup->forms[dedup->indexes[slot] * cells], form,
+                       cells))) {
+    slot = (slot + 1) & (dedup->slots - 1);
+  }
+  return slot;
+}
+
+static bool
+dedup_grow(dedup_t* dedup) {
+  const size_t cells = dedup->size * dedup->size;
+  uint64_t* hashes = dedup->hashes;
+  uint32_t* indexes = dedup->indexes;
+  size_t slots = dedup->slots;
+
+  dedup->slots = 2 * slots;
+  dedup->hashes = calloc(dedup->slots, sizeof(uint64_t));
+  dedup->indexes = malloc(dedup->slots * sizeof(uint32_t));
+  if (dedup->hashes == NULL || dedup->indexes == NULL) {
+    free(dedup->hashes);
+    free(dedup->indexes);
+    dedup->hashes = hashes;
+    dedup->indexes = indexes;
+    dedup->slots = slots;
+    return false;
+  }
+
+  for (size_t i = 0; i < slots; i++) {
+    if (hashes[i] != 0) {
+      size_t slot = dedup_slot(dedup, hashes[i],
+                               &dedup->forms[indexes[i] * cells]);
+      dedup->hashes[slot] = hashes[i];
+      dedup->indexes[slot] = indexes[i];
+    }
+  }
+  free(hashes);
+  free(indexes);
+  return true;
+}
+
+/* Makes room for one more class */
+static bool
+dedup_reserve(dedup_t* dedup) {
+  const size_t cells = dedup->size * dedup->size;
+
+  if (2 * (dedup->classes + 1) > dedup->slots && !dedup_grow(dedup)) {
+    return false;
+  }
+  if (dedup->classes < dedup->capacity) {
+    return true;
+  }
+
+  size_t capacity = dedup->capacity ? 2 * dedup->capacity : DEDUP_SLOTS;
+  char* puzzles = realloc(dedup->puzzles, capacity * cells);
+  if (puzzles == NULL) {
+    return false;
+  }
+  dedup->puzzles = puzzles;
+
+  uint8_t* forms = realloc(dedup->forms, capacity * cells);
+  if (forms == NULL) {
+    return false;
+  }
+  dedup->forms = forms;
+
+  size_t* counts = realloc(dedup->counts, capacity * sizeof(size_t));
+  if (counts == NULL) {
+    return false;
+  }
+  dedup->counts = counts;
+  dedup->capacity = capacity;
+  return true;
+}
+
+bool
+dedup_add(dedup_t* dedup, const size_t count, const char* puzzles) {
+  const size_t cells = dedup->size * dedup->size;
+  uint8_t* forms = malloc(count * cells);
+  uint64_t* hashes = malloc(count * sizeof(uint64_t));
+  bool* exact = malloc(count * sizeof(bool));
+  bool added = forms != NULL && hashes != NULL && exact != NULL;
+
+  if (added) {
+    dedup_run_t run = {dedup, puzzles, count, forms, hashes, exact};
+    pool_run(dedup->pool, dedup_task, &run,
+             (count + DEDUP_BLOCK - 1) / DEDUP_BLOCK);
+  }
+
+  for (size_t i = 0; added && i < count; i++) {
+    const uint8_t* form = &forms[i * cells];
+    size_t slot = dedup_slot(dedup, hashes[i], form);
+
+    if (dedup->hashes[slot] == 0) {
+      if (!(added = dedup_reserve(dedup))) {
+        break;
+      }
+      slot = dedup_slot(dedup, hashes[i], form);
+      dedup->hashes[slot] = hashes[i];
+      dedup->indexes[slot] = dedup->classes;
+      memcpy(&dedup->puzzles[dedup->classes * cells], &puzzles[i * cells],
+             cells);
+      memcpy(&dedup->forms[dedup->classes * cells], form, cells);
+      dedup->counts[dedup->classes++] = 0;
+    }
+    dedup->counts[dedup->indexes[slot]]++;
+    dedup->inexact += !exact[i];
+    dedup->total++;
+  }
+
+  free(forms);
+  free(hashes);
+  free(exact);
+  return added;
+}
+
+void
+dedup_print(const dedup_t* dedup, FILE* fd) {
+  const size_t cells = dedup->size * dedup->size;
+
+  for (size_t i = 0; i < dedup->classes; i++) {
+    fprintf(fd, "%.*s %zu\n", (int)cells, &dedup->puzzles[i * cells],
+            dedup->counts[i]);
+  }
+}
+
+void
+dedup_print_stats(const dedup_t* dedup, FILE* fd) {
+  fprintf(fd, "dedup: %zu puzzles, %zu classes, %zu forms not exact\n",
+          dedup->total, dedup->classes, dedup->inexact);
+}
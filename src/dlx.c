@@ -0,0 +1,353 @@
+#include "dlx.h"
+
+#include <colors.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Toroidal doubly linked exact cover matrix: node 0 is the root, nodes 1 to
+ * 'columns' are the column headers, then come 4 nodes per matrix row. */
+typedef struct {
+  size_t size;
+  size_t columns;
+  size_t rows;
+  int32_t* left;
+  int32_t* right;
+  int32_t* up;
+  int32_t* down;
+  int32_t* column; /* Header of the column of each node */
+  int32_t* count;  /* Number of rows left in each column */
+} dlx_t;
+
+/* State of a search on a shared matrix */
+typedef struct {
+  dlx_t* matrix;
+  const grid_t* grid;
+  _mode_t mode;
+  size_t* solution_count;
+  int32_t* path; /* First node of each selected row */
+  size_t depth;
+  grid_t* solution;
+} search_t;
+
+/* Matrices by grid size, built on first use and kept for the next grids of
+ * the thread: the search relinks them in place */
+static _Thread_local dlx_t* matrices[MAX_GRID_SIZE + 1];
+
+/* First node of the matrix row of a color in a cell */
+static int32_t
+row_node(const dlx_t* matrix, const size_t cell, const size_t color) {
+  return 1 + matrix->columns + 4 * (cell * matrix->size + color);
+}
+
+static void
+dlx_matrix_free(dlx_t* matrix) {
+  free(matrix->left);
+  free(matrix->right);
+  free(matrix->up);
+  free(matrix->down);
+  free(matrix->column);
+  free(matrix->count);
+  free(matrix);
+}
+
+void
+dlx_release(void) {
+  for (size_t size = 0; size <= MAX_GRID_SIZE; size++) {
+    if (matrices[size] != NULL) {
+      dlx_matrix_free(matrices[size]);
+      matrices[size] = NULL;
+    }
+  }
+}
+
+static dlx_t*
+dlx_matrix(const size_t size) {
+  if (matrices[size] != NULL) {
+    return matrices[size];
+  }
+
+  dlx_t* matrix = malloc(sizeof(dlx_t));
+  if (matrix == NULL) {
+    return NULL;
+  }
+
+  size_t block_size = sqrt(size);
+  size_t nodes;
+
+  matrix->size = size;
+  matrix->columns = 4 * size * size;
+  matrix->rows = size * size * size;
+  nodes = 1 + matrix->columns + 4 * matrix->rows;
+  matrix->left = malloc(nodes * sizeof(int32_t));
+  matrix->right = malloc(nodes * sizeof(int32_t));
+  matrix->up = malloc(nodes * sizeof(int32_t));
+  matrix->down = malloc(nodes * sizeof(int32_t));
+  matrix->column = malloc(nodes * sizeof(int32_t));
+  matrix->count = calloc(1 + matrix->columns, sizeof(int32_t));
+  if (matrix->left == NULL || matrix->right == NULL || matrix->up == NULL
+      || matrix->down == NULL || matrix->column == NULL
+      || matrix->count == NULL) {
+    dlx_matrix_free(matrix);
+    return NULL;
+  }
+
+  for (size_t header = 0; header <= matrix->columns; header++) {
+    matrix->left[header] = header == 0 ? matrix->columns : header - 1;
+    matrix->right[header] = header == matrix->columns ? 0 : header + 1;
+    matrix->up[header] = header;
+    matrix->down[header] = header;
+    matrix->column[header] = header;
+  }
+
+  for (size_t cell = 0; cell < size * size; cell++) {
+    size_t row = cell / size;
+    size_t column = cell % size;
+    size_t block = (row / block_size) * block_size + column / block_size;
+
+    for (size_t color = 0; color < size; color++) {
+      int32_t first = row_node(matrix, cell, color);
+      size_t headers[4] = {1 + cell, 1 + size * size + row * size + color,
+                           1 + 2 * size * size + column * size + color,
+                           1 + 3 * size * size + block * size + color};
+
+      for (size_t i = 0; i < 4; i++) {
+        int32_t node = first + i;
+        int32_t header = headers[i];
+
+        matrix->left[node] = first + (i + 3) % 4;
+        matrix->right[node] = first + (i + 1) % 4;
+        matrix->column[node] = header;
+        matrix->up[node] = matrix->up[header];
+        matrix->down[node] = header;
+        matrix->down[matrix->up[header]] = node;
+        matrix->up[header] = node;
+        matrix->count[header]++;
+      }
+    }
+  }
+
+  matrices[size] = matrix;
+  return matrix;
+}
+
+static void
+cover(dlx_t* matrix, const int32_t header) {
+  matrix->right[matrix->left[header]] = matrix->right[header];
+  matrix->left[matrix->right[header]] = matrix->left[header];
+
+  for (int32_t i = matrix->down[header]; i != header; i = matrix->down[i]) {
+    for (int32_t j = matrix->right[i]; j != i; j = matrix->right[j]) {
+      matrix->down[matrix->up[j]] = matrix->down[j];
+      matrix->up[matrix->down[j]] = matrix->up[j];
+      matrix->count[matrix->column[j]]--;
+    }
+  }
+}
+
+static void
+uncover(dlx_t* matrix, const int32_t header) {
+  for (int32_t i = matrix->up[header]; i != header; i = matrix->up[i]) {
+    for (int32_t j = matrix->left[i]; j != i; j = matrix->left[j]) {
+      matrix->count[matrix->column[j]]++;
+      matrix->down[matrix->up[j]] = j;
+      matrix->up[matrix->down[j]] = j;
+    }
+  }
+
+  matrix->right[matrix->left[header]] = header;
+  matrix->left[matrix->right[header]] = header;
+}
+
+/* Take a matrix row out of all its columns (a color ruled out by the grid) */
+static void
+hide_row(dlx_t* matrix, const int32_t first) {
+  for (int32_t i = 0; i < 4; i++) {
+    int32_t node = first + i;
+    matrix->down[matrix->up[node]] = matrix->down[node];
+    matrix->up[matrix->down[node]] = matrix->up[node];
+    matrix->count[matrix->column[node]]--;
+  }
+}
+
+static void
+unhide_row(dlx_t* matrix, const int32_t first) {
+  for (int32_t i = 3; i >= 0; i--) {
+    int32_t node = first + i;
+    matrix->count[matrix->column[node]]++;
+    matrix->down[matrix->up[node]] = node;
+    matrix->up[matrix->down[node]] = node;
+  }
+}
+
+/* Select a matrix row: cover every column it satisfies */
+static void
+select_row(dlx_t* matrix, const int32_t node) {
+  cover(matrix, matrix->column[node]);
+  for (int32_t j = matrix->right[node]; j != node; j = matrix->right[j]) {
+    cover(matrix, matrix->column[j]);
+  }
+}
+
+static void
+unselect_row(dlx_t* matrix, const int32_t node) {
+  for (int32_t j = matrix->left[node]; j != node; j = matrix->left[j]) {
+    uncover(matrix, matrix->column[j]);
+  }
+  uncover(matrix, matrix->column[node]);
+}
+
+/* Fill a copy of the grid with the rows of the current path */
+static grid_t*
+search_grid(const search_t* search) {
+  dlx_t* matrix = search->matrix;
+  grid_t* result = grid_copy(search->grid);
+  if (result == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  for (size_t i = 0; i < search->depth; i++) {
+    size_t index = (search->path[i] - 1 - matrix->columns) / 4;
+    size_t cell = index / matrix->size;
+    grid_set_colors(result, cell / matrix->size, cell % matrix->size,
+                    colors_set(index % matrix->size));
+  }
+  return result;
+}
+
+/* Algorithm X, true once a solution is found in mode_first, or the limit of
+ * the solutions is reached in mode_all. The matrix is left as it was found
+ * in every case. */
+static bool
+search_run(search_t* search) {
+  dlx_t* matrix = search->matrix;
+
+  if (matrix->right[0] == 0) {
+    if (search->mode == mode_first) {
+      search->solution = search_grid(search);
+      return true;
+    }
+
+    grid_t* solution = search_grid(search);
+    bool more = grid_report_solution(solution);
+    grid_free(solution);
+    (*search->solution_count)++;
+    return !more;
+  }
+
+  int32_t header = matrix->right[0];
+  for (int32_t j = matrix->right[header]; j != 0; j = matrix->right[j]) {
+    if (matrix->count[j] < matrix->count[header]) {
+      header = j;
+    }
+  }
+  if (matrix->count[header] == 0) {
+    return false;
+  }
+
+  bool found = false;
+  cover(matrix, header);
+  for (int32_t i = matrix->down[header]; i != header && !found;
+       i = matrix->down[i]) {
+    for (int32_t j = matrix->right[i]; j != i; j = matrix->right[j]) {
+      cover(matrix, matrix->column[j]);
+    }
+
+    search->path[search->depth++] = i;
+    found = search_run(search);
+    search->depth--;
+
+    for (int32_t j = matrix->left[i]; j != i; j = matrix->left[j]) {
+      uncover(matrix, matrix->column[j]);
+    }
+  }
+  uncover(matrix, header);
+
+  return found;
+}
+
+grid_t*
+dlx_solver(grid_t* grid, _mode_t mode, size_t* solution_count) {
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  /* The unit heuristics shrink the matrix before the search */
+  grid_t* copy = grid_copy(grid);
+  if (copy == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  status_t status = grid_heuristics(copy);
+  if (status != grid_unsolved) {
+    if (status == grid_solved) {
+      if (mode == mode_first) {
+        return copy;
+      }
+      grid_report_solution(copy);
+      (*solution_count)++;
+    }
+    grid_free(copy);
+    return NULL;
+  }
+
+  size_t size = grid_get_size(copy);
+  dlx_t* matrix = dlx_matrix(size);
+  int32_t* hidden = malloc(matrix != NULL ? matrix->rows * sizeof(int32_t) : 0);
+  int32_t* given = malloc(size * size * sizeof(int32_t));
+  int32_t* path = malloc(size * size * sizeof(int32_t));
+  if (matrix == NULL || hidden == NULL || given == NULL || path == NULL) {
+    free(hidden);
+    free(given);
+    free(path);
+    grid_free(copy);
+    grid_report_failure();
+    return NULL;
+  }
+
+  size_t hidden_count = 0;
+  size_t given_count = 0;
+
+  for (size_t cell = 0; cell < size * size; cell++) {
+    colors_t colors = grid_get_colors(copy, cell / size, cell % size);
+    for (size_t color = 0; color < size; color++) {
+      if (!colors_is_in(colors, color)) {
+        hidden[hidden_count] = row_node(matrix, cell, color);
+        hide_row(matrix, hidden[hidden_count++]);
+      }
+    }
+  }
+
+  /* The known cells are consistent (grid_heuristics() checked it), their rows
+   * are still in the matrix when selected. */
+  for (size_t cell = 0; cell < size * size; cell++) {
+    colors_t colors = grid_get_colors(copy, cell / size, cell % size);
+    if (colors_is_singleton(colors)) {
+      given[given_count] =
+          row_node(matrix, cell, colors_count(colors_rightmost(colors) - 1));
+      select_row(matrix, given[given_count++]);
+    }
+  }
+
+  search_t search = {matrix, copy, mode, solution_count, path, 0, NULL};
+  search_run(&search);
+
+  while (given_count > 0) {
+    unselect_row(matrix, given[--given_count]);
+  }
+  while (hidden_count > 0) {
+    unhide_row(matrix, hidden[--hidden_count]);
+  }
+
+  free(hidden);
+  free(given);
+  free(path);
+  grid_free(copy);
+  return search.solution;
+}
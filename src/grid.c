@@ -1,20 +1,451 @@
 #include "grid.h"
 
+#include <alldiff.h>
+#include <band.h>
+#include <cdcl.h>
 #include <colors.h>
+#include <dlx.h>
+#include <lean.h>
+#include <pool.h>
 
-#include <math.h>
+#include "kernels.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Sets of decision levels are bitmasks, levels from 63 up share bit 63: the
+ * backjumps between them are lost, but they stay sound. */
+typedef uint64_t levels_t;
+
+/* Tiers of unit deductions, from the cheapest */
+typedef enum { tier_pipeline, tier_deferred, tier_alldiff } unit_tier_t;
+
+/* Hot kernels of a grid, instantiated for each grid size (grid_kernels.h) */
+typedef struct {
+  subgrid_status_t (*unit_heuristics)(grid_t* grid, const size_t* units,
+                                      const size_t index,
+                                      const unit_tier_t tier);
+  subgrid_status_t (*unit_compute)(const grid_t* grid, const size_t* units,
+                                   const size_t index, const unit_tier_t tier,
+                                   colors_t values[]);
+  subgrid_status_t (*unit_apply)(grid_t* grid, const size_t* units,
+                                 const size_t index,
+                                 const subgrid_status_t status,
+                                 const colors_t values[]);
+} grid_kernels_t;
+
+static const grid_kernels_t grid_kernels[MAX_GRID_SIZE + 1];
+
 /* Internat structure (hidden from outside) for a sudoku grid*/
 struct _grid_t {
   size_t size;
-  colors_t** cells;
+  size_t block_size;
+  const grid_kernels_t* kernels; /* Instances for the size of the grid */
+  const void* owner; /* Slab lists of the thread that took the slab */
+  size_t cell_width; /* Bytes per cell, see cell_width() */
+  void* cells;       /* size * size cells, row by row */
+  size_t unresolved; /* Number of cells which are not singletons */
+  size_t conflicts;  /* Number of empty cells and singletons placed twice */
+  colors_t* placed;  /* Singletons placed per unit (rows, columns, blocks) */
+  size_t* unit_unresolved; /* Number of unresolved cells per unit */
+
+  /* Minimum-remaining-values buckets: doubly linked lists of the unresolved
+   * cells by number of colors, bit (count - 1) of 'buckets' is set when the
+   * bucket of that count is not empty. */
+  uint16_t* bucket_next;
+  uint16_t* bucket_prev;
+  uint16_t* bucket_head;
+  colors_t buckets;
+
+  /* Color-major view of the cells: bit j of color_rows[c * size + i] (resp.
+   * color_columns[c * size + j]) is set when color c is possible in the cell
+   * of row i and column j. */
+  colors_t* color_rows;
+  colors_t* color_columns;
+
+  /* Conflict-directed backjumping: decision levels (set of search depths)
+   * each unit depends on, the reason of the changes being made, and the
+   * levels the contradictions found so far depend on. */
+  size_t level;
+  levels_t* reasons;
+  levels_t change_reason;
+  levels_t conflict_reason;
 };
 
+/* Width in bytes of the cells of a grid of the given size: the narrowest
+ * integer type holding all its colors (a 9x9 grid takes 162 bytes instead of
+ * 648). */
+static size_t
+cell_width(const size_t size) {
+  if (size <= 8) {
+    return sizeof(uint8_t);
+  }
+  if (size <= 16) {
+    return sizeof(uint16_t);
+  }
+  if (size <= 32) {
+    return sizeof(uint32_t);
+  }
+  if (size <= 64) {
+    return sizeof(uint64_t);
+  }
+  return sizeof(colors_t);
+}
+
+static colors_t
+cell_get(const grid_t* grid, const size_t row, const size_t column) {
+  size_t cell = row * grid->size + column;
+
+  switch (grid->cell_width) {
+    case sizeof(uint8_t):
+      return ((const uint8_t*)grid->cells)[cell];
+    case sizeof(uint16_t):
+      return ((const uint16_t*)grid->cells)[cell];
+    case sizeof(uint32_t):
+      return ((const uint32_t*)grid->cells)[cell];
+    case sizeof(uint64_t):
+      return ((const uint64_t*)grid->cells)[cell];
+    default:
+      return ((const colors_t*)grid->cells)[cell];
+  }
+}
+
+static void
+cell_put(grid_t* grid, const size_t row, const size_t column,
+         const colors_t colors) {
+  size_t cell = row * grid->size + column;
+
+  switch (grid->cell_width) {
+    case sizeof(uint8_t):
+      ((uint8_t*)grid->cells)[cell] = colors;
+      break;
+    case sizeof(uint16_t):
+      ((uint16_t*)grid->cells)[cell] = colors;
+      break;
+    case sizeof(uint32_t):
+      ((uint32_t*)grid->cells)[cell] = colors;
+      break;
+    case sizeof(uint64_t):
+      ((uint64_t*)grid->cells)[cell] = colors;
+      break;
+    default:
+      ((colors_t*)grid->cells)[cell] = colors;
+  }
+}
+
+/* The settings below, like the search state, belong to the thread that set
+ * them: threads solving side by side do not see each other's. */
+
+static _Thread_local bool backjumping = false;
+
+static _Thread_local engine_t engine = engine_dfs;
+
+/* Largest grids given to DLX by engine_auto: it is the fastest engine up to
+ * 16x16 (both for a first solution and for counting), while its search blows
+ * up on the hard 25x25 and 64x64 grids that CDCL solves within a second. */
+#define ENGINE_AUTO_DLX_MAX_SIZE 16
+
+/* Largest grids given to the lean engine by engine_auto: 1.5x the rate of DLX
+ * on 9x9 grids, but a heavy tail on 16x16 ones. */
+#define ENGINE_AUTO_LEAN_MAX_SIZE 9
+
+void
+grid_set_engine(const engine_t new_engine) {
+  engine = new_engine;
+}
+
+void
+grid_set_backjumping(const bool enabled) {
+  backjumping = enabled;
+}
+
+static levels_t
+level_bit(const size_t level) {
+  return 1ULL << (level < 63 ? level : 63);
+}
+
+/* All the decision levels from the root up to level */
+static levels_t
+levels_upto(const size_t level) {
+  return level < 63 ? (level_bit(level) << 1) - 1 : (levels_t)-1;
+}
+
+/* End of a bucket list */
+#define NO_CELL UINT16_MAX
+
+/* Cells with the fewest colors looked at to break ties between them */
+#define TIES_SCAN_LIMIT 32
+
+/* Branching strategy: cell selection, value ordering and tie-breaking */
+static _Thread_local struct {
+  branching_t cell;
+  bool lcv;
+  bool random_ties;
+} branching = {branch_mrv, false, false};
+
+/* Weight of each unit for dom/wdeg, bumped when it causes a contradiction */
+static _Thread_local size_t unit_weights[3 * MAX_GRID_SIZE];
+
+/* State of the xorshift64* generator used for random tie-breaking */
+static _Thread_local uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+bool
+grid_set_branching(const char* spec) {
+  branching_t cell = branch_mrv;
+  bool lcv = false;
+  bool random_ties = false;
+  const char* name = spec;
+
+  while (name != NULL && *name != '\0') {
+    size_t length = strcspn(name, ",");
+
+    if (length == 3 && !strncmp(name, "mrv", length)) {
+      cell = branch_mrv;
+    } else if (length == 6 && !strncmp(name, "degree", length)) {
+      cell = branch_degree;
+    } else if (length == 4 && !strncmp(name, "wdeg", length)) {
+      cell = branch_wdeg;
+    } else if (length == 3 && !strncmp(name, "lcv", length)) {
+      lcv = true;
+    } else if (length == 6 && !strncmp(name, "random", length)) {
+      random_ties = true;
+    } else {
+      return false;
+    }
+
+    name += length;
+    if (*name == ',') {
+      name++;
+    }
+  }
+
+  branching.cell = cell;
+  branching.lcv = lcv;
+  branching.random_ties = random_ties;
+  return true;
+}
+
+void
+grid_set_seed(const uint64_t seed) {
+  /* xorshift must not start from 0 */
+  random_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+static uint64_t
+random_next(void) {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Compare a candidate score to the best one so far (lower is better) and
+ * break ties at random when asked to; 'ties' counts the ties seen so far so
+ * that each of them ends up picked with the same probability. */
+static bool
+score_is_better(const double score, const double best, size_t* ties) {
+  if (score < best) {
+    *ties = 1;
+    return true;
+  }
+  if (score > best || !branching.random_ties) {
+    return false;
+  }
+  (*ties)++;
+  return random_next() % *ties == 0;
+}
+
+/* Cells of each unit (rows, then columns, then blocks) per grid size, built
+ * once and shared by all the grids of that size, in all threads: the first
+ * table published wins, the others are dropped. */
+static _Atomic(size_t*) topologies[MAX_GRID_SIZE + 1];
+
+static const size_t*
+grid_units(const size_t size) {
+  size_t* published =
+      atomic_load_explicit(&topologies[size], memory_order_acquire);
+  if (published != NULL) {
+    return published;
+  }
+
+  size_t block_size = kernel_block_sizes[size];
+  size_t* units = malloc(3 * size * size * sizeof(size_t));
+  if (units == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    size_t start_row = (i / block_size) * block_size;
+    size_t start_col = (i % block_size) * block_size;
+    for (size_t j = 0; j < size; j++) {
+      units[i * size + j] = i * size + j;
+      units[(size + i) * size + j] = j * size + i;
+      units[(2 * size + i) * size + j] =
+          (start_row + j / block_size) * size + start_col + j % block_size;
+    }
+  }
+
+  if (!atomic_compare_exchange_strong_explicit(&topologies[size], &published,
+                                               units, memory_order_acq_rel,
+                                               memory_order_acquire)) {
+    free(units);
+    return published;
+  }
+  return units;
+}
+
+static void
+bucket_insert(grid_t* grid, const size_t cell, const size_t count) {
+  uint16_t head = grid->bucket_head[count];
+
+  grid->bucket_prev[cell] = NO_CELL;
+  grid->bucket_next[cell] = head;
+  if (head != NO_CELL) {
+    grid->bucket_prev[head] = cell;
+  }
+  grid->bucket_head[count] = cell;
+  grid->buckets = colors_add(grid->buckets, count - 1);
+}
+
+static void
+bucket_remove(grid_t* grid, const size_t cell, const size_t count) {
+  uint16_t prev = grid->bucket_prev[cell];
+  uint16_t next = grid->bucket_next[cell];
+
+  if (prev != NO_CELL) {
+    grid->bucket_next[prev] = next;
+  } else {
+    grid->bucket_head[count] = next;
+    if (next == NO_CELL) {
+      grid->buckets = colors_discard(grid->buckets, count - 1);
+    }
+  }
+  if (next != NO_CELL) {
+    grid->bucket_prev[next] = prev;
+  }
+}
+
+/* Recompute the incremental state of the grid from scratch */
+static void
+grid_state_rebuild(grid_t* grid) {
+  size_t size = grid->size;
+
+  grid->unresolved = 0;
+  grid->conflicts = 0;
+  grid->buckets = colors_empty();
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    grid->placed[unit] = colors_empty();
+    grid->unit_unresolved[unit] = 0;
+  }
+  for (size_t count = 0; count <= size; count++) {
+    grid->bucket_head[count] = NO_CELL;
+  }
+  memset(grid->color_rows, 0, size * size * sizeof(colors_t));
+  memset(grid->color_columns, 0, size * size * sizeof(colors_t));
+
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      colors_t colors = cell_get(grid, row, column);
+      size_t units[3] = {row, size + column,
+                         2 * size + (row / grid->block_size) * grid->block_size
+                             + column / grid->block_size};
+
+      for (colors_t left = colors; left != colors_empty();
+           left = colors_subtract(left, colors_rightmost(left))) {
+        size_t color = colors_count(colors_rightmost(left) - 1);
+        grid->color_rows[color * size + row] |= colors_set(column);
+        grid->color_columns[color * size + column] |= colors_set(row);
+      }
+
+      if (!colors_is_singleton(colors)) {
+        grid->unresolved++;
+        grid->conflicts += colors == colors_empty();
+        for (size_t i = 0; i < 3; i++) {
+          grid->conflict_reason |=
+              colors == colors_empty() ? grid->reasons[units[i]] : 0;
+          grid->unit_unresolved[units[i]]++;
+        }
+        if (colors != colors_empty()) {
+          bucket_insert(grid, row * size + column, colors_count(colors));
+        }
+        continue;
+      }
+      for (size_t i = 0; i < 3; i++) {
+        if (colors_and(grid->placed[units[i]], colors) != colors_empty()) {
+          grid->conflicts++;
+          grid->conflict_reason |= grid->reasons[units[i]];
+        }
+        grid->placed[units[i]] = colors_or(grid->placed[units[i]], colors);
+      }
+    }
+  }
+}
+
+/* Every change to a cell goes through here to keep the incremental state up
+ * to date: removing colors is O(1), anything else falls back to a rebuild. */
+static void
+grid_cell_set(grid_t* grid, const size_t row, const size_t column,
+              const colors_t colors) {
+  colors_t old = cell_get(grid, row, column);
+
+  if (colors_is_equal(old, colors)) {
+    return;
+  }
+
+  cell_put(grid, row, column, colors);
+
+  if (colors_is_singleton(old) || !colors_is_subset(colors, old)) {
+    grid_state_rebuild(grid);
+    return;
+  }
+
+  size_t size = grid->size;
+  size_t cell = row * size + column;
+  size_t units[3] = {row, size + column,
+                     2 * size + (row / grid->block_size) * grid->block_size
+                         + column / grid->block_size};
+  size_t conflicts = grid->conflicts;
+
+  for (size_t i = 0; i < 3; i++) {
+    grid->reasons[units[i]] |= grid->change_reason;
+  }
+
+  for (colors_t left = colors_subtract(old, colors); left != colors_empty();
+       left = colors_subtract(left, colors_rightmost(left))) {
+    size_t color = colors_count(colors_rightmost(left) - 1);
+    grid->color_rows[color * size + row] &= ~colors_set(column);
+    grid->color_columns[color * size + column] &= ~colors_set(row);
+  }
+
+  bucket_remove(grid, cell, colors_count(old));
+
+  if (colors == colors_empty()) {
+    grid->conflicts++;
+  } else if (!colors_is_singleton(colors)) {
+    bucket_insert(grid, cell, colors_count(colors));
+  } else {
+    grid->unresolved--;
+    for (size_t i = 0; i < 3; i++) {
+      grid->unit_unresolved[units[i]]--;
+      grid->conflicts += colors_and(grid->placed[units[i]], colors) != 0;
+      grid->placed[units[i]] = colors_or(grid->placed[units[i]], colors);
+    }
+  }
+
+  if (grid->conflicts != conflicts) {
+    for (size_t i = 0; i < 3; i++) {
+      grid->conflict_reason |= grid->reasons[units[i]];
+    }
+  }
+}
+
 bool
 grid_check_char(const grid_t* grid, const char c) {
   if (!grid) {
@@ -22,6 +453,8 @@ grid_check_char(const grid_t* grid, const char c) {
   }
 
   switch (grid->size) {
+    case 100:
+    case 81:
     case 64:
       return (c >= '1' && c <= '9') || (c >= 'A' && c <= 'Z') || c == '@'
              || (c >= 'a' && c <= 'z') || c == '&' || c == '*' || c == '_';
@@ -46,35 +479,167 @@ grid_check_char(const grid_t* grid, const char c) {
   }
 }
 
+/* Grid slabs: a grid and all its arrays in a single block, sized for the
+ * grid size. Freed slabs are kept on a list per size and per thread and handed
+ * out again most recent first, in the LIFO order of the search going deeper
+ * and backing up: the search allocates nothing once it has been as deep as it
+ * goes. grid_solver() releases the slabs left on the lists.
+ *
+ * A slab freed by another thread than the one that took it joins the lists
+ * of the thread freeing it, which counts it as taken in: threads never touch
+ * each other's lists or counters, so it stays in use for the thread that took
+ * it. */
+
+/* Alignment of the arrays in a slab, the one of colors_t at most */
+#define SLAB_ALIGN 16
+
+/* Offsets of the arrays of a grid in its slab */
+typedef struct {
+  size_t cells;
+  size_t placed;
+  size_t unit_unresolved;
+  size_t reasons;
+  size_t color_rows;
+  size_t color_columns;
+  size_t bucket_next;
+  size_t bucket_prev;
+  size_t bucket_head;
+  size_t total;
+} slab_layout_t;
+
+/* Freed slab, linked through its first bytes */
+typedef struct slab_s {
+  struct slab_s* next;
+} slab_t;
+
+static _Thread_local struct {
+  slab_t* free;
+  size_t live;
+  size_t high_water; /* Most slabs in use at the same time */
+  size_t allocations;
+  size_t reuses;
+  size_t taken_in; /* Slabs freed here, taken by other threads */
+} arenas[MAX_GRID_SIZE + 1];
+
+static size_t
+slab_take(size_t* offset, const size_t bytes) {
+  size_t start = *offset;
+  *offset += (bytes + SLAB_ALIGN - 1) / SLAB_ALIGN * SLAB_ALIGN;
+  return start;
+}
+
+static slab_layout_t
+slab_layout(const size_t size) {
+  slab_layout_t layout;
+  size_t offset = 0;
+
+  slab_take(&offset, sizeof(grid_t));
+  layout.cells = slab_take(&offset, size * size * cell_width(size));
+  layout.placed = slab_take(&offset, 3 * size * sizeof(colors_t));
+  layout.unit_unresolved = slab_take(&offset, 3 * size * sizeof(size_t));
+  layout.reasons = slab_take(&offset, 3 * size * sizeof(levels_t));
+  layout.color_rows = slab_take(&offset, size * size * sizeof(colors_t));
+  layout.color_columns = slab_take(&offset, size * size * sizeof(colors_t));
+  layout.bucket_next = slab_take(&offset, size * size * sizeof(uint16_t));
+  layout.bucket_prev = slab_take(&offset, size * size * sizeof(uint16_t));
+  layout.bucket_head = slab_take(&offset, (size + 1) * sizeof(uint16_t));
+  layout.total = offset;
+
+  return layout;
+}
+
+/* Point the arrays of a grid into its own slab */
+static void
+slab_bind(grid_t* grid, const slab_layout_t* layout) {
+  char* slab = (char*)grid;
+
+  grid->cells = slab + layout->cells;
+  grid->placed = (colors_t*)(slab + layout->placed);
+  grid->unit_unresolved = (size_t*)(slab + layout->unit_unresolved);
+  grid->reasons = (levels_t*)(slab + layout->reasons);
+  grid->color_rows = (colors_t*)(slab + layout->color_rows);
+  grid->color_columns = (colors_t*)(slab + layout->color_columns);
+  grid->bucket_next = (uint16_t*)(slab + layout->bucket_next);
+  grid->bucket_prev = (uint16_t*)(slab + layout->bucket_prev);
+  grid->bucket_head = (uint16_t*)(slab + layout->bucket_head);
+}
+
+static grid_t*
+slab_get(const size_t size, const slab_layout_t* layout) {
+  slab_t* slab = arenas[size].free;
+
+  if (slab != NULL) {
+    arenas[size].free = slab->next;
+    arenas[size].reuses++;
+  } else {
+    slab = aligned_alloc(SLAB_ALIGN, layout->total);
+    if (slab == NULL) {
+      return NULL;
+    }
+    arenas[size].allocations++;
+  }
+  if (++arenas[size].live > arenas[size].high_water) {
+    arenas[size].high_water = arenas[size].live;
+  }
+  return (grid_t*)slab;
+}
+
+void
+grid_arena_release(void) {
+  for (size_t size = 0; size <= MAX_GRID_SIZE; size++) {
+    while (arenas[size].free != NULL) {
+      slab_t* slab = arenas[size].free;
+      arenas[size].free = slab->next;
+      free(slab);
+    }
+  }
+}
+
+void
+grid_arena_print(FILE* fd) {
+  for (size_t size = 0; size <= MAX_GRID_SIZE; size++) {
+    if (arenas[size].allocations == 0) {
+      continue;
+    }
+    fprintf(fd,
+            "Grid slabs for size %zu: %zu bytes, %zu in use at most, "
+            "%zu allocated, %zu reused, %zu taken in from other threads\n",
+            size, slab_layout(size).total, arenas[size].high_water,
+            arenas[size].allocations, arenas[size].reuses,
+            arenas[size].taken_in);
+  }
+}
+
 grid_t*
 grid_alloc(size_t size) {
   if (size == 0 || !grid_check_size(size)) {
     return NULL;
   }
 
-  grid_t* grid = malloc(sizeof(grid_t));
+  slab_layout_t layout = slab_layout(size);
+  grid_t* grid = slab_get(size, &layout);
   if (grid == NULL) {
     return NULL;
   }
+  slab_bind(grid, &layout);
 
   grid->size = size;
-  grid->cells = malloc(size * sizeof(colors_t*));
-  if (grid->cells == NULL) {
-    return NULL;
-  }
-
-  for (size_t i = 0; i < size; i++) {
-    grid->cells[i] = malloc(size * sizeof(colors_t));
-    if (grid->cells[i] == NULL) {
-      return NULL;
-    }
-  }
+  grid->block_size = kernel_block_sizes[size];
+  grid->kernels = &grid_kernels[size];
+  grid->owner = arenas;
+  grid->cell_width = cell_width(size);
+  grid->level = 0;
+  grid->change_reason = 0;
+  grid->conflict_reason = 0;
+  memset(grid->reasons, 0, 3 * size * sizeof(levels_t));
 
   for (size_t i = 0; i < size; i++) {
     for (size_t j = 0; j < size; j++) {
-      grid->cells[i][j] = colors_full(size);
+      cell_put(grid, i, j, colors_full(size));
     }
   }
+
+  grid_state_rebuild(grid);
   return grid;
 }
 
@@ -84,12 +649,16 @@ grid_free(grid_t* grid) {
     return;
   }
 
-  for (size_t i = 0; i < grid->size; i++) {
-    free(grid->cells[i]);
-  }
+  slab_t* slab = (slab_t*)grid;
+  size_t size = grid->size;
 
-  free(grid->cells);
-  free(grid);
+  if (grid->owner == arenas) {
+    arenas[size].live--;
+  } else {
+    arenas[size].taken_in++;
+  }
+  slab->next = arenas[size].free;
+  arenas[size].free = slab;
 }
 
 void
@@ -127,6 +696,12 @@ grid_check_size(const size_t size) {
     case 64:
       return true;
 
+#ifdef COLORS_WIDE
+    case 81:
+    case 100:
+      return true;
+#endif
+
     default:
       return false;
   }
@@ -138,16 +713,16 @@ grid_copy(const grid_t* grid) {
     return NULL;
   }
 
-  grid_t* new_grid = grid_alloc(grid->size);
+  slab_layout_t layout = slab_layout(grid->size);
+  grid_t* new_grid = slab_get(grid->size, &layout);
   if (!new_grid) {
     return NULL;
   }
 
-  for (size_t i = 0; i < grid->size; i++) {
-    for (size_t j = 0; j < grid->size; j++) {
-      new_grid->cells[i][j] = grid->cells[i][j];
-    }
-  }
+  /* The whole slab at once, then its own arrays */
+  memcpy(new_grid, grid, layout.total);
+  slab_bind(new_grid, &layout);
+  new_grid->owner = arenas;
 
   return new_grid;
 }
@@ -163,10 +738,13 @@ convert_character_to_color(char character, size_t grid_size) {
   return colors_full(grid_size);
 }
 
+/* Longest color token, '{100}' */
+#define COLOR_TOKEN_LENGTH 5
+
 static char*
 convert_color_to_character(colors_t color) {
 
-  char* string_to_return = malloc(colors_count(color) + 1);
+  char* string_to_return = malloc(colors_count(color) * COLOR_TOKEN_LENGTH + 1);
   if (!string_to_return) {
     return NULL;
   }
@@ -174,9 +752,15 @@ convert_color_to_character(colors_t color) {
   size_t index = 0;
 
   for (size_t i = 0; i < MAX_COLORS; i++) {
-    if (colors_is_in(color, i)) {
+    if (!colors_is_in(color, i)) {
+      continue;
+    }
+    if (i < sizeof(color_table) - 1) {
       string_to_return[index] = color_table[i];
       index++;
+    } else {
+      index += sprintf(string_to_return + index, "%c%zu%c", COLOR_TOKEN_OPEN,
+                       i + 1, COLOR_TOKEN_CLOSE);
     }
   }
 
@@ -191,7 +775,7 @@ grid_get_cell(const grid_t* grid, const size_t row, const size_t column) {
     return NULL;
   }
 
-  if (grid->cells[row][column] == colors_full(grid->size)) {
+  if (cell_get(grid, row, column) == colors_full(grid->size)) {
     char* string_to_return = malloc(2);
 
     if (!string_to_return) {
@@ -204,7 +788,7 @@ grid_get_cell(const grid_t* grid, const size_t row, const size_t column) {
     return string_to_return;
   }
 
-  return convert_color_to_character(grid->cells[row][column]);
+  return convert_color_to_character(cell_get(grid, row, column));
 }
 
 size_t
@@ -222,120 +806,824 @@ grid_set_cell(grid_t* grid, const size_t row, const size_t column,
     return;
   }
 
-  grid->cells[row][column] = convert_character_to_color(color, grid->size);
+  grid->change_reason = levels_upto(grid->level);
+  grid_cell_set(grid, row, column,
+                convert_character_to_color(color, grid->size));
+}
+
+colors_t
+grid_get_colors(const grid_t* grid, const size_t row, const size_t column) {
+  if (!grid || row >= grid->size || column >= grid->size) {
+    return colors_empty();
+  }
+  return cell_get(grid, row, column);
+}
+
+void
+grid_set_colors(grid_t* grid, const size_t row, const size_t column,
+                const colors_t colors) {
+  if (!grid || row >= grid->size || column >= grid->size) {
+    return;
+  }
+
+  grid->change_reason = levels_upto(grid->level);
+  grid_cell_set(grid, row, column, colors_and(colors, colors_full(grid->size)));
 }
 
 bool
 grid_is_solved(grid_t* grid) {
-  for (size_t i = 0; i < grid->size; i++) {
-    for (size_t j = 0; j < grid->size; j++) {
-      if (!colors_is_singleton(grid->cells[i][j])) {
-        return false;
-      }
-    }
-  }
-  return true;
+  return grid->unresolved == 0;
 }
 
-static void
-fill_subgrids(grid_t* grid, colors_t* subgrids[grid->size * 3][grid->size]) {
-  size_t size = grid->size;
-  size_t block_size = sqrt(size);
-  int subgrid_count = 0;
+bool
+grid_is_consistent(grid_t* grid) {
+  return grid->conflicts == 0;
+}
 
-  // Check rows
-  for (size_t i = 0; i < size; ++i) {
-    for (size_t j = 0; j < size; j++) {
-      subgrids[subgrid_count][j] = &(grid->cells[i][j]);
-    }
-    subgrid_count++;
+/* Chain-based deductions tier (simple coloring, XY-Wing, XYZ-Wing) */
+
+/* Grids from this size up run the chain tier in chains_auto mode */
+#define CHAINS_AUTO_MIN_SIZE 16
+
+/* Effort budget of one call to the chain tier, in cells visited, expressed
+ * in sweeps of the unit heuristics over the grid (3 * size^3 cells). A search
+ * node costs at least that much, so the tier never costs more than the
+ * backtracking it is supposed to save. */
+#define CHAINS_EFFORT_SWEEPS 2
+
+static _Thread_local chains_mode_t chains_mode = chains_auto;
+
+void
+grid_set_chains(const chains_mode_t mode) {
+  chains_mode = mode;
+}
+
+static bool
+chains_enabled(const size_t size) {
+  switch (chains_mode) {
+    case chains_on:
+      return true;
+    case chains_auto:
+      return size >= CHAINS_AUTO_MIN_SIZE;
+    default:
+      return false;
   }
+}
 
-  // Check cols
-  for (size_t i = 0; i < size; ++i) {
-    for (size_t j = 0; j < size; j++) {
-      subgrids[subgrid_count][j] = &(grid->cells[j][i]);
+static bool
+cells_see(const size_t block_size, const size_t cell1, const size_t cell2,
+          const size_t size) {
+  size_t r1 = cell1 / size, c1 = cell1 % size;
+  size_t r2 = cell2 / size, c2 = cell2 % size;
+
+  return cell1 != cell2
+         && (r1 == r2 || c1 == c2
+             || (r1 / block_size == r2 / block_size
+                 && c1 / block_size == c2 / block_size));
+}
+
+/* Fill peers with the cells sharing a unit with cell, return their count */
+static size_t
+cell_peers(const size_t size, const size_t block_size, const size_t cell,
+           size_t peers[]) {
+  size_t row = cell / size, column = cell % size;
+  size_t start_row = (row / block_size) * block_size;
+  size_t start_col = (column / block_size) * block_size;
+  size_t count = 0;
+
+  for (size_t i = 0; i < size; i++) {
+    if (i != column) {
+      peers[count++] = row * size + i;
+    }
+    if (i != row) {
+      peers[count++] = i * size + column;
     }
-    subgrid_count++;
   }
 
-  // Check blocks
-  for (size_t i = 0; i < size; ++i) {
-    size_t start_row = (i / block_size) * block_size;
-    size_t start_col = (i % block_size) * block_size;
-    size_t k = 0;
-    for (size_t j = start_row; j < start_row + block_size; ++j) {
-      for (size_t l = start_col; l < start_col + block_size; ++l) {
-        subgrids[subgrid_count][k++] = &(grid->cells[j][l]);
+  for (size_t i = start_row; i < start_row + block_size; i++) {
+    for (size_t j = start_col; j < start_col + block_size; j++) {
+      if (i != row && j != column) {
+        peers[count++] = i * size + j;
       }
     }
-    subgrid_count++;
   }
-}
 
-bool
-grid_is_consistent(grid_t* grid) {
-  size_t size = grid->size;
-  colors_t* subgrids[size * 3][size];
+  return count;
+}
 
-  fill_subgrids(grid, subgrids);
+static bool
+chains_eliminate(grid_t* grid, const size_t cell, const colors_t colors) {
+  size_t row = cell / grid->size, column = cell % grid->size;
+  colors_t target = cell_get(grid, row, column);
 
-  for (size_t i = 0; i < size * 3; i++) {
-    if (!subgrid_consistency(subgrids[i], size)) {
-      return false;
-    }
+  if (colors_is_singleton(target)
+      || colors_and(target, colors) == colors_empty()) {
+    return false;
   }
 
+  grid_cell_set(grid, row, column, colors_subtract(target, colors));
   return true;
 }
 
-status_t
-grid_heuristics(grid_t* grid) {
+/* Simple (single-color) coloring: link the cells of each conjugate pair of
+ * 'color' (the only two places of a unit holding it), two-color every chain
+ * and eliminate either a color seeing itself or the cells seeing both. */
+static bool
+simple_coloring(grid_t* grid, const size_t color, const size_t block_size,
+                long* effort) {
   size_t size = grid->size;
-  colors_t* subgrids[size * 3][size];
-  bool grid_changed = true;
+  size_t cells_count = size * size;
+  colors_t mask = colors_set(color);
+  size_t links[cells_count][3];
+  size_t links_count[cells_count];
+  signed char tint[cells_count];
+  size_t component[cells_count];
+  bool result = false;
+
+  for (size_t cell = 0; cell < cells_count; cell++) {
+    links_count[cell] = 0;
+    tint[cell] = -1;
+  }
 
-  fill_subgrids(grid, subgrids);
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    size_t found[2];
+    size_t count = 0;
+    bool placed = false;
+
+    for (size_t i = 0; i < size && !placed; i++) {
+      size_t row, column;
+      if (unit < size) {
+        row = unit;
+        column = i;
+      } else if (unit < 2 * size) {
+        row = i;
+        column = unit - size;
+      } else {
+        row = ((unit - 2 * size) / block_size) * block_size + i / block_size;
+        column =
+            ((unit - 2 * size) % block_size) * block_size + i % block_size;
+      }
 
-  while (grid_changed) {
-    grid_changed = false;
-    for (size_t i = 0; i < size * 3; i++) {
-      if (subgrid_heuristics(subgrids[i], size)) {
-        grid_changed = true;
+      colors_t cell_colors = cell_get(grid, row, column);
+      if (!colors_is_in(cell_colors, color)) {
+        continue;
+      }
+      if (colors_is_singleton(cell_colors)) {
+        placed = true;
+      } else if (count++ < 2) {
+        found[count - 1] = row * size + column;
       }
     }
-  }
+    *effort -= size;
 
-  if (!grid_is_consistent(grid)) {
-    return grid_inconsistent;
+    if (!placed && count == 2) {
+      links[found[0]][links_count[found[0]]++] = found[1];
+      links[found[1]][links_count[found[1]]++] = found[0];
+    }
   }
 
-  if (grid_is_solved(grid)) {
-    return grid_solved;
-  }
+  for (size_t start = 0; start < cells_count && *effort > 0; start++) {
+    if (links_count[start] == 0 || tint[start] != -1) {
+      continue;
+    }
 
-  return grid_unsolved;
-}
+    /* Two-color the chain by a breadth-first traversal */
+    size_t length = 0;
+    tint[start] = 0;
+    component[length++] = start;
+    for (size_t head = 0; head < length; head++) {
+      size_t cell = component[head];
+      for (size_t i = 0; i < links_count[cell]; i++) {
+        size_t next = links[cell][i];
+        if (tint[next] == -1) {
+          tint[next] = !tint[cell];
+          component[length++] = next;
+        }
+      }
+    }
 
-bool
-grid_choice_is_empty(const choice_t choice) {
-  return choice.color == colors_empty();
-}
+    if (length < 3) {
+      continue;
+    }
 
-void
-grid_choice_apply(grid_t* grid, const choice_t choice) {
-  if (grid != NULL && choice.row < grid->size && choice.column < grid->size) {
-    grid->cells[choice.row][choice.column] = choice.color;
-  }
-}
+    /* Color wrap: two cells of the same tint see each other */
+    signed char wrong_tint = -1;
+    for (size_t i = 0; i < length && wrong_tint == -1; i++) {
+      for (size_t j = i + 1; j < length; j++) {
+        if (tint[component[i]] == tint[component[j]]
+            && cells_see(block_size, component[i], component[j], size)) {
+          wrong_tint = tint[component[i]];
+          break;
+        }
+      }
+      *effort -= length;
+    }
 
-void
+    if (wrong_tint != -1) {
+      for (size_t i = 0; i < length; i++) {
+        if (tint[component[i]] == wrong_tint) {
+          result |= chains_eliminate(grid, component[i], mask);
+        }
+      }
+      continue;
+    }
+
+    /* Color trap: an uncolored cell seeing both tints of the chain */
+    for (size_t cell = 0; cell < cells_count && *effort > 0; cell++) {
+      colors_t cell_colors = cell_get(grid, cell / size, cell % size);
+      if (tint[cell] != -1 || colors_is_singleton(cell_colors)
+          || !colors_is_in(cell_colors, color)) {
+        continue;
+      }
+
+      bool sees[2] = {false, false};
+      for (size_t i = 0; i < length && !(sees[0] && sees[1]); i++) {
+        if (cells_see(block_size, cell, component[i], size)) {
+          sees[(size_t)tint[component[i]]] = true;
+        }
+      }
+      *effort -= length;
+
+      if (sees[0] && sees[1]) {
+        result |= chains_eliminate(grid, cell, mask);
+      }
+    }
+  }
+
+  return result;
+}
+
+/* XY-Wing (bivalue pivot) and XYZ-Wing (trivalue pivot): two bivalue pincers
+ * seeing the pivot share a color 'z' which is removed from every cell seeing
+ * both pincers (and the pivot too for the XYZ-Wing). */
+static bool
+xy_wings(grid_t* grid, const size_t block_size, long* effort) {
+  size_t size = grid->size;
+  size_t cells_count = size * size;
+  size_t peers[3 * size];
+  size_t pincers[3 * size];
+  size_t pincer_peers[3 * size];
+  bool result = false;
+
+  for (size_t pivot = 0; pivot < cells_count && *effort > 0; pivot++) {
+    colors_t pivot_colors = cell_get(grid, pivot / size, pivot % size);
+    size_t pivot_count = colors_count(pivot_colors);
+    if (pivot_count != 2 && pivot_count != 3) {
+      continue;
+    }
+
+    size_t peers_count = cell_peers(size, block_size, pivot, peers);
+    size_t pincers_count = 0;
+    for (size_t i = 0; i < peers_count; i++) {
+      colors_t colors = cell_get(grid, peers[i] / size, peers[i] % size);
+      if (colors_count(colors) == 2
+          && colors_count(colors_and(colors, pivot_colors)) == pivot_count - 1
+          && (pivot_count == 2 || colors_is_subset(colors, pivot_colors))) {
+        pincers[pincers_count++] = peers[i];
+      }
+    }
+    *effort -= peers_count;
+
+    for (size_t i = 0; i < pincers_count; i++) {
+      colors_t wing1 = cell_get(grid, pincers[i] / size, pincers[i] % size);
+      for (size_t j = i + 1; j < pincers_count; j++) {
+        colors_t wing2 = cell_get(grid, pincers[j] / size, pincers[j] % size);
+        colors_t z = colors_and(wing1, wing2);
+
+        if (!colors_is_singleton(z) || colors_is_equal(wing1, wing2)) {
+          continue;
+        }
+        if (pivot_count == 2
+            && (colors_and(z, pivot_colors) != colors_empty()
+                || !colors_is_equal(colors_xor(wing1, wing2), pivot_colors))) {
+          continue;
+        }
+        if (pivot_count == 3
+            && !colors_is_equal(colors_or(wing1, wing2), pivot_colors)) {
+          continue;
+        }
+
+        size_t targets =
+            cell_peers(size, block_size, pincers[i], pincer_peers);
+        for (size_t k = 0; k < targets; k++) {
+          size_t cell = pincer_peers[k];
+          if (cell == pivot || cell == pincers[j]
+              || !cells_see(block_size, cell, pincers[j], size)
+              || (pivot_count == 3
+                  && !cells_see(block_size, cell, pivot, size))) {
+            continue;
+          }
+          result |= chains_eliminate(grid, cell, z);
+        }
+        *effort -= targets;
+      }
+    }
+  }
+
+  return result;
+}
+
+static bool
+grid_chain_heuristics(grid_t* grid) {
+  size_t size = grid->size;
+  size_t block_size = kernel_block_sizes[size];
+  long effort = (long)(CHAINS_EFFORT_SWEEPS * 3 * size * size * size);
+  bool result = false;
+
+  /* Chains span many units, their deductions depend on every decision */
+  grid->change_reason = levels_upto(grid->level);
+
+  for (size_t color = 0; color < size && effort > 0 && !result; color++) {
+    result = simple_coloring(grid, color, block_size, &effort);
+  }
+
+  if (!result && effort > 0) {
+    result = xy_wings(grid, block_size, &effort);
+  }
+
+  return result;
+}
+
+/* Color bitboards tier: hidden singles, intersections (pointing and
+ * claiming) and fish (X-Wing, Swordfish) on the color-major view of the grid,
+ * where the places of a color in a row or a column are a single word. */
+
+/* Grids from this size up run the bitboards tier in bitboards_auto mode: it
+ * costs about a third more time on 9x9 searches, but turns the hard 25x25
+ * grids from seconds (or timeouts) into a few hundred milliseconds. */
+#define BITBOARDS_AUTO_MIN_SIZE 25
+
+/* Largest fish looked for: 2 for X-Wings, 3 for Swordfish */
+#define FISH_MAX_SIZE 3
+
+static _Thread_local bitboards_mode_t bitboards_mode = bitboards_auto;
+
+void
+grid_set_bitboards(const bitboards_mode_t mode) {
+  bitboards_mode = mode;
+}
+
+static bool
+bitboards_enabled(const size_t size) {
+  switch (bitboards_mode) {
+    case bitboards_on:
+      return true;
+    case bitboards_auto:
+      return size >= BITBOARDS_AUTO_MIN_SIZE;
+    default:
+      return false;
+  }
+}
+
+/* Index of the lowest bit of a non-empty word */
+static size_t
+bit_first(const colors_t bits) {
+  return colors_count(colors_rightmost(bits) - 1);
+}
+
+/* Places of a color in a block, block_size bits per block row */
+static colors_t
+block_places(const grid_t* grid, const colors_t* rows, const size_t block) {
+  size_t block_size = grid->block_size;
+  size_t start_row = (block / block_size) * block_size;
+  size_t start_column = (block % block_size) * block_size;
+  colors_t places = colors_empty();
+
+  for (size_t i = 0; i < block_size; i++) {
+    places |= ((rows[start_row + i] >> start_column) & colors_full(block_size))
+              << (i * block_size);
+  }
+  return places;
+}
+
+/* Remove a color from the cells of a line (a row, or a column when 'columns'
+ * is set) given by the bits of 'places'. */
+static bool
+bitboard_eliminate(grid_t* grid, const size_t color, const size_t line,
+                   const bool columns, colors_t places) {
+  bool result = false;
+
+  for (; places != colors_empty();
+       places = colors_subtract(places, colors_rightmost(places))) {
+    size_t other = bit_first(places);
+    size_t cell =
+        columns ? other * grid->size + line : line * grid->size + other;
+    result |= chains_eliminate(grid, cell, colors_set(color));
+  }
+  return result;
+}
+
+static bool
+bitboard_place(grid_t* grid, const size_t color, const size_t row,
+               const size_t column) {
+  if (colors_is_singleton(cell_get(grid, row, column))) {
+    return false;
+  }
+  grid_cell_set(grid, row, column, colors_set(color));
+  return true;
+}
+
+/* Find fish of a color over base lines (rows, or columns when 'columns' is
+ * set): 'depth' lines whose places span 'depth' cover lines, the color is then
+ * removed from the other lines in the cover lines. */
+static bool
+fish_search(grid_t* grid, const size_t color, const bool columns,
+            const size_t* bases, const size_t bases_count, const size_t start,
+            const size_t depth, const colors_t chosen, const colors_t cover) {
+  size_t size = grid->size;
+  const colors_t* cross = columns ? &grid->color_rows[color * size]
+                                  : &grid->color_columns[color * size];
+  const colors_t* lines = columns ? &grid->color_columns[color * size]
+                                  : &grid->color_rows[color * size];
+  bool result = false;
+
+  size_t chosen_count = colors_count(chosen);
+
+  if (chosen_count >= 2 && colors_count(cover) == chosen_count) {
+    for (colors_t left = cover; left != colors_empty();
+         left = colors_subtract(left, colors_rightmost(left))) {
+      size_t line = bit_first(left);
+      result |= bitboard_eliminate(grid, color, line, !columns,
+                                   colors_subtract(cross[line], chosen));
+    }
+    return result;
+  }
+
+  if (chosen_count == depth) {
+    return false;
+  }
+
+  for (size_t i = start; i < bases_count && !result; i++) {
+    colors_t next = colors_or(cover, lines[bases[i]]);
+    if (colors_count(next) <= depth) {
+      result = fish_search(grid, color, columns, bases, bases_count, i + 1,
+                           depth, colors_add(chosen, bases[i]), next);
+    }
+  }
+  return result;
+}
+
+static subgrid_status_t
+grid_bitboard_heuristics(grid_t* grid) {
+  size_t size = grid->size;
+  size_t block_size = grid->block_size;
+  bool result = false;
+
+  /* These deductions span several units, like the chains */
+  grid->change_reason = levels_upto(grid->level);
+
+  for (size_t color = 0; color < size; color++) {
+    const colors_t* rows = &grid->color_rows[color * size];
+    const colors_t* columns = &grid->color_columns[color * size];
+
+    /* A unit left without the color, or with a single place for it: the
+     * removals of the color from a unit are put down to its reasons */
+    for (size_t i = 0; i < size; i++) {
+      colors_t places = block_places(grid, rows, i);
+      if (rows[i] == colors_empty() || columns[i] == colors_empty()
+          || places == colors_empty()) {
+        grid->conflict_reason |=
+            rows[i] == colors_empty()      ? grid->reasons[i]
+            : columns[i] == colors_empty() ? grid->reasons[size + i]
+                                           : grid->reasons[2 * size + i];
+        return subgrid_inconsistent;
+      }
+      if (colors_is_singleton(rows[i])) {
+        result |= bitboard_place(grid, color, i, bit_first(rows[i]));
+      }
+      if (colors_is_singleton(columns[i])) {
+        result |= bitboard_place(grid, color, bit_first(columns[i]), i);
+      }
+      if (colors_is_singleton(places)) {
+        size_t place = bit_first(places);
+        result |= bitboard_place(
+            grid, color, (i / block_size) * block_size + place / block_size,
+            (i % block_size) * block_size + place % block_size);
+      }
+    }
+
+    /* Pointing: the color only fits in one row (column) of a block */
+    for (size_t block = 0; block < size; block++) {
+      size_t start_row = (block / block_size) * block_size;
+      size_t start_column = (block % block_size) * block_size;
+      colors_t band = colors_full(block_size) << start_column;
+      colors_t stack = colors_full(block_size) << start_row;
+      colors_t hit_rows = colors_empty();
+      colors_t hit_columns = colors_empty();
+
+      for (size_t i = 0; i < block_size; i++) {
+        if (colors_and(rows[start_row + i], band) != colors_empty()) {
+          hit_rows = colors_add(hit_rows, i);
+        }
+        if (colors_and(columns[start_column + i], stack) != colors_empty()) {
+          hit_columns = colors_add(hit_columns, i);
+        }
+      }
+      if (colors_is_singleton(hit_rows)) {
+        size_t row = start_row + bit_first(hit_rows);
+        result |= bitboard_eliminate(grid, color, row, false,
+                                     colors_subtract(rows[row], band));
+      }
+      if (colors_is_singleton(hit_columns)) {
+        size_t column = start_column + bit_first(hit_columns);
+        result |= bitboard_eliminate(grid, color, column, true,
+                                     colors_subtract(columns[column], stack));
+      }
+    }
+
+    /* Claiming: the places of the color in a row (column) lie in one block */
+    for (size_t line = 0; line < size; line++) {
+      size_t start = line - line % block_size;
+      for (size_t pass = 0; pass < 2; pass++) {
+        const colors_t* lines = pass ? columns : rows;
+        if (lines[line] == colors_empty()
+            || colors_is_singleton(lines[line])) {
+          continue;
+        }
+        size_t offset = (bit_first(lines[line]) / block_size) * block_size;
+        colors_t segment = colors_full(block_size) << offset;
+        if (colors_subtract(lines[line], segment) != colors_empty()) {
+          continue;
+        }
+        for (size_t other = start; other < start + block_size; other++) {
+          if (other != line) {
+            result |= bitboard_eliminate(grid, color, other, pass,
+                                         colors_and(lines[other], segment));
+          }
+        }
+      }
+    }
+
+    /* Fish, based on rows then on columns */
+    for (size_t pass = 0; pass < 2; pass++) {
+      const colors_t* lines = pass ? columns : rows;
+      size_t bases[size];
+      size_t bases_count = 0;
+
+      for (size_t line = 0; line < size; line++) {
+        size_t count = colors_count(lines[line]);
+        if (count >= 2 && count <= FISH_MAX_SIZE) {
+          bases[bases_count++] = line;
+        }
+      }
+      for (size_t depth = 2; depth <= FISH_MAX_SIZE; depth++) {
+        result |= fish_search(grid, color, pass, bases, bases_count, 0, depth,
+                              colors_empty(), colors_empty());
+      }
+    }
+
+    if (!grid_is_consistent(grid)) {
+      grid->conflict_reason |= grid->change_reason;
+      return subgrid_inconsistent;
+    }
+  }
+
+  return result ? subgrid_changed : subgrid_unchanged;
+}
+
+/* Régin's all-different filtering tier */
+
+static _Thread_local bool alldiff_enabled = false;
+
+/* Last matching found in each unit, the starting point of the next one: it
+ * only holds for the grid it came from, alldiff_filter() keeps what is still
+ * valid in the grid at hand. */
+static _Thread_local int8_t unit_matchings[3 * MAX_GRID_SIZE][MAX_GRID_SIZE];
+
+void
+grid_set_alldiff(const bool enabled) {
+  alldiff_enabled = enabled;
+}
+
+/* Instances of the grid kernels, one per supported size */
+#define KERNEL_SIZE   1
+#define KERNEL_SUFFIX 1
+#define KERNEL_CELL   uint8_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   4
+#define KERNEL_SUFFIX 4
+#define KERNEL_CELL   uint8_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   9
+#define KERNEL_SUFFIX 9
+#define KERNEL_CELL   uint16_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   16
+#define KERNEL_SUFFIX 16
+#define KERNEL_CELL   uint16_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   25
+#define KERNEL_SUFFIX 25
+#define KERNEL_CELL   uint32_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   36
+#define KERNEL_SUFFIX 36
+#define KERNEL_CELL   uint64_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   49
+#define KERNEL_SUFFIX 49
+#define KERNEL_CELL   uint64_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   64
+#define KERNEL_SUFFIX 64
+#define KERNEL_CELL   uint64_t
+#include "grid_kernels.h"
+#ifdef COLORS_WIDE
+#define KERNEL_SIZE   81
+#define KERNEL_SUFFIX 81
+#define KERNEL_CELL   colors_t
+#include "grid_kernels.h"
+#define KERNEL_SIZE   100
+#define KERNEL_SUFFIX 100
+#define KERNEL_CELL   colors_t
+#include "grid_kernels.h"
+#endif
+
+#define GRID_KERNELS(suffix)                                                   \
+  { unit_heuristics_##suffix, unit_compute_##suffix, unit_apply_##suffix }
+
+static const grid_kernels_t grid_kernels[MAX_GRID_SIZE + 1] = {
+    [1] = GRID_KERNELS(1),   [4] = GRID_KERNELS(4),   [9] = GRID_KERNELS(9),
+    [16] = GRID_KERNELS(16), [25] = GRID_KERNELS(25), [36] = GRID_KERNELS(36),
+    [49] = GRID_KERNELS(49), [64] = GRID_KERNELS(64),
+#ifdef COLORS_WIDE
+    [81] = GRID_KERNELS(81), [100] = GRID_KERNELS(100),
+#endif
+};
+
+/* Parallel phases of the unit sweeps */
+
+/* Smallest grid size swept in phases */
+#define PHASES_MIN_SIZE 49
+
+static _Thread_local pool_t* unit_pool = NULL;
+
+/* Cells computed by the units of a phase, one unit after the other, allocated
+ * with the pool */
+static _Thread_local colors_t* phase_values = NULL;
+
+/* Units of one kind, computed side by side */
+typedef struct {
+  const grid_t* grid;
+  const size_t* units;
+  size_t first; /* Index of the first unit of the kind */
+  unit_tier_t tier;
+  colors_t* values; /* Of the pool thread, seen by its workers */
+  subgrid_pipeline_t pipeline; /* Pinned by the pool thread */
+  subgrid_status_t statuses[MAX_GRID_SIZE];
+} unit_phase_t;
+
+bool
+grid_set_threads(const size_t threads) {
+  pool_free(unit_pool);
+  free(phase_values);
+  unit_pool = NULL;
+  phase_values = NULL;
+  if (threads > 1) {
+    phase_values = malloc(MAX_GRID_SIZE * MAX_GRID_SIZE * sizeof(colors_t));
+    unit_pool = phase_values ? pool_alloc(threads) : NULL;
+  }
+  return threads <= 1 || unit_pool != NULL;
+}
+
+static void
+unit_phase_task(void* context, const size_t index) {
+  unit_phase_t* phase = context;
+  const grid_t* grid = phase->grid;
+
+  /* The workers run the pipeline of the pool thread, not their own */
+  subgrid_pipeline_pin(&phase->pipeline);
+  phase->statuses[index] = grid->kernels->unit_compute(
+      grid, phase->units, phase->first + index, phase->tier,
+      &phase->values[index * grid->size]);
+}
+
+/* One sweep of a tier over all the units, in phases on the pool for the large
+ * grids. Units of the same kind share no cell: computing them all from the
+ * grid as it was at the start of their phase, then applying them in order,
+ * gives what the single sweep gives. */
+static subgrid_status_t
+grid_units_sweep(grid_t* grid, const size_t* units, const unit_tier_t tier) {
+  size_t size = grid->size;
+  bool changed = false;
+
+  if (unit_pool == NULL || size < PHASES_MIN_SIZE) {
+    for (size_t i = 0; i < size * 3; i++) {
+      subgrid_status_t status =
+          grid->kernels->unit_heuristics(grid, units, i, tier);
+      if (status == subgrid_inconsistent) {
+        unit_weights[i]++;
+        return subgrid_inconsistent;
+      }
+      changed |= status == subgrid_changed;
+    }
+    return changed ? subgrid_changed : subgrid_unchanged;
+  }
+
+  for (size_t kind = 0; kind < 3; kind++) {
+    unit_phase_t phase = {grid, units, kind * size, tier, phase_values,
+                          subgrid_pipeline_get(), {0}};
+
+    pool_run(unit_pool, unit_phase_task, &phase, size);
+    for (size_t i = 0; i < size; i++) {
+      subgrid_status_t status = grid->kernels->unit_apply(
+          grid, units, phase.first + i, phase.statuses[i],
+          &phase_values[i * size]);
+      if (status == subgrid_inconsistent) {
+        unit_weights[phase.first + i]++;
+        return subgrid_inconsistent;
+      }
+      changed |= status == subgrid_changed;
+    }
+  }
+  return changed ? subgrid_changed : subgrid_unchanged;
+}
+
+status_t
+grid_heuristics(grid_t* grid) {
+  size_t size = grid->size;
+  const size_t* units = grid_units(size);
+  bool grid_changed = true;
+
+  if (units == NULL) {
+    grid->conflict_reason |= levels_upto(grid->level);
+    return grid_inconsistent;
+  }
+
+  /* The reasons of the contradictions the grid came with were recorded as
+   * they showed up, but the caller may have cleared them since */
+  if (!grid_is_consistent(grid)) {
+    grid_state_rebuild(grid);
+    return grid_inconsistent;
+  }
+
+  while (grid_changed) {
+    grid_changed = false;
+
+    /* Each tier only runs once the cheaper ones are stuck */
+    for (unit_tier_t tier = tier_pipeline;
+         tier <= tier_alldiff && !grid_changed; tier++) {
+      if (tier == tier_alldiff && !alldiff_enabled) {
+        break;
+      }
+      subgrid_status_t status = grid_units_sweep(grid, units, tier);
+      if (status == subgrid_inconsistent) {
+        return grid_inconsistent;
+      }
+      grid_changed = status == subgrid_changed;
+    }
+
+    if (!grid_changed && bitboards_enabled(size) && !grid_is_solved(grid)) {
+      subgrid_status_t status = grid_bitboard_heuristics(grid);
+      if (status == subgrid_inconsistent) {
+        return grid_inconsistent;
+      }
+      grid_changed = status == subgrid_changed;
+    }
+
+    /* The chain tier only runs once the unit tiers are stuck */
+    if (!grid_changed && chains_enabled(size) && !grid_is_solved(grid)) {
+      grid_changed = grid_chain_heuristics(grid);
+      if (!grid_is_consistent(grid)) {
+        grid->conflict_reason |= grid->change_reason;
+        return grid_inconsistent;
+      }
+    }
+  }
+
+  if (grid_is_solved(grid)) {
+    return grid_solved;
+  }
+
+  return grid_unsolved;
+}
+
+bool
+grid_choice_is_empty(const choice_t choice) {
+  return choice.color == colors_empty();
+}
+
+void
+grid_choice_apply(grid_t* grid, const choice_t choice) {
+  if (grid != NULL && choice.row < grid->size && choice.column < grid->size) {
+    grid->change_reason = level_bit(grid->level);
+    grid_cell_set(grid, choice.row, choice.column, choice.color);
+  }
+}
+
+static void
+grid_choice_discard_because(grid_t* grid, const choice_t choice,
+                            const levels_t reason) {
+  grid->change_reason = reason;
+  grid_cell_set(
+      grid, choice.row, choice.column,
+      colors_subtract(cell_get(grid, choice.row, choice.column), choice.color));
+}
+
+void
 grid_choice_discard(grid_t* grid, const choice_t choice) {
   if (grid != NULL && choice.row < grid->size && choice.column < grid->size) {
-    grid->cells[choice.row][choice.column] =
-        colors_subtract(grid->cells[choice.row][choice.column], choice.color);
-  } else {
-    return;
+    grid_choice_discard_because(grid, choice, levels_upto(grid->level));
   }
 }
 
@@ -350,93 +1638,571 @@ grid_choice_print(const choice_t choice, FILE* fd) {
   free(color);
 }
 
+/* Number of unresolved cells sharing a unit with cell (cells sharing two
+ * units with it are counted twice) */
+static size_t
+cell_degree(const grid_t* grid, const size_t cell) {
+  size_t size = grid->size;
+  size_t row = cell / size, column = cell % size;
+
+  return grid->unit_unresolved[row] + grid->unit_unresolved[size + column]
+         + grid->unit_unresolved[2 * size
+                                 + (row / grid->block_size) * grid->block_size
+                                 + column / grid->block_size]
+         - 3;
+}
+
+static size_t
+cell_weight(const grid_t* grid, const size_t cell) {
+  size_t size = grid->size;
+  size_t row = cell / size, column = cell % size;
+
+  return unit_weights[row] + unit_weights[size + column]
+         + unit_weights[2 * size + (row / grid->block_size) * grid->block_size
+                        + column / grid->block_size];
+}
+
+/* Score of a cell to branch on, lower is better */
+static double
+cell_score(const grid_t* grid, const size_t cell, const size_t count) {
+  switch (branching.cell) {
+    case branch_degree:
+      return -(double)cell_degree(grid, cell);
+    case branch_wdeg:
+      return (double)count / (double)cell_weight(grid, cell);
+    default:
+      return 0.0;
+  }
+}
+
+static size_t
+choose_cell(const grid_t* grid) {
+  /* The lowest non-empty bucket holds the cells with the fewest colors */
+  size_t count = colors_count(colors_rightmost(grid->buckets) - 1) + 1;
+  size_t best_cell = grid->bucket_head[count];
+  size_t last_count = count;
+  size_t scan_limit = TIES_SCAN_LIMIT;
+  double best_score = cell_score(grid, best_cell, count);
+  size_t ties = 1;
+
+  if (branching.cell == branch_mrv && !branching.random_ties) {
+    return best_cell;
+  }
+
+  /* dom/wdeg may prefer a cell with more colors: look at all of them */
+  if (branching.cell == branch_wdeg) {
+    last_count = grid->size;
+    scan_limit = SIZE_MAX;
+  }
+
+  for (; count <= last_count; count++) {
+    size_t scanned = 0;
+    for (uint16_t cell = grid->bucket_head[count];
+         cell != NO_CELL && scanned < scan_limit;
+         cell = grid->bucket_next[cell], scanned++) {
+      if (score_is_better(cell_score(grid, cell, count), best_score, &ties)) {
+        best_score = cell_score(grid, cell, count);
+        best_cell = cell;
+      }
+    }
+  }
+
+  return best_cell;
+}
+
+/* Least constraining value: the color of the cell found in the fewest
+ * unresolved peers */
+static colors_t
+choose_lcv_color(const grid_t* grid, const size_t cell) {
+  size_t size = grid->size;
+  colors_t colors = cell_get(grid, cell / size, cell % size);
+  size_t peers[3 * size];
+  size_t peers_count = cell_peers(size, grid->block_size, cell, peers);
+  colors_t best_color = colors_empty();
+  double best_score = HUGE_VAL;
+  size_t ties = 1;
+
+  for (colors_t left = colors; left != colors_empty();
+       left = colors_subtract(left, colors_rightmost(left))) {
+    colors_t color = colors_rightmost(left);
+    size_t constrained = 0;
+
+    for (size_t i = 0; i < peers_count; i++) {
+      colors_t peer = cell_get(grid, peers[i] / size, peers[i] % size);
+      constrained += !colors_is_singleton(peer)
+                     && colors_and(peer, color) != colors_empty();
+    }
+
+    if (score_is_better((double)constrained, best_score, &ties)) {
+      best_score = (double)constrained;
+      best_color = color;
+    }
+  }
+
+  return best_color;
+}
+
 choice_t
 grid_choice(grid_t* grid) {
-  if (grid == NULL) {
+  if (grid == NULL || grid->buckets == colors_empty()) {
     return (choice_t){0, 0, colors_empty()};
   }
 
-  size_t min_colors_count = MAX_COLORS + 1;
-  choice_t choice = {0, 0, colors_empty()};
+  size_t cell = choose_cell(grid);
+  choice_t choice = {cell / grid->size, cell % grid->size,
+                     cell_get(grid, cell / grid->size, cell % grid->size)};
 
-  for (size_t row = 0; row < grid->size; ++row) {
-    for (size_t column = 0; column < grid->size; ++column) {
-      colors_t cell_colors = grid->cells[row][column];
+  choice.color = branching.lcv ? choose_lcv_color(grid, cell)
+                               : colors_rightmost(choice.color);
 
-      if (!colors_is_singleton(cell_colors)) {
-        size_t current_count = colors_count(cell_colors);
+  return choice;
+}
 
-        if (current_count > 0 && current_count < min_colors_count) {
-          min_colors_count = current_count;
-          choice.row = row;
-          choice.column = column;
-          choice.color = cell_colors;
-        }
+/* Randomized restarts of mode_first searches */
+
+/* Default cutoff unit of the restarts, in search nodes */
+#define RESTARTS_DEFAULT_BASE 128
+
+/* Largest cutoff unit of the restarts, far from where the cutoffs wrap */
+#define RESTARTS_MAX_BASE 1000000000
+
+/* Growth of the cutoff between two geometric restarts */
+#define RESTARTS_GEOMETRIC_FACTOR 1.5
+
+static _Thread_local struct {
+  restarts_t policy;
+  size_t base;
+  bool reset_weights;
+} restarts = {restarts_none, RESTARTS_DEFAULT_BASE, false};
+
+/* Nodes of the current search, and the cutoff at which it gives up */
+static _Thread_local size_t search_nodes;
+static _Thread_local size_t search_limit = SIZE_MAX;
+static _Thread_local bool search_aborted;
+
+bool
+grid_set_restarts(const char* spec) {
+  restarts_t policy = restarts_luby;
+  size_t base = RESTARTS_DEFAULT_BASE;
+  bool reset_weights = false;
+  const char* name = spec;
+
+  while (name != NULL && *name != '\0') {
+    size_t length = strcspn(name, ",");
+    char* end;
+
+    if (length == 4 && !strncmp(name, "none", length)) {
+      policy = restarts_none;
+    } else if (length == 4 && !strncmp(name, "luby", length)) {
+      policy = restarts_luby;
+    } else if (length == 9 && !strncmp(name, "geometric", length)) {
+      policy = restarts_geometric;
+    } else if (length == 5 && !strncmp(name, "reset", length)) {
+      reset_weights = true;
+    } else if (!isdigit((unsigned char)*name)) {
+      return false;
+    } else {
+      errno = 0;
+      base = strtoul(name, &end, 10);
+      if (base == 0 || base > RESTARTS_MAX_BASE || errno == ERANGE
+          || end != name + length) {
+        return false;
       }
     }
+
+    name += length;
+    if (*name == ',') {
+      name++;
+    }
   }
 
-  if (!grid_choice_is_empty(choice)) {
-    choice.color = colors_rightmost(choice.color);
+  restarts.policy = policy;
+  restarts.base = base;
+  restarts.reset_weights = reset_weights;
+  return true;
+}
+
+/* Luby sequence (1, 1, 2, 1, 1, 2, 4, 1, 1, 2, ...), from index 1 */
+static size_t
+luby(size_t index) {
+  size_t power = 1;
+
+  while (true) {
+    while (2 * power - 1 < index) {
+      power *= 2;
+    }
+    if (2 * power - 1 == index) {
+      return power;
+    }
+    index -= power - 1;
+    power = 1;
   }
+}
 
-  return choice;
+static void
+reset_unit_weights(void) {
+  for (size_t unit = 0; unit < 3 * MAX_GRID_SIZE; unit++) {
+    unit_weights[unit] = 1;
+  }
 }
 
-grid_t*
-grid_solver_internal(grid_t* grid, _mode_t mode, int* solution_count) {
+/* Where the solutions of mode_all go, per thread (stdout when NULL) */
+static _Thread_local grid_sink_t solution_sink = NULL;
+static _Thread_local void* solution_data = NULL;
+
+void
+grid_set_sink(grid_sink_t sink, void* data) {
+  solution_sink = sink;
+  solution_data = data;
+}
+
+/* Solutions reported by the current search, and how many it may report */
+static _Thread_local size_t solution_reports = 0;
+static _Thread_local size_t solution_limit = SIZE_MAX;
+
+/* Memory ran out during the current search: it missed part of its space */
+static _Thread_local bool search_failed = false;
+
+void
+grid_set_solution_limit(const size_t limit) {
+  solution_limit = limit;
+}
+
+void
+grid_report_failure(void) {
+  search_failed = true;
+}
+
+bool
+grid_report_solution(const grid_t* solution) {
+  if (solution == NULL) {
+    grid_report_failure();
+    return false;
+  }
+  if (solution_sink != NULL) {
+    solution_sink(solution, solution_data);
+  } else {
+    grid_print(solution, stdout);
+    printf("\n");
+  }
+  return ++solution_reports < solution_limit;
+}
+
+/* Path of the current dfs search, kept while a monitor watches it */
+static _Thread_local struct {
+  grid_monitor_t monitor;
+  void* data;
+  size_t period;
+  grid_step_t* steps;
+  size_t length;
+  size_t capacity;
+} search_path = {NULL, NULL, 1, NULL, 0, 0};
+
+/* Path the next dfs search starts from, and the solutions reported before */
+static _Thread_local struct {
+  grid_step_t* steps;
+  size_t length;
+  size_t next;
+  size_t solutions;
+} replay;
+
+void
+grid_set_monitor(grid_monitor_t monitor, void* data, const size_t period) {
+  search_path.monitor = monitor;
+  search_path.data = data;
+  search_path.period = period ? period : 1;
+  if (monitor == NULL) {
+    free(search_path.steps);
+    search_path.steps = NULL;
+    search_path.capacity = 0;
+  }
+}
+
+bool
+grid_set_replay(const grid_step_t* path, const size_t length,
+                const size_t solutions) {
+  grid_step_t* steps = malloc((length ? length : 1) * sizeof(grid_step_t));
+  if (steps == NULL) {
+    return false;
+  }
+
+  if (length > 0) {
+    memcpy(steps, path, length * sizeof(grid_step_t));
+  }
+  free(replay.steps);
+  replay.steps = steps;
+  replay.length = length;
+  replay.next = 0;
+  replay.solutions = solutions;
+  return true;
+}
+
+static void
+replay_clear(void) {
+  free(replay.steps);
+  replay.steps = NULL;
+  replay.length = 0;
+  replay.next = 0;
+  replay.solutions = 0;
+}
+
+static bool
+path_push(const choice_t choice, const bool discarded,
+          const size_t candidates) {
+  if (search_path.length == search_path.capacity) {
+    size_t capacity = search_path.capacity ? 2 * search_path.capacity : 256;
+    grid_step_t* steps =
+        realloc(search_path.steps, capacity * sizeof(grid_step_t));
+
+    if (steps == NULL) {
+      return false;
+    }
+    search_path.steps = steps;
+    search_path.capacity = capacity;
+  }
+  search_path.steps[search_path.length++] =
+      (grid_step_t){choice, discarded, candidates};
+  return true;
+}
+
+/* Depth-first search, 'conflict' receives the decision levels a failure
+ * depends on (all of them when the subtree held solutions or was cut off).
+ * Along the path of a replay, the choices come from the path, and a node
+ * solved before the end of the path is only reported at its end. */
+static grid_t*
+grid_solver_internal(grid_t* grid, _mode_t mode, size_t* solution_count,
+                     levels_t* conflict) {
   if (grid == NULL) {
     return NULL;
   }
 
+  *conflict = levels_upto(grid->level);
+
+  if (++search_nodes > search_limit) {
+    search_aborted = true;
+    return NULL;
+  }
+
+  bool replaying = replay.next < replay.length;
+
+  if (search_path.monitor != NULL && !replaying
+      && search_nodes % search_path.period == 0
+      && !search_path.monitor(search_path.steps, search_path.length,
+                              *solution_count, search_path.data)) {
+    search_aborted = true;
+    return NULL;
+  }
+
+  grid->conflict_reason = 0;
   status_t status = grid_heuristics(grid);
-  if (status == grid_solved) {
+  if (status == grid_solved && !replaying) {
     if (mode == mode_all) {
-      grid_print(grid, stdout);
-      printf("\n");
+      search_aborted = !grid_report_solution(grid);
       (*solution_count)++;
     }
     return (mode == mode_first) ? grid : NULL;
   } else if (status == grid_inconsistent) {
+    *conflict = grid->conflict_reason;
+    replay.next = replay.length;
     return NULL;
   }
 
-  choice_t choice = grid_choice(grid);
-  if (grid_choice_is_empty(choice)) {
+  choice_t choice;
+  bool discarded = false;
+  size_t candidates = 0;
+  /* A discard the replay takes is put down to every decision */
+  levels_t left_conflict = levels_upto(grid->level + 1);
+
+  if (replaying) {
+    const grid_step_t* step = &replay.steps[replay.next++];
+
+    choice = step->choice;
+    discarded = step->discarded;
+    candidates = step->candidates;
+  } else {
+    choice = grid_choice(grid);
+    if (grid_choice_is_empty(choice)) {
+      return NULL;
+    }
+    if (search_path.monitor != NULL) {
+      candidates = colors_count(cell_get(grid, choice.row, choice.column));
+    }
+  }
+
+  if (!discarded) {
+    grid_t* copy = grid_copy(grid);
+    if (copy == NULL) {
+      grid_report_failure();
+      return NULL;
+    }
+
+    copy->level = grid->level + 1;
+    if (replaying) {
+      /* The cell may be solved already, with another color */
+      choice_t step = choice;
+      step.color = colors_and(cell_get(copy, choice.row, choice.column),
+                              choice.color);
+      grid_choice_apply(copy, step);
+    } else {
+      grid_choice_apply(copy, choice);
+    }
+
+    grid_t* result = NULL;
+    if (search_path.monitor == NULL) {
+      result = grid_solver_internal(copy, mode, solution_count, &left_conflict);
+    } else if (path_push(choice, false, candidates)) {
+      result = grid_solver_internal(copy, mode, solution_count, &left_conflict);
+      search_path.length--;
+    } else {
+      search_aborted = true;
+    }
+    if (result != NULL) {
+      if (result != copy) {
+        grid_free(copy);
+      }
+      return result;
+    }
+    grid_free(copy);
+
+    if (search_aborted) {
+      return NULL;
+    }
+  }
+
+  /* The failure of the choice does not depend on the choice itself: it holds
+   * here too, jump back to the deepest decision it depends on. */
+  levels_t decision = level_bit(grid->level + 1);
+  if (backjumping && (left_conflict & decision) == 0) {
+    *conflict = left_conflict;
     return NULL;
   }
 
-  grid_t* copy = grid_copy(grid);
-  if (copy == NULL) {
+  if (grid->level + 1 < 63) {
+    left_conflict &= ~decision;
+  }
+  grid_choice_discard_because(grid, choice, left_conflict);
+
+  if (search_path.monitor == NULL) {
+    return grid_solver_internal(grid, mode, solution_count, conflict);
+  }
+  if (!path_push(choice, true, candidates)) {
+    search_aborted = true;
     return NULL;
   }
 
-  grid_choice_apply(copy, choice);
+  grid_t* result = grid_solver_internal(grid, mode, solution_count, conflict);
+  search_path.length--;
+  return result;
+}
 
-  grid_t* result = grid_solver_internal(copy, mode, solution_count);
-  if (result != NULL && grid_is_solved(result)) {
-    if (mode == mode_all) {
+/* Run randomized searches under growing node cutoffs until one of them
+ * either finds a solution or completes (proving there is none). */
+static grid_t*
+grid_solver_restarts(grid_t* grid, size_t* solution_count) {
+  bool random_ties = branching.random_ties;
+  grid_t* result = NULL;
+  double geometric = 1.0;
+
+  branching.random_ties = true;
+
+  for (size_t run = 1; result == NULL; run++) {
+    grid_t* copy = grid_copy(grid);
+    if (copy == NULL) {
+      grid_report_failure();
+      break;
+    }
+
+    /* The cutoffs stop growing once they reach SIZE_MAX */
+    if (restarts.policy == restarts_luby) {
+      size_t factor = luby(run);
+      search_limit = factor > SIZE_MAX / restarts.base
+                         ? SIZE_MAX
+                         : restarts.base * factor;
+    } else {
+      double cutoff = restarts.base * geometric;
+      search_limit = cutoff < (double)SIZE_MAX ? (size_t)cutoff : SIZE_MAX;
+      geometric *= RESTARTS_GEOMETRIC_FACTOR;
+    }
+    search_nodes = 0;
+    search_aborted = false;
+
+    levels_t conflict;
+    result = grid_solver_internal(copy, mode_first, solution_count, &conflict);
+    if (result != copy) {
       grid_free(copy);
-      return grid_solver_internal(grid, mode, solution_count);
     }
-    grid_free(grid);
-    return result;
+
+    if (result == NULL && !search_aborted) {
+      break;
+    }
+
+    if (restarts.reset_weights) {
+      reset_unit_weights();
+    }
   }
 
-  grid_choice_discard(grid, choice);
-  grid_free(copy);
+  branching.random_ties = random_ties;
+  search_limit = SIZE_MAX;
+  return result;
+}
 
-  return grid_solver_internal(grid, mode, solution_count);
+bool
+grid_solver_completed(void) {
+  return !search_failed && !search_aborted
+         && solution_reports < solution_limit;
 }
 
 grid_t*
 grid_solver(grid_t* grid, _mode_t mode) {
-  int solution_count = 0;
-  grid_t* result = grid_solver_internal(grid, mode, &solution_count);
+  size_t solution_count = 0;
+  grid_t* result;
+
+  reset_unit_weights();
+  search_nodes = 0;
+  search_aborted = false;
+  search_failed = false;
+  solution_reports = 0;
+
+  engine_t selected = engine;
+  if (selected == engine_auto) {
+    if (band_accepts(grid)) {
+      selected = engine_band;
+    } else if (grid->size <= ENGINE_AUTO_LEAN_MAX_SIZE) {
+      selected = engine_lean;
+    } else if (grid->size <= ENGINE_AUTO_DLX_MAX_SIZE) {
+      selected = engine_dlx;
+    } else {
+      selected = engine_cdcl;
+    }
+  }
+  if ((selected == engine_lean && !lean_accepts(grid))
+      || (selected == engine_band && !band_accepts(grid))) {
+    selected = engine_dfs;
+  }
 
-  if (mode == mode_all) {
-    printf("Number of solutions: %i \n", solution_count);
+  if (selected == engine_cdcl) {
+    result = cdcl_solver(grid, mode, &solution_count);
+  } else if (selected == engine_dlx) {
+    result = dlx_solver(grid, mode, &solution_count);
+  } else if (selected == engine_lean) {
+    result = lean_solver(grid, mode, &solution_count);
+  } else if (selected == engine_band) {
+    result = band_solver(grid, mode, &solution_count);
+  } else if (mode == mode_first && restarts.policy != restarts_none) {
+    result = grid_solver_restarts(grid, &solution_count);
+  } else {
+    levels_t conflict;
+    solution_count = replay.solutions;
+    result = grid_solver_internal(grid, mode, &solution_count, &conflict);
   }
 
+  /* A search its monitor stopped has no count yet */
+  if (mode == mode_all && solution_sink == NULL
+      && (!search_aborted || solution_reports >= solution_limit)) {
+    printf("Number of solutions: %zu \n", solution_count);
+  }
+
+  replay_clear();
+  search_path.length = 0;
   return result;
-}
\ No newline at end of file
+}
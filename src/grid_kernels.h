@@ -0,0 +1,79 @@
+/* Grid kernels, included once per grid size by grid.c (see kernels.h), with
+ * KERNEL_CELL for the type of its cells (see cell_width()).
+ *
+ * Only the unit sweeps of the propagation have loops worth instantiating.
+ * The consistency check reads the conflict count the grid keeps up to date,
+ * the branching cell comes from its MRV buckets (degree and wdeg scan their
+ * cells, not the grid), and a copy is a single memcpy() of its slab: none of
+ * them has a loop over the grid left to specialize. */
+
+/* Run the heuristics of one unit on a copy of its cells, left in values:
+ * reads the grid only, units of the same kind may run side by side. */
+static subgrid_status_t
+KERNEL(unit_compute)(const grid_t* grid, const size_t* units,
+                     const size_t index, const unit_tier_t tier,
+                     colors_t values[]) {
+  const size_t size = KERNEL_SIZE;
+  const size_t* unit = &units[index * size];
+  const KERNEL_CELL* cells = grid->cells;
+  colors_t* subgrid[KERNEL_SIZE];
+
+  for (size_t i = 0; i < size; i++) {
+    values[i] = cells[unit[i]];
+    subgrid[i] = &values[i];
+  }
+
+  size_t eliminations = 0;
+  switch (tier) {
+    case tier_deferred:
+      return subgrid_deferred_heuristics(subgrid, size);
+
+    case tier_alldiff:
+      return alldiff_filter(subgrid, size, unit_matchings[index],
+                            &eliminations);
+
+    default:
+      return subgrid_heuristics(subgrid, size);
+  }
+}
+
+/* Write back the cells a unit changed so that the incremental state of the
+ * grid follows, given the status of its unit_compute() */
+static subgrid_status_t
+KERNEL(unit_apply)(grid_t* grid, const size_t* units, const size_t index,
+                   const subgrid_status_t status, const colors_t values[]) {
+  const size_t size = KERNEL_SIZE;
+  const size_t* unit = &units[index * size];
+  const KERNEL_CELL* cells = grid->cells;
+
+  if (status == subgrid_inconsistent) {
+    grid->conflict_reason |= grid->reasons[index];
+  }
+  if (status != subgrid_changed) {
+    return status;
+  }
+
+  /* What the unit deduced depends on what its own cells depend on */
+  grid->change_reason = grid->reasons[index];
+  for (size_t i = 0; i < size; i++) {
+    if (cells[unit[i]] != values[i]) {
+      grid_cell_set(grid, unit[i] / size, unit[i] % size, values[i]);
+    }
+  }
+
+  return grid->conflicts ? subgrid_inconsistent : subgrid_changed;
+}
+
+static subgrid_status_t
+KERNEL(unit_heuristics)(grid_t* grid, const size_t* units, const size_t index,
+                        const unit_tier_t tier) {
+  colors_t values[KERNEL_SIZE];
+  subgrid_status_t status =
+      KERNEL(unit_compute)(grid, units, index, tier, values);
+
+  return KERNEL(unit_apply)(grid, units, index, status, values);
+}
+
+#undef KERNEL_SIZE
+#undef KERNEL_SUFFIX
+#undef KERNEL_CELL
@@ -0,0 +1,21 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+/* Kernels specialized per grid size: a template file defines its functions
+ * as KERNEL(name), with KERNEL_SIZE for the grid size in their bounds, and is
+ * included once per size after defining KERNEL_SIZE and KERNEL_SUFFIX. With a
+ * constant size the compiler unrolls and vectorizes the loops; an instance
+ * with the runtime size as KERNEL_SIZE (suffix 'any') serves other sizes. */
+#define KERNEL_CONCAT_(name, suffix) name##_##suffix
+#define KERNEL_CONCAT(name, suffix)  KERNEL_CONCAT_(name, suffix)
+#define KERNEL(name)                 KERNEL_CONCAT(name, KERNEL_SUFFIX)
+
+/* Block size of each grid size, in place of sqrt() */
+static const unsigned char kernel_block_sizes[] = {
+    [1] = 1, [4] = 2, [9] = 3, [16] = 4, [25] = 5, [36] = 6, [49] = 7, [64] = 8,
+#ifdef COLORS_WIDE
+    [81] = 9, [100] = 10,
+#endif
+};
+
+#endif /* KERNELS_H */
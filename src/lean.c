@@ -0,0 +1,271 @@
+#include "lean.h"
+
+#include <colors.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Value of a cell with no color placed yet */
+#define LEAN_EMPTY UINT8_MAX
+
+/* Search state: the touched part is n^2 bytes of values, 3n masks and the
+ * list of the empty cells, ~400 bytes for a 9x9 grid, plus the masks a node
+ * works out before going deeper (kept here rather than in each frame of the
+ * recursion, as deep as the number of empty cells). */
+typedef struct {
+  size_t size;
+  size_t block_size;
+  colors_t full;
+  uint8_t values[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  colors_t used[3 * MAX_GRID_SIZE]; /* Rows, then columns, then blocks */
+  uint16_t empty[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  size_t empty_count;
+  /* Scratch of a search node: colors of each empty cell, colors with at least
+   * one and at least two places in each unit */
+  colors_t candidates[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  colors_t once[3 * MAX_GRID_SIZE];
+  colors_t twice[3 * MAX_GRID_SIZE];
+
+  const grid_t* grid;
+  _mode_t mode;
+  size_t* solution_count;
+  grid_t* solution;
+} lean_t;
+
+static void
+lean_units(const lean_t* lean, const size_t cell, size_t units[3]) {
+  size_t row = cell / lean->size;
+  size_t column = cell % lean->size;
+
+  units[0] = row;
+  units[1] = lean->size + column;
+  units[2] = 2 * lean->size + (row / lean->block_size) * lean->block_size
+             + column / lean->block_size;
+}
+
+static colors_t
+lean_candidates(const lean_t* lean, const size_t cell) {
+  size_t units[3];
+
+  lean_units(lean, cell, units);
+  return colors_subtract(lean->full, colors_or(lean->used[units[0]],
+                                               colors_or(lean->used[units[1]],
+                                                         lean->used[units[2]])));
+}
+
+static void
+lean_place(lean_t* lean, const size_t cell, const size_t color) {
+  size_t units[3];
+
+  lean_units(lean, cell, units);
+  lean->values[cell] = color;
+  for (size_t i = 0; i < 3; i++) {
+    lean->used[units[i]] = colors_add(lean->used[units[i]], color);
+  }
+}
+
+static void
+lean_remove(lean_t* lean, const size_t cell) {
+  size_t units[3];
+
+  lean_units(lean, cell, units);
+  for (size_t i = 0; i < 3; i++) {
+    lean->used[units[i]] =
+        colors_discard(lean->used[units[i]], lean->values[cell]);
+  }
+  lean->values[cell] = LEAN_EMPTY;
+}
+
+static grid_t*
+lean_grid(const lean_t* lean) {
+  grid_t* result = grid_copy(lean->grid);
+  if (result == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  for (size_t cell = 0; cell < lean->size * lean->size; cell++) {
+    grid_set_colors(result, cell / lean->size, cell % lean->size,
+                    colors_set(lean->values[cell]));
+  }
+  return result;
+}
+
+/* Backtracking in place, true once a solution is found in mode_first, or the
+ * limit of the solutions is reached in mode_all */
+static bool
+lean_search(lean_t* lean) {
+  size_t size = lean->size;
+
+  if (lean->empty_count == 0) {
+    if (lean->mode == mode_first) {
+      lean->solution = lean_grid(lean);
+      return true;
+    }
+    grid_t* solution = lean_grid(lean);
+    bool more = grid_report_solution(solution);
+    grid_free(solution);
+    (*lean->solution_count)++;
+    return !more;
+  }
+
+  /* Colors of the empty cells, and colors with at least one, and at least
+   * two, places in each unit, in the scratch of the state: they are done
+   * with before going deeper */
+  colors_t* once = lean->once;
+  colors_t* twice = lean->twice;
+  colors_t* candidates = lean->candidates;
+  size_t best = 0;
+  colors_t best_colors = colors_empty();
+  size_t best_count = size + 1;
+
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    once[unit] = twice[unit] = colors_empty();
+  }
+
+  for (size_t i = 0; i < lean->empty_count; i++) {
+    size_t cell = lean->empty[i];
+    size_t units[3];
+    colors_t colors = lean_candidates(lean, cell);
+    size_t count = colors_count(colors);
+
+    if (count == 0) {
+      return false;
+    }
+    candidates[i] = colors;
+    if (count < best_count) {
+      best = i;
+      best_colors = colors;
+      best_count = count;
+    }
+
+    lean_units(lean, cell, units);
+    for (size_t j = 0; j < 3; j++) {
+      twice[units[j]] |= colors_and(once[units[j]], colors);
+      once[units[j]] |= colors;
+    }
+  }
+
+  /* A color missing from a unit with no place left fails, the colors with a
+   * single place in a unit are left in 'once' */
+  for (size_t unit = 0; unit < 3 * size; unit++) {
+    colors_t missing = colors_subtract(lean->full, lean->used[unit]);
+    if (colors_subtract(missing, once[unit]) != colors_empty()) {
+      return false;
+    }
+    once[unit] = colors_subtract(once[unit], twice[unit]);
+  }
+
+  /* Each of these colors is forced in its single place: a cell forced to two
+   * colors fails. Without a cell left with a single color, the cell placed
+   * is the one of the first unit holding such a color, for its lowest one. */
+  size_t forced_unit = best_count > 1 ? 3 * size : 0;
+  for (size_t i = 0; i < lean->empty_count; i++) {
+    size_t units[3];
+    lean_units(lean, lean->empty[i], units);
+
+    colors_t forced = colors_and(
+        candidates[i],
+        colors_or(once[units[0]], colors_or(once[units[1]], once[units[2]])));
+    if (forced == colors_empty()) {
+      continue;
+    }
+    if (!colors_is_singleton(forced)) {
+      return false;
+    }
+    for (size_t j = 0; j < 3; j++) {
+      if (units[j] < forced_unit
+          && colors_rightmost(once[units[j]]) == forced) {
+        forced_unit = units[j];
+        best = i;
+        best_colors = forced;
+        best_count = 1;
+      }
+    }
+  }
+
+  size_t cell = lean->empty[best];
+  lean->empty[best] = lean->empty[--lean->empty_count];
+  lean->empty[lean->empty_count] = cell;
+
+  bool found = false;
+  for (colors_t left = best_colors; left != colors_empty() && !found;
+       left = colors_subtract(left, colors_rightmost(left))) {
+    lean_place(lean, cell, colors_count(colors_rightmost(left) - 1));
+    found = lean_search(lean);
+    lean_remove(lean, cell);
+  }
+
+  lean->empty_count++;
+  return found;
+}
+
+bool
+lean_accepts(const grid_t* grid) {
+  size_t size = grid_get_size(grid);
+
+  for (size_t row = 0; row < size; row++) {
+    for (size_t column = 0; column < size; column++) {
+      colors_t colors = grid_get_colors(grid, row, column);
+      if (!colors_is_singleton(colors) && colors != colors_full(size)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+grid_t*
+lean_solver(grid_t* grid, _mode_t mode, size_t* solution_count) {
+  if (grid == NULL) {
+    return NULL;
+  }
+
+  lean_t* lean = malloc(sizeof(lean_t));
+  if (lean == NULL) {
+    grid_report_failure();
+    return NULL;
+  }
+
+  lean->size = grid_get_size(grid);
+  lean->block_size = sqrt(lean->size);
+  lean->full = colors_full(lean->size);
+  lean->empty_count = 0;
+  lean->grid = grid;
+  lean->mode = mode;
+  lean->solution_count = solution_count;
+  lean->solution = NULL;
+  for (size_t unit = 0; unit < 3 * lean->size; unit++) {
+    lean->used[unit] = colors_empty();
+  }
+
+  for (size_t cell = 0; cell < lean->size * lean->size; cell++) {
+    colors_t colors =
+        grid_get_colors(grid, cell / lean->size, cell % lean->size);
+
+    if (!colors_is_singleton(colors)) {
+      lean->values[cell] = LEAN_EMPTY;
+      lean->empty[lean->empty_count++] = cell;
+      continue;
+    }
+
+    /* A color given twice in a unit */
+    if (colors_and(colors, colors_subtract(lean->full,
+                                           lean_candidates(lean, cell)))
+        != colors_empty()) {
+      free(lean);
+      return NULL;
+    }
+    lean_place(lean, cell, colors_count(colors_rightmost(colors) - 1));
+  }
+
+  lean_search(lean);
+
+  grid_t* result = lean->solution;
+  free(lean);
+  return result;
+}
@@ -0,0 +1,484 @@
+#include "libsudoku.h"
+
+#include <band.h>
+#include <cache.h>
+#include <canon.h>
+#include <colors.h>
+#include <dlx.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Longest value of the strategy options */
+#define OPTION_LENGTH 64
+
+/* Longest error message */
+#define MESSAGE_LENGTH 128
+
+struct _sudoku_t {
+  engine_t engine;
+  bool engine_given; /* Band on 9x9 grids and dfs on others otherwise */
+  bool dfs_options;  /* An option of the dfs engine was set: dfs on all */
+  char branching[OPTION_LENGTH];
+  char restarts[OPTION_LENGTH];
+  char pipeline[OPTION_LENGTH];
+  chains_mode_t chains;
+  bitboards_mode_t bitboards;
+  bool alldiff;
+  bool backjumping;
+  uint64_t seed;
+  size_t limit; /* Solutions of mode_all before the search stops */
+  grid_sink_t sink;
+  void* data;
+  size_t count; /* Solutions of the current search */
+  cache_t* cache;
+  canon_t canon; /* Of the grid being solved */
+  char message[MESSAGE_LENGTH];
+};
+
+/* Names of the engines, in the order of engine_t */
+static const char* const engine_names[] = {"dfs",  "cdcl", "dlx",
+                                           "lean", "band", "auto"};
+
+static sudoku_error_t
+context_error(sudoku_t* context, const sudoku_error_t error, const char* fmt,
+              ...) {
+  va_list vargs;
+
+  va_start(vargs, fmt);
+  vsnprintf(context->message, sizeof(context->message), fmt, vargs);
+  va_end(vargs);
+  return error;
+}
+
+sudoku_t*
+sudoku_alloc(void) {
+  sudoku_t* context = calloc(1, sizeof(sudoku_t));
+  if (context == NULL) {
+    return NULL;
+  }
+
+  context->engine = engine_dfs;
+  strcpy(context->branching, "mrv");
+  strcpy(context->restarts, "none");
+  strcpy(context->pipeline, "adaptive");
+  context->chains = chains_auto;
+  context->bitboards = bitboards_auto;
+  context->limit = SIZE_MAX;
+  return context;
+}
+
+void
+sudoku_free(sudoku_t* context) {
+  free(context);
+}
+
+/* Mode of the chains tier: on (or NULL), off or auto */
+static bool
+parse_chains_mode(const char* value, chains_mode_t* mode) {
+  if (value == NULL || !strcmp(value, "on")) {
+    *mode = chains_on;
+  } else if (!strcmp(value, "off")) {
+    *mode = chains_off;
+  } else if (!strcmp(value, "auto")) {
+    *mode = chains_auto;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/* Mode of the bitboards tier: on (or NULL), off or auto */
+static bool
+parse_bitboards_mode(const char* value, bitboards_mode_t* mode) {
+  if (value == NULL || !strcmp(value, "on")) {
+    *mode = bitboards_on;
+  } else if (!strcmp(value, "off")) {
+    *mode = bitboards_off;
+  } else if (!strcmp(value, "auto")) {
+    *mode = bitboards_auto;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/* A number in decimal, without a sign */
+static bool
+parse_number(const char* value, uint64_t* number) {
+  char* end;
+
+  if (value == NULL || !isdigit((unsigned char)*value)) {
+    return false;
+  }
+  errno = 0;
+  uint64_t parsed = strtoull(value, &end, 10);
+  if (*end != '\0' || errno == ERANGE) {
+    return false;
+  }
+  *number = parsed;
+  return true;
+}
+
+static bool
+parse_switch(const char* value, bool* enabled) {
+  if (value == NULL || !strcmp(value, "on")) {
+    *enabled = true;
+  } else if (!strcmp(value, "off")) {
+    *enabled = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/* Keep the spec of a strategy once the grid module accepted it */
+static bool
+set_spec(char spec[OPTION_LENGTH], const char* value,
+         bool (*check)(const char*)) {
+  if (value == NULL) {
+    value = "";
+  }
+  if (strlen(value) >= OPTION_LENGTH || !check(value)) {
+    return false;
+  }
+  strcpy(spec, value);
+  return true;
+}
+
+sudoku_error_t
+sudoku_set_option(sudoku_t* context, const char* name, const char* value) {
+  bool valid = false;
+
+  context->message[0] = '\0';
+
+  if (!strcmp(name, "engine")) {
+    for (size_t i = 0; value != NULL && i <= engine_auto; i++) {
+      if (!strcmp(value, engine_names[i])) {
+        context->engine = i;
+        context->engine_given = true;
+        valid = true;
+      }
+    }
+  } else if (!strcmp(name, "branch")) {
+    valid = value != NULL
+            && set_spec(context->branching, value, grid_set_branching);
+  } else if (!strcmp(name, "restarts")) {
+    valid = set_spec(context->restarts, value, grid_set_restarts);
+  } else if (!strcmp(name, "pipeline")) {
+    valid = value != NULL
+            && set_spec(context->pipeline, value, subgrid_pipeline_set);
+  } else if (!strcmp(name, "chains")) {
+    valid = parse_chains_mode(value, &context->chains);
+  } else if (!strcmp(name, "bitboards")) {
+    valid = parse_bitboards_mode(value, &context->bitboards);
+  } else if (!strcmp(name, "alldiff")) {
+    valid = parse_switch(value, &context->alldiff);
+  } else if (!strcmp(name, "backjump")) {
+    valid = parse_switch(value, &context->backjumping);
+  } else if (!strcmp(name, "seed")) {
+    valid = parse_number(value, &context->seed);
+  } else if (!strcmp(name, "limit")) {
+    uint64_t limit;
+
+    valid = parse_number(value, &limit) && limit > 0;
+    if (valid) {
+      context->limit = limit < SIZE_MAX ? limit : SIZE_MAX;
+    }
+  } else {
+    return context_error(context, sudoku_error_option, "unknown option: %s",
+                         name);
+  }
+
+  if (!valid) {
+    return context_error(context, sudoku_error_option,
+                         "invalid value of option %s: %s", name,
+                         value ? value : "(none)");
+  }
+  context->dfs_options |= strcmp(name, "engine") && strcmp(name, "limit");
+  return sudoku_ok;
+}
+
+void
+sudoku_set_sink(sudoku_t* context, grid_sink_t sink, void* data) {
+  context->sink = sink;
+  context->data = data;
+}
+
+void
+sudoku_set_cache(sudoku_t* context, cache_t* cache) {
+  context->cache = cache;
+}
+
+/* Characters of a grid, from a file or from a string */
+typedef struct {
+  FILE* file;
+  const char* text;
+} reader_t;
+
+static int
+reader_next(reader_t* reader) {
+  if (reader->file != NULL) {
+    return fgetc(reader->file);
+  }
+  if (*reader->text == '\0') {
+    return EOF;
+  }
+  return (unsigned char)*reader->text++;
+}
+
+/* Entry of a row: a character, or the number of a color token ('{N}') */
+typedef struct {
+  char character;
+  size_t color; /* 0 for a character */
+} entry_t;
+
+/* Read the number of a color token up to its closing brace, 0 if malformed */
+static size_t
+read_color_token(reader_t* reader) {
+  size_t color = 0;
+  int c;
+
+  while ((c = reader_next(reader)) >= '0' && c <= '9') {
+    color = color * 10 + (c - '0');
+    if (color > MAX_COLORS) {
+      return 0;
+    }
+  }
+
+  return c == COLOR_TOKEN_CLOSE ? color : 0;
+}
+
+/* Fill the row of the grid from its entries */
+static sudoku_error_t
+parse_row(sudoku_t* context, grid_t* grid, const entry_t row[],
+          const size_t row_count) {
+  size_t size = grid_get_size(grid);
+
+  for (size_t i = 0; i < size; i++) {
+    if (row[i].color > 0 && row[i].color <= size) {
+      grid_set_colors(grid, row_count, i, colors_set(row[i].color - 1));
+      continue;
+    }
+    if (row[i].color > 0 || !grid_check_char(grid, row[i].character)) {
+      return context_error(context, sudoku_error_grid,
+                           "Error: Invalid character '%c' on line %zu.",
+                           row[i].character, row_count + 1);
+    }
+    grid_set_cell(grid, row_count, i, row[i].character);
+  }
+  return sudoku_ok;
+}
+
+static sudoku_error_t
+parse(sudoku_t* context, reader_t* reader, grid_t** result) {
+  entry_t row[MAX_GRID_SIZE];
+  size_t index = 0;
+  size_t row_count = 0;
+  sudoku_error_t error = sudoku_ok;
+  grid_t* grid = NULL;
+  int c;
+
+  context->message[0] = '\0';
+
+  do {
+    c = reader_next(reader);
+
+    switch (c) {
+      case '#':
+        while ((c = reader_next(reader)) != '\n' && c != EOF)
+          ;
+        if (c == '\n') {
+          break;
+        }
+        /* fall through */
+
+      case '\n':
+      case EOF:
+        if (index == 0) {
+          break;
+        }
+        if (row_count == 0) {
+          if (!grid_check_size(index)) {
+            error = context_error(context, sudoku_error_grid,
+                                  "Error: Invalid grid size %zu on line 1.",
+                                  index);
+            break;
+          }
+          grid = grid_alloc(index);
+          if (grid == NULL) {
+            error = context_error(context, sudoku_error_memory,
+                                  "Error allocating memory for grid.");
+            break;
+          }
+        } else if (index != grid_get_size(grid)) {
+          error = context_error(context, sudoku_error_grid,
+                                "Line %zu is malformed! (wrong number of "
+                                "columns)",
+                                row_count + 1);
+          break;
+        }
+
+        error = parse_row(context, grid, row, row_count);
+        row_count++;
+        index = 0;
+        break;
+
+      case ' ':
+      case '\t':
+        break;
+
+      default:
+        if (index >= MAX_GRID_SIZE) {
+          error = context_error(context, sudoku_error_grid,
+                                "Error: Row on line %zu has too many columns.",
+                                row_count + 1);
+          break;
+        }
+        row[index].character = c;
+        row[index].color = 0;
+        if (c == COLOR_TOKEN_OPEN) {
+          row[index].color = read_color_token(reader);
+          if (row[index].color == 0) {
+            error = context_error(context, sudoku_error_grid,
+                                  "Error: Invalid color token on line %zu.",
+                                  row_count + 1);
+            break;
+          }
+        }
+        index++;
+    }
+  } while (c != EOF && error == sudoku_ok);
+
+  if (error == sudoku_ok
+      && (grid == NULL || row_count != grid_get_size(grid))) {
+    error = context_error(context, sudoku_error_grid,
+                          "Error: Incomplete or extra rows in grid.");
+  }
+  if (error != sudoku_ok) {
+    grid_free(grid);
+    grid = NULL;
+  }
+
+  *result = grid;
+  return error;
+}
+
+sudoku_error_t
+sudoku_parse(sudoku_t* context, const char* text, grid_t** grid) {
+  reader_t reader = {NULL, text};
+  return parse(context, &reader, grid);
+}
+
+sudoku_error_t
+sudoku_parse_file(sudoku_t* context, FILE* file, grid_t** grid) {
+  reader_t reader = {file, NULL};
+  return parse(context, &reader, grid);
+}
+
+static void
+context_sink(const grid_t* solution, void* data) {
+  sudoku_t* context = data;
+
+  context->count++;
+  if (context->sink != NULL) {
+    context->sink(solution, context->data);
+  }
+}
+
+/* Set the settings of the context on the calling thread */
+static void
+context_apply(sudoku_t* context, const grid_t* grid) {
+  engine_t engine = context->engine;
+
+  if (!context->engine_given) {
+    engine = band_accepts(grid) && !context->dfs_options ? engine_band
+                                                         : engine_dfs;
+  }
+  grid_set_engine(engine);
+  grid_set_branching(context->branching);
+  grid_set_restarts(context->restarts);
+  subgrid_pipeline_set(context->pipeline);
+  grid_set_chains(context->chains);
+  grid_set_bitboards(context->bitboards);
+  grid_set_alldiff(context->alldiff);
+  grid_set_backjumping(context->backjumping);
+  grid_set_seed(context->seed);
+  grid_set_sink(context_sink, context);
+  grid_set_solution_limit(context->limit);
+}
+
+sudoku_error_t
+sudoku_solve(sudoku_t* context, const grid_t* grid, const _mode_t mode,
+             grid_t** solution, size_t* count) {
+  context->message[0] = '\0';
+  context->count = 0;
+
+  /* A grid the cache holds, up to its symmetries, is not solved again */
+  bool cached = context->cache != NULL && mode == mode_first
+                && canon_compute_grid(grid, &context->canon);
+  grid_t* result = NULL;
+  bool completed = true;
+
+  if (!cached || !cache_lookup(context->cache, &context->canon, grid, &result)) {
+    grid_t* copy = grid_copy(grid);
+    if (copy == NULL) {
+      return context_error(context, sudoku_error_memory,
+                           "Error allocating memory for grid.");
+    }
+
+    context_apply(context, copy);
+    result = grid_solver(copy, mode);
+    completed = grid_solver_completed();
+    grid_set_sink(NULL, NULL);
+    grid_set_solution_limit(SIZE_MAX);
+
+    if (result != copy) {
+      grid_free(copy);
+    }
+    /* A grid without a solution is only kept once proved so */
+    if (cached && (result != NULL || completed)) {
+      cache_store(context->cache, &context->canon, result);
+    }
+  }
+  if (mode == mode_first) {
+    context->count = result != NULL;
+  }
+  if (solution != NULL) {
+    *solution = result;
+  } else {
+    grid_free(result);
+  }
+  if (count != NULL) {
+    *count = context->count;
+  }
+
+  if (mode == mode_first && result == NULL && !completed) {
+    return context_error(context, sudoku_error_memory,
+                         "Error allocating memory while solving.");
+  }
+  if (mode == mode_first && result == NULL) {
+    return context_error(context, sudoku_error_unsolvable,
+                         "Error: no solution found.");
+  }
+  return sudoku_ok;
+}
+
+const char*
+sudoku_error_message(const sudoku_t* context) {
+  return context->message;
+}
+
+void
+sudoku_release_thread(void) {
+  dlx_release();
+  grid_set_threads(1);
+  grid_arena_release();
+}
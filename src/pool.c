@@ -0,0 +1,152 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+struct _pool_t {
+  size_t threads;
+  pthread_t* workers;
+  pthread_mutex_t lock;
+  pthread_cond_t start; /* A run begins, or the pool stops */
+  pthread_cond_t done;  /* The last worker left the run */
+
+  /* Current run, under the lock but for the next index to hand out */
+  pool_task_t task;
+  void* context;
+  size_t count;
+  atomic_size_t next;
+  size_t generation; /* Runs started so far */
+  size_t busy;       /* Workers still in the current run */
+  bool stopping;
+};
+
+/* Take indexes of the current run until there is none left */
+static void
+pool_work(pool_t* pool, const pool_task_t task, void* context,
+          const size_t count) {
+  for (size_t i = atomic_fetch_add(&pool->next, 1); i < count;
+       i = atomic_fetch_add(&pool->next, 1)) {
+    task(context, i);
+  }
+}
+
+static void*
+pool_worker(void* argument) {
+  pool_t* pool = argument;
+  size_t generation = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  while (true) {
+    while (pool->generation == generation && !pool->stopping) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if (pool->stopping) {
+      break;
+    }
+    generation = pool->generation;
+
+    pool_task_t task = pool->task;
+    void* context = pool->context;
+    size_t count = pool->count;
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_work(pool, task, context, count);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->busy == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+pool_t*
+pool_alloc(const size_t threads) {
+  if (threads == 0) {
+    return NULL;
+  }
+
+  pool_t* pool = calloc(1, sizeof(pool_t));
+  if (pool == NULL) {
+    return NULL;
+  }
+  pool->workers = calloc(threads, sizeof(pthread_t));
+  if (pool->workers == NULL) {
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  atomic_init(&pool->next, 0);
+
+  for (size_t i = 0; i + 1 < threads; i++) {
+    if (pthread_create(&pool->workers[i], NULL, pool_worker, pool) != 0) {
+      pool->threads = i + 1;
+      pool_free(pool);
+      return NULL;
+    }
+  }
+  pool->threads = threads;
+
+  return pool;
+}
+
+void
+pool_free(pool_t* pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 0; i + 1 < pool->threads; i++) {
+    pthread_join(pool->workers[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->start);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool);
+}
+
+size_t
+pool_threads(const pool_t* pool) {
+  return pool->threads;
+}
+
+void
+pool_run(pool_t* pool, pool_task_t task, void* context, const size_t count) {
+  if (pool->threads == 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(context, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->task = task;
+  pool->context = context;
+  pool->count = count;
+  atomic_store(&pool->next, 0);
+  pool->busy = pool->threads - 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  pool_work(pool, task, context, count);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->busy > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,489 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "serve.h"
+
+#include <grid.h>
+#include <libsudoku.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Longest header line of a request */
+#define HEADER_LENGTH 1024
+
+/* Longest id of a request */
+#define ID_LENGTH 64
+
+/* Largest grid of a request, in bytes: a 100x100 grid of color tokens */
+#define GRID_LENGTH (1 << 20)
+
+/* Requests read ahead of the workers, at most */
+#define QUEUE_LENGTH 1024
+
+/* Connection of a client: its requests come from 'in', its responses go to
+ * 'out' */
+typedef struct {
+  FILE* in;
+  FILE* out;
+  bool owned;            /* The streams are closed with the connection */
+  pthread_mutex_t lock;  /* Held to write a response or change references */
+  size_t references;     /* The reader, and each request in flight */
+} peer_t;
+
+typedef struct request {
+  peer_t* peer;
+  char id[ID_LENGTH];
+  _mode_t mode;
+  bool valid_mode;
+  char* options; /* The end of the header */
+  char* text;    /* The grid, terminated by a null character */
+  uint64_t received_ns;
+  struct request* next;
+} request_t;
+
+/* Requests waiting for a worker, first in first out */
+typedef struct {
+  request_t* head;
+  request_t* tail;
+  size_t length;
+  bool closed; /* No request will come anymore */
+  cache_t* cache; /* Of the solutions, shared by the workers, or NULL */
+  pthread_mutex_t lock;
+  pthread_cond_t ready; /* A request came, or the queue closed */
+  pthread_cond_t room;  /* A request left */
+} queue_t;
+
+/* Connection of a client and the queue it feeds, for its reader thread */
+typedef struct {
+  peer_t* peer;
+  queue_t* queue;
+} reader_t;
+
+static uint64_t
+clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static peer_t*
+peer_alloc(FILE* in, FILE* out, const bool owned) {
+  peer_t* peer = malloc(sizeof(peer_t));
+  if (peer == NULL) {
+    return NULL;
+  }
+
+  peer->in = in;
+  peer->out = out;
+  peer->owned = owned;
+  peer->references = 1;
+  pthread_mutex_init(&peer->lock, NULL);
+  return peer;
+}
+
+static void
+peer_retain(peer_t* peer) {
+  pthread_mutex_lock(&peer->lock);
+  peer->references++;
+  pthread_mutex_unlock(&peer->lock);
+}
+
+static void
+peer_release(peer_t* peer) {
+  pthread_mutex_lock(&peer->lock);
+  bool last = --peer->references == 0;
+  pthread_mutex_unlock(&peer->lock);
+
+  if (!last) {
+    return;
+  }
+  if (peer->owned) {
+    fclose(peer->in);
+    fclose(peer->out);
+  }
+  pthread_mutex_destroy(&peer->lock);
+  free(peer);
+}
+
+static void
+respond(peer_t* peer, const char* id, const char* status, const size_t count,
+        const uint64_t solve_ns, const uint64_t wait_ns, const char* payload,
+        const size_t length) {
+  pthread_mutex_lock(&peer->lock);
+  fprintf(peer->out, "%s %s %zu %" PRIu64 " %" PRIu64 " %zu\n", id, status,
+          count, solve_ns / 1000, wait_ns / 1000, length);
+  fwrite(payload, 1, length, peer->out);
+  fflush(peer->out);
+  pthread_mutex_unlock(&peer->lock);
+}
+
+static void
+queue_init(queue_t* queue, cache_t* cache) {
+  queue->head = NULL;
+  queue->tail = NULL;
+  queue->length = 0;
+  queue->closed = false;
+  queue->cache = cache;
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->ready, NULL);
+  pthread_cond_init(&queue->room, NULL);
+}
+
+static void
+queue_push(queue_t* queue, request_t* request) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->length == QUEUE_LENGTH) {
+    pthread_cond_wait(&queue->room, &queue->lock);
+  }
+  request->next = NULL;
+  if (queue->tail != NULL) {
+    queue->tail->next = request;
+  } else {
+    queue->head = request;
+  }
+  queue->tail = request;
+  queue->length++;
+  pthread_cond_signal(&queue->ready);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+/* The next request, NULL once the queue is closed and empty */
+static request_t*
+queue_pop(queue_t* queue) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->head == NULL && !queue->closed) {
+    pthread_cond_wait(&queue->ready, &queue->lock);
+  }
+  request_t* request = queue->head;
+  if (request != NULL) {
+    queue->head = request->next;
+    if (queue->head == NULL) {
+      queue->tail = NULL;
+    }
+    queue->length--;
+    pthread_cond_signal(&queue->room);
+  }
+  pthread_mutex_unlock(&queue->lock);
+  return request;
+}
+
+static void
+queue_close(queue_t* queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->closed = true;
+  pthread_cond_broadcast(&queue->ready);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+static void
+request_free(request_t* request) {
+  free(request->options);
+  free(request->text);
+  free(request);
+}
+
+/* Read the next request of a peer: NULL at the end of its stream, or when a
+ * request cannot be framed (after answering it) */
+static request_t*
+read_request(peer_t* peer) {
+  char header[HEADER_LENGTH];
+  char id[ID_LENGTH] = "-";
+  char mode[8];
+  size_t length;
+  int end = 0;
+
+  do {
+    if (fgets(header, sizeof(header), peer->in) == NULL) {
+      return NULL;
+    }
+  } while (header[strspn(header, " \t\r\n")] == '\0');
+
+  const char* error = NULL;
+  mode[0] = '\0';
+  if (sscanf(header, "%63s %7s %zu%n", id, mode, &length, &end) != 3
+      || strchr(header, '\n') == NULL) {
+    error = "malformed header\n";
+  } else if (length > GRID_LENGTH) {
+    error = "grid too large\n";
+  }
+  if (error != NULL) {
+    respond(peer, id, "error", 0, 0, 0, error, strlen(error));
+    return NULL;
+  }
+
+  request_t* request = calloc(1, sizeof(request_t));
+  if (request == NULL
+      || (request->options = strdup(header + end)) == NULL
+      || (request->text = malloc(length + 1)) == NULL) {
+    error = "out of memory\n";
+  } else if (fread(request->text, 1, length, peer->in) != length) {
+    error = "truncated grid\n";
+  }
+  if (error != NULL) {
+    respond(peer, id, "error", 0, 0, 0, error, strlen(error));
+    if (request != NULL) {
+      request_free(request);
+    }
+    return NULL;
+  }
+
+  request->peer = peer;
+  strcpy(request->id, id);
+  request->text[length] = '\0';
+  request->received_ns = clock_ns();
+  request->valid_mode = true;
+  if (!strcmp(mode, "first")) {
+    request->mode = mode_first;
+  } else if (!strcmp(mode, "all")) {
+    request->mode = mode_all;
+  } else {
+    request->valid_mode = false;
+  }
+  return request;
+}
+
+/* Queue the requests of a peer until the end of its stream */
+static void
+read_requests(peer_t* peer, queue_t* queue) {
+  request_t* request;
+
+  while ((request = read_request(peer)) != NULL) {
+    if (!request->valid_mode) {
+      respond(peer, request->id, "error", 0, 0, 0, "invalid mode\n", 13);
+      request_free(request);
+      continue;
+    }
+    peer_retain(peer);
+    queue_push(queue, request);
+  }
+}
+
+static void*
+reader_thread(void* argument) {
+  reader_t* reader = argument;
+
+  read_requests(reader->peer, reader->queue);
+  peer_release(reader->peer);
+  free(reader);
+  return NULL;
+}
+
+static void
+sink_solution(const grid_t* solution, void* data) {
+  FILE* stream = data;
+
+  grid_print(solution, stream);
+  fputc('\n', stream);
+}
+
+/* Apply the options of a request to its context */
+static sudoku_error_t
+request_options(const request_t* request, sudoku_t* context, FILE* stream) {
+  char* state;
+
+  for (char* option = strtok_r(request->options, " \t\r\n", &state);
+       option != NULL; option = strtok_r(NULL, " \t\r\n", &state)) {
+    char* value = strchr(option, '=');
+    if (value != NULL) {
+      *value++ = '\0';
+    }
+
+    if (sudoku_set_option(context, option, value) != sudoku_ok) {
+      fputs(sudoku_error_message(context), stream);
+      return sudoku_error_option;
+    }
+  }
+  return sudoku_ok;
+}
+
+static void
+serve_request(request_t* request, cache_t* cache) {
+  uint64_t start = clock_ns();
+  char* payload = NULL;
+  size_t length = 0;
+  size_t count = 0;
+  FILE* stream = open_memstream(&payload, &length);
+  sudoku_t* context = sudoku_alloc();
+  sudoku_error_t error = sudoku_ok;
+  grid_t* grid = NULL;
+  grid_t* solution = NULL;
+
+  if (stream == NULL || context == NULL) {
+    error = sudoku_error_memory;
+  } else if ((error = request_options(request, context, stream)) == sudoku_ok
+             && (error = sudoku_parse(context, request->text, &grid))
+                    == sudoku_ok) {
+    sudoku_set_sink(context, sink_solution, stream);
+    sudoku_set_cache(context, cache);
+    error = sudoku_solve(context, grid, request->mode, &solution, &count);
+  }
+
+  if (stream != NULL && context != NULL) {
+    if (solution != NULL) {
+      grid_print(solution, stream);
+    } else if (error != sudoku_ok && error != sudoku_error_unsolvable) {
+      if (error != sudoku_error_option) {
+        fputs(sudoku_error_message(context), stream);
+      }
+      fputc('\n', stream);
+    }
+  }
+  if (stream != NULL) {
+    fclose(stream);
+  }
+
+  const char* status = error == sudoku_ok            ? "ok"
+                       : error == sudoku_error_unsolvable ? "unsolvable"
+                                                          : "error";
+  respond(request->peer, request->id, status, count, clock_ns() - start,
+          start - request->received_ns, payload ? payload : "",
+          payload ? length : 0);
+
+  free(payload);
+  grid_free(solution);
+  grid_free(grid);
+  sudoku_free(context);
+}
+
+static void*
+worker_thread(void* argument) {
+  queue_t* queue = argument;
+  request_t* request;
+
+  while ((request = queue_pop(queue)) != NULL) {
+    serve_request(request, queue->cache);
+    peer_release(request->peer);
+    request_free(request);
+  }
+
+  sudoku_release_thread();
+  return NULL;
+}
+
+/* Accept connections on a Unix domain socket, each one read by a thread of
+ * its own, until accept() fails */
+static void
+serve_socket(const char* path, queue_t* queue) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  struct stat status;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    errno = ENAMETOOLONG;
+    return;
+  }
+  strcpy(address.sun_path, path);
+
+  /* A socket left by a previous server */
+  if (stat(path, &status) == 0 && S_ISSOCK(status.st_mode)) {
+    unlink(path);
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return;
+  }
+  if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0
+      || listen(listener, SOMAXCONN) < 0) {
+    close(listener);
+    return;
+  }
+
+  while (true) {
+    int connection = accept(listener, NULL, NULL);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      break;
+    }
+
+    int duplicate = dup(connection);
+    FILE* in = fdopen(connection, "r");
+    FILE* out = duplicate >= 0 ? fdopen(duplicate, "w") : NULL;
+    reader_t* reader = malloc(sizeof(reader_t));
+    peer_t* peer = in && out && reader ? peer_alloc(in, out, true) : NULL;
+    pthread_t thread;
+
+    if (peer == NULL) {
+      if (in != NULL) {
+        fclose(in);
+      } else {
+        close(connection);
+      }
+      if (out != NULL) {
+        fclose(out);
+      } else if (duplicate >= 0) {
+        close(duplicate);
+      }
+      free(reader);
+      continue;
+    }
+
+    reader->peer = peer;
+    reader->queue = queue;
+    if (pthread_create(&thread, NULL, reader_thread, reader) != 0) {
+      peer_release(peer);
+      free(reader);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  close(listener);
+  unlink(path);
+}
+
+bool
+serve(const char* path, const size_t workers, cache_t* cache) {
+  queue_t queue;
+  pthread_t* threads = malloc(workers * sizeof(pthread_t));
+  size_t started = 0;
+
+  if (threads == NULL) {
+    return false;
+  }
+
+  /* A client leaving early must not end the server */
+  signal(SIGPIPE, SIG_IGN);
+
+  queue_init(&queue, cache);
+  while (started < workers
+         && pthread_create(&threads[started], NULL, worker_thread, &queue)
+                == 0) {
+    started++;
+  }
+
+  bool served = started == workers;
+  if (served && path != NULL) {
+    serve_socket(path, &queue);
+    served = false;
+  } else if (served) {
+    peer_t* peer = peer_alloc(stdin, stdout, false);
+    served = peer != NULL;
+    if (served) {
+      read_requests(peer, &queue);
+      peer_release(peer);
+    }
+  }
+
+  queue_close(&queue);
+  for (size_t i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  return served;
+}
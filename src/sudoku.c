@@ -1,29 +1,95 @@
 #include "sudoku.h"
 
+#include "band.h"
+#include "batch.h"
+#include "cache.h"
+#include "canon.h"
+#include "cdcl.h"
+#include "checkpoint.h"
+#include "dedup.h"
 #include "grid.h"
+#include "libsudoku.h"
+#include "serve.h"
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <ctype.h>
 #include <err.h>
+#include <errno.h>
 #include <getopt.h>
 #include <libgen.h>
+#include <limits.h>
 #include <string.h>
 
+#ifdef COLORS_WIDE
+#define GRID_SIZES "1, 4, 9, 16, 25, 36, 49, 64, 81, 100"
+#else
+#define GRID_SIZES "1, 4, 9, 16, 25, 36, 49, 64"
+#endif
+
 static bool verbose = false;
 static FILE* output;
 
 static void
 print_help(char* executable_name) {
-  printf("Usage:\t%s [a|-o FILE|-v|-V|-h] FILE...\n"
+  printf("Usage:\t%s [-a|-b STRATEGY|-c[MODE]|-d|-D|-e ENGINE|-j|-l|-p LIST"
+         "|-r[POLICY]|-s SEED|-t N|-x[MODE]|-k N[,FILE]|-o FILE|-v|-V|-h]"
+         " FILE...\n"
+         "\tsudoku -a -C FILE[,SECONDS] [OPTION...] FILE\n"
+         "\tsudoku -a -R FILE [OPTION...]\n"
+         "\tsudoku -S[PATH] [-t N|-k N[,FILE]]\n"
          "\tsudoku -g[SIZE] [-u|-o FILE|-v|-V|-h]\n"
-         "Solve or generate Sudoku grids of size: 1, 4, 9, 16, 25, 36, 49, 64\n"
+         "Solve or generate Sudoku grids of size: " GRID_SIZES "\n"
          "\n"
          "-a,--all\t\tsearch for all possible solutions\n"
+         "-b S,--branch=STRATEGY\tbranching: mrv, degree or wdeg, and lcv,"
+         " random\n"
+         "\t\t\t(e.g. 'wdeg,lcv', default:mrv)\n"
+         "-C F[,S],--checkpoint=FILE[,SECONDS]\twith -a, save where the"
+         " search is to\n\t\t\tFILE every S seconds (default:60) and on"
+         " SIGINT or\n\t\t\tSIGTERM, which stop it, on the dfs engine"
+         " only\n"
+         "-c[M],--chains[=MODE]\tchain deductions: on, off or auto "
+         "(default:auto)\n"
+         "-d,--alldiff\t\tall-different filtering of the units\n"
+         "-D,--dedup\t\tFILE holds grids as with -l: print the first grid"
+         " of each\n\t\t\tsymmetry class and its number of grids\n"
+         "-e E,--engine=ENGINE\tsolver engine: dfs, cdcl, dlx, lean, band"
+         " or\n"
+         "\t\t\tauto (default:band on 9x9 grids, dfs on others and"
+         "\n\t\t\twith -b, -c, -d, -j, -p, -r, -s or -x)\n"
          "-g[N],--generate[SIZE]\tgenerate a grid of size NxN (default:9)\n"
+         "-j,--backjump\t\tconflict-directed backjumping\n"
+         "-k N[,F],--cache=N[,FILE]\tkeep the first solutions of N grids"
+         " per size, up\n\t\t\tto their symmetries, in memory or in"
+         " the files FILE.SIZE\n"
+         "-l,--lines\t\tFILE holds 4x4, 9x9 or 16x16 grids, one per line"
+         " (16, 81\n\t\t\tor 256 characters, any but a color for an empty"
+         "\n\t\t\tcell), solved in batches: print one solution (or"
+         "\n\t\t\t'-') per line, or counts with -a\n"
          "-o FILE,--output=FILE\twrite output to FILE\n"
+         "-p LIST,--pipeline=LIST\theuristics order, e.g. 'cross,lone,naked'"
+         " (default:adaptive)\n"
+         "-R FILE,--resume=FILE\twith -a, resume the search saved to FILE"
+         " by -C and\n\t\t\tgo on saving it there\n"
+         "-r[P],--restarts[=POLICY]\trandomized restarts: luby or "
+         "geometric, cutoff\n"
+         "\t\t\tunit (nodes), reset (e.g. 'luby,128', default:none)\n"
+         "-s N,--seed=N\t\tseed of the random choices (default:0)\n"
+         "-S[P],--serve[=PATH]\tserve requests on stdin, or on the Unix"
+         " socket PATH:\n\t\t\t'ID first|all LENGTH [OPTION=VALUE]...'"
+         " then the\n\t\t\tgrid, solved with the options of the request"
+         " (see\n\t\t\tserve.h)\n"
+         "-t N,--threads=N\tpropagate 49x49 and larger grids on N threads"
+         "\n\t\t\t(default:1), serve requests on N workers, or"
+         " tell\n\t\t\tthe classes of -D apart on N threads\n"
+         "-x[M],--bitboards[=MODE]\tcolor bitboard deductions: on, off or"
+         " auto\n"
+         "\t\t\t(default:auto)\n"
          "-u,--unique\t\tgenerate a grid with unique solution\n"
          "-v,--verbose\t\tverbose output\n"
          "-V,--version\t\tdisplay version and exit\n"
@@ -34,98 +100,175 @@ print_help(char* executable_name) {
 }
 
 static grid_t*
-file_parser(char* filename) {
+file_parser(sudoku_t* context, char* filename) {
   FILE* file = fopen(filename, "r");
   if (!file) {
     fprintf(stderr, "Error opening file \"%s\".\n", filename);
     exit(EXIT_FAILURE);
   }
 
-  char row[MAX_GRID_SIZE];
-  size_t index = 0;
-  int c;
-
-  grid_t* grid = NULL;
-  size_t expected_row_length = 0;
-  size_t row_count = 0;
-
-  while (true) {
-    c = fgetc(file);
+  grid_t* grid;
+  if (sudoku_parse_file(context, file, &grid) != sudoku_ok) {
+    fprintf(stderr, "%s\n", sudoku_error_message(context));
+    fclose(file);
+    exit(EXIT_FAILURE);
+  }
 
-    switch (c) {
-      case '#':
-        while ((c = fgetc(file)) != '\n' && c != EOF)
-          ;
-        break;
+  fclose(file);
+  return grid;
+}
 
-      case ' ':
-      case '\t':
-        break;
+/* Solve a grid in mode_all with checkpoints (see checkpoint.h), from its file
+ * or, without one, from the checkpoint it resumes. Return false if a signal
+ * stopped the search. */
+static bool
+checkpoint_solver(sudoku_t* context, char* filename, const char* path,
+                  const unsigned seconds) {
+  checkpoint_t* checkpoint;
+  grid_t* grid;
+
+  if (filename == NULL) {
+    checkpoint = checkpoint_resume(path, seconds, context, &grid);
+    if (checkpoint == NULL) {
+      fprintf(stderr, "Error resuming from checkpoint \"%s\".\n", path);
+      if (*sudoku_error_message(context) != '\0') {
+        fprintf(stderr, "%s\n", sudoku_error_message(context));
+      }
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    grid = file_parser(context, filename);
+    checkpoint = checkpoint_alloc(path, seconds, grid);
+    if (checkpoint == NULL) {
+      err(EXIT_FAILURE, "Error setting up checkpoint: %s", path);
+    }
+  }
 
-      case '\n':
-      case EOF:
-        if (index > 0) {
-          if (row_count == 0) {
-            grid = grid_alloc(index);
+  /* The path of the search is the one of the dfs engine */
+  grid_set_engine(engine_dfs);
+  grid_solver(grid, mode_all);
+  grid_free(grid);
+  return checkpoint_finish(checkpoint);
+}
 
-            if (!grid) {
-              fprintf(stderr, "Error allocating memory for grid.\n");
-              fclose(file);
-              exit(EXIT_FAILURE);
-            }
+/* Grids read from a file of lines before they are solved as a batch */
+#define LINES_CHUNK 4096
 
-            expected_row_length = index;
-          } else if (index != expected_row_length) {
-            fprintf(stderr,
-                    "Line %zu is malformed! (wrong number of columns)\n",
-                    row_count + 1);
-            grid_free(grid);
-            fclose(file);
-            exit(EXIT_FAILURE);
-          }
+/* Longest line of a file of lines, a 16x16 grid and what may follow it */
+#define LINES_LENGTH 1024
 
-          for (size_t i = 0; i < index; i++) {
-            if (!grid_check_char(grid, row[i])) {
-              fprintf(stderr, "Error: Invalid character '%c' on line %zu.\n",
-                      row[i], row_count + 1);
-              grid_free(grid);
-              fclose(file);
-              exit(EXIT_FAILURE);
-            }
-            grid_set_cell(grid, row_count, i, row[i]);
-          }
+/* Solve the grids of a file holding one grid per line, row by row: 4x4, 9x9
+ * or 16x16 grids, after the length of the first one (16, 81 or 256 cells, up
+ * to a blank, ',' or ';'). Anything after the cells of a grid is ignored, as
+ * are empty lines and lines starting with '#'. Print one solution, or '-',
+ * per line in mode_first, the number of solutions in mode_all, or with dedup
+ * the first grid of each symmetry class and its number of grids, the
+ * classes being told apart on the given number of threads. */
+static void
+lines_solver(char* filename, _mode_t mode, const bool dedup,
+             const size_t threads) {
+  FILE* file = fopen(filename, "r");
+  if (!file) {
+    fprintf(stderr, "Error opening file \"%s\".\n", filename);
+    exit(EXIT_FAILURE);
+  }
 
-          row_count++;
-          index = 0;
+  char line[LINES_LENGTH];
+  size_t line_count = 0;
+  size_t size = 0;
+  size_t cells = 0;
+  size_t count = 0;
+  char* puzzles = NULL;
+  char* solutions = NULL;
+  size_t* counts = malloc(LINES_CHUNK * sizeof(size_t));
+  dedup_t* classes = NULL;
+
+  for (bool more = true; more;) {
+    more = fgets(line, sizeof(line), file) != NULL;
+    if (more) {
+      size_t length = strcspn(line, "\r\n");
+      line_count++;
+
+      /* Skip the end of a line longer than the buffer */
+      if (line[length] == '\0' && length == sizeof(line) - 1) {
+        int c;
+        while ((c = fgetc(file)) != '\n' && c != EOF)
+          ;
+      }
+      if (length == 0 || line[0] == '#') {
+        continue;
+      }
+
+      if (size == 0) {
+        size_t first = strcspn(line, " \t,;\r\n");
+        for (size = 1; size * size < first; size++)
+          ;
+        if (size * size != first || !batch_accepts(size)) {
+          fprintf(stderr,
+                  "Error: Line %zu is not a 4x4, 9x9 or 16x16 grid.\n",
+                  line_count);
+          exit(EXIT_FAILURE);
         }
-
-        if (c == EOF) {
-          goto end_of_file;
+        cells = first;
+        puzzles = malloc(LINES_CHUNK * cells);
+        solutions = malloc(LINES_CHUNK * cells);
+        if (counts == NULL || puzzles == NULL || solutions == NULL) {
+          err(EXIT_FAILURE, "Error allocating the grids");
         }
-
-        break;
-
-      default:
-        if (index >= MAX_GRID_SIZE) {
-          fprintf(stderr, "Error: Row on line %zu has too many columns.\n",
-                  row_count + 1);
-          fclose(file);
-          exit(EXIT_FAILURE);
+        if (dedup && (classes = dedup_alloc(size, threads)) == NULL) {
+          err(EXIT_FAILURE, "Error allocating the symmetry classes");
         }
-        row[index++] = c;
+      }
+      if (length < cells) {
+        fprintf(stderr, "Error: Line %zu is not a %zux%zu grid.\n",
+                line_count, size, size);
+        exit(EXIT_FAILURE);
+      }
+      memcpy(&puzzles[count++ * cells], line, cells);
+      if (count < LINES_CHUNK) {
+        continue;
+      }
+    }
+    if (count == 0) {
+      continue;
     }
-  }
 
-end_of_file:
+    if (classes != NULL) {
+      if (!dedup_add(classes, count, puzzles)) {
+        err(EXIT_FAILURE, "Error classifying the grids");
+      }
+      count = 0;
+      continue;
+    }
 
-  if (!grid || row_count != grid_get_size(grid)) {
-    fprintf(stderr, "Error: Incomplete or extra rows in grid.\n");
-    fclose(file);
-    exit(EXIT_FAILURE);
+    if (!batch_solve(size, count, puzzles,
+                     mode == mode_first ? solutions : NULL, counts,
+                     mode == mode_first ? 1 : SIZE_MAX)) {
+      err(EXIT_FAILURE, "Error solving the grids");
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (mode == mode_all) {
+        fprintf(output, "%zu\n", counts[i]);
+      } else if (counts[i] > 0) {
+        fprintf(output, "%.*s\n", (int)cells, &solutions[i * cells]);
+      } else {
+        fprintf(output, "-\n");
+      }
+    }
+    count = 0;
   }
 
+  if (classes != NULL) {
+    dedup_print(classes, output);
+    if (verbose) {
+      dedup_print_stats(classes, stderr);
+    }
+    dedup_free(classes);
+  }
+  free(puzzles);
+  free(solutions);
+  free(counts);
   fclose(file);
-  return grid;
 }
 
 int
@@ -133,16 +276,47 @@ main(int argc, char* argv[]) {
   int optc;
   bool unique = false;
   bool generate = false;
+  bool engine_given = false;
+  bool dfs_engine = true; /* The engine given, if any, is the dfs one */
+  bool dfs_options = false;
+  bool lines = false;
+  bool dedup = false;
+  bool serving = false;
+  const char* socket_path = NULL;
+  size_t cache_entries = 0;
+  const char* cache_path = NULL;
+  cache_t* cache = NULL;
+  const char* checkpoint_path = NULL;
+  unsigned long checkpoint_seconds = CHECKPOINT_PERIOD;
+  bool resume = false;
+  unsigned long threads = 1;
   int result;
   char* filename = NULL;
   _mode_t mode = mode_first;
 
   const struct option options[] = {{"help", no_argument, NULL, 'h'},
                                    {"all", no_argument, NULL, 'a'},
+                                   {"branch", required_argument, NULL, 'b'},
+                                   {"chains", optional_argument, NULL, 'c'},
+                                   {"checkpoint", required_argument, NULL,
+                                    'C'},
+                                   {"alldiff", no_argument, NULL, 'd'},
+                                   {"engine", required_argument, NULL, 'e'},
                                    {"version", no_argument, NULL, 'V'},
                                    {"generate", optional_argument, NULL, 'g'},
+                                   {"restarts", optional_argument, NULL, 'r'},
+                                   {"resume", required_argument, NULL, 'R'},
+                                   {"seed", required_argument, NULL, 's'},
+                                   {"serve", optional_argument, NULL, 'S'},
+                                   {"threads", required_argument, NULL, 't'},
                                    {"unique", no_argument, NULL, 'u'},
+                                   {"bitboards", optional_argument, NULL, 'x'},
+                                   {"backjump", no_argument, NULL, 'j'},
+                                   {"cache", required_argument, NULL, 'k'},
+                                   {"lines", no_argument, NULL, 'l'},
+                                   {"dedup", no_argument, NULL, 'D'},
                                    {"output", required_argument, NULL, 'o'},
+                                   {"pipeline", required_argument, NULL, 'p'},
                                    {"verbose", no_argument, NULL, 'v'},
                                    {NULL, 0, NULL, 0}};
 
@@ -150,7 +324,10 @@ main(int argc, char* argv[]) {
 
   char* program_name = basename(argv[0]);
 
-  while ((optc = getopt_long(argc, argv, "havg::uo:V", options, NULL)) != -1) {
+  while ((optc = getopt_long(argc, argv, "hab:c::C:dDe:jk:lvg::uo:p:r::R:s:S::t:x::V", options, NULL)) != -1) {
+    /* Options of the dfs engine, which the 9x9 grids then go to as well */
+    dfs_options |= strchr("bcdjprsx", optc) != NULL;
+
     switch (optc) {
       case 'h':
         print_help(program_name);
@@ -158,8 +335,7 @@ main(int argc, char* argv[]) {
 
       case 'V':
         printf("%s version %d.%d.%d\n"
-               "Solve/generate sudoku grids of size: 1, 4, 9, 16, 25, "
-               "36, 49, 64\n",
+               "Solve/generate sudoku grids of size: " GRID_SIZES "\n",
                program_name, VERSION, SUBVERSION, REVISION);
         exit(EXIT_SUCCESS);
 
@@ -184,6 +360,142 @@ main(int argc, char* argv[]) {
         printf("search for all possible solutions\n");
         break;
 
+      case 'b':
+        if (!grid_set_branching(optarg)) {
+          errx(EXIT_FAILURE, "error: invalid branching strategy: %s", optarg);
+        }
+        break;
+
+      case 'c':
+        if (optarg == NULL || !strcmp(optarg, "on")) {
+          grid_set_chains(chains_on);
+        } else if (!strcmp(optarg, "off")) {
+          grid_set_chains(chains_off);
+        } else if (!strcmp(optarg, "auto")) {
+          grid_set_chains(chains_auto);
+        } else {
+          errx(EXIT_FAILURE, "error: invalid chains mode: %s", optarg);
+        }
+        break;
+
+      case 'C': {
+        char* seconds = strchr(optarg, ',');
+        if (seconds != NULL) {
+          char* end;
+          *seconds++ = '\0';
+          checkpoint_seconds = strtoul(seconds, &end, 10);
+          if (*end != '\0' || checkpoint_seconds == 0
+              || checkpoint_seconds > UINT_MAX) {
+            errx(EXIT_FAILURE, "error: invalid checkpoint period: %s",
+                 seconds);
+          }
+        }
+        checkpoint_path = optarg;
+        resume = false;
+        break;
+      }
+
+      case 'd':
+        grid_set_alldiff(true);
+        break;
+
+      case 'D':
+        dedup = true;
+        break;
+
+      case 'e':
+        engine_given = true;
+        dfs_engine = !strcmp(optarg, "dfs");
+        if (!strcmp(optarg, "dfs")) {
+          grid_set_engine(engine_dfs);
+        } else if (!strcmp(optarg, "cdcl")) {
+          grid_set_engine(engine_cdcl);
+        } else if (!strcmp(optarg, "dlx")) {
+          grid_set_engine(engine_dlx);
+        } else if (!strcmp(optarg, "lean")) {
+          grid_set_engine(engine_lean);
+        } else if (!strcmp(optarg, "band")) {
+          grid_set_engine(engine_band);
+        } else if (!strcmp(optarg, "auto")) {
+          grid_set_engine(engine_auto);
+        } else {
+          errx(EXIT_FAILURE, "error: invalid engine: %s", optarg);
+        }
+        break;
+
+      case 'j':
+        grid_set_backjumping(true);
+        break;
+
+      case 'k': {
+        char* end;
+        cache_entries = strtoul(optarg, &end, 10);
+        if ((*end != '\0' && *end != ',') || cache_entries < CACHE_WAYS) {
+          errx(EXIT_FAILURE, "error: invalid cache size: %s", optarg);
+        }
+        cache_path = *end == ',' ? end + 1 : NULL;
+        break;
+      }
+
+      case 'l':
+        lines = true;
+        break;
+
+      case 'p':
+        if (!subgrid_pipeline_set(optarg)) {
+          errx(EXIT_FAILURE, "error: invalid heuristics pipeline: %s", optarg);
+        }
+        break;
+
+      case 'r':
+        if (!grid_set_restarts(optarg)) {
+          errx(EXIT_FAILURE, "error: invalid restart policy: %s", optarg);
+        }
+        break;
+
+      case 'R':
+        checkpoint_path = optarg;
+        resume = true;
+        break;
+
+      case 's': {
+        char* end;
+        errno = 0;
+        unsigned long long seed = strtoull(optarg, &end, 10);
+        if (!isdigit((unsigned char)*optarg) || *end != '\0'
+            || errno == ERANGE) {
+          errx(EXIT_FAILURE, "error: invalid seed: %s", optarg);
+        }
+        grid_set_seed(seed);
+        break;
+      }
+
+      case 'S':
+        serving = true;
+        socket_path = optarg;
+        break;
+
+      case 't': {
+        char* end;
+        threads = strtoul(optarg, &end, 10);
+        if (*end != '\0' || threads == 0) {
+          errx(EXIT_FAILURE, "error: invalid number of threads: %s", optarg);
+        }
+        break;
+      }
+
+      case 'x':
+        if (optarg == NULL || !strcmp(optarg, "on")) {
+          grid_set_bitboards(bitboards_on);
+        } else if (!strcmp(optarg, "off")) {
+          grid_set_bitboards(bitboards_off);
+        } else if (!strcmp(optarg, "auto")) {
+          grid_set_bitboards(bitboards_auto);
+        } else {
+          errx(EXIT_FAILURE, "error: invalid bitboards mode: %s", optarg);
+        }
+        break;
+
       case 'u':
         if (!generate) {
           warnx("warning: option 'unique' conflict with solver mode, "
@@ -214,7 +526,36 @@ main(int argc, char* argv[]) {
     }
   }
 
-  if (optind >= argc) {
+  if (cache_entries > 0) {
+    cache = cache_alloc(cache_entries, cache_path);
+    if (cache == NULL) {
+      err(EXIT_FAILURE, "Error allocating the solution cache");
+    }
+  }
+
+  if (serving) {
+    if (!serve(socket_path, threads, cache)) {
+      err(EXIT_FAILURE, "Error serving requests");
+    }
+    cache_free(cache);
+    return EXIT_SUCCESS;
+  }
+
+  if (!grid_set_threads(threads)) {
+    errx(EXIT_FAILURE, "error: cannot start %lu threads", threads);
+  }
+
+  if (checkpoint_path != NULL
+      && (mode != mode_all || lines || dedup
+          || argc - optind != (resume ? 0 : 1))) {
+    errx(EXIT_FAILURE, "error: a checkpoint goes with -a and one grid file,"
+                       " none on resume");
+  }
+  if (checkpoint_path != NULL && !dfs_engine) {
+    errx(EXIT_FAILURE, "error: a checkpoint goes with the dfs engine only");
+  }
+
+  if (optind >= argc && !resume) {
     fprintf(stderr, "Error: no input file specified.\n");
     fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
     exit(EXIT_FAILURE);
@@ -227,20 +568,89 @@ main(int argc, char* argv[]) {
     }
   }
 
+  /* Keeps the messages of the parser */
+  sudoku_t* context = sudoku_alloc();
+  if (context == NULL) {
+    err(EXIT_FAILURE, "Error allocating the solver context");
+  }
+
+  if (checkpoint_path != NULL) {
+    bool finished = checkpoint_solver(context, resume ? NULL : argv[optind],
+                                      checkpoint_path, checkpoint_seconds);
+    sudoku_free(context);
+    cache_free(cache);
+    if (output != stdout) {
+      fclose(output);
+    }
+    if (!finished) {
+      fprintf(stderr, "Search stopped, resume it with: %s -a -R %s\n",
+              program_name, checkpoint_path);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
   for (int i = optind; i < argc; ++i) {
-    grid_t* grid = file_parser(argv[i]);
+    if (lines || dedup) {
+      lines_solver(argv[i], mode, dedup, threads);
+      continue;
+    }
 
-    grid_t* new_grid = grid_solver(grid, mode);
+    grid_t* grid = file_parser(context, argv[i]);
+
+    /* 9x9 grids go to the band engine unless an engine, or an option of the
+     * dfs one, was asked for */
+    if (!engine_given) {
+      grid_set_engine(band_accepts(grid) && !dfs_options ? engine_band
+                                                         : engine_dfs);
+    }
 
+    /* A grid the cache holds, up to its symmetries, is not solved again */
+    static canon_t canon;
+    bool cached = cache != NULL && mode == mode_first
+                  && canon_compute_grid(grid, &canon);
+    grid_t* new_grid = NULL;
+    bool completed = true;
+
+    if (!cached || !cache_lookup(cache, &canon, grid, &new_grid)) {
+      new_grid = grid_solver(grid, mode);
+      completed = grid_solver_completed();
+      /* A grid without a solution is only kept once proved so */
+      if (cached && (new_grid != NULL || completed)) {
+        cache_store(cache, &canon, new_grid);
+      }
+    }
+
+    if (new_grid == NULL && mode == mode_first && !completed) {
+      fprintf(stderr, "Error: out of memory solving grid %s \n", argv[i]);
+      grid_free(grid);
+      return EXIT_FAILURE;
+    }
     if (new_grid == NULL && mode == mode_first) {
       fprintf(stderr, "Error: no solution found for grid %s \n", argv[i]);
       grid_free(grid);
       return EXIT_FAILURE;
     }
     grid_print(new_grid, output);
+    if (new_grid != grid) {
+      grid_free(new_grid);
+    }
     grid_free(grid);
   }
 
+  sudoku_free(context);
+
+  if (verbose) {
+    subgrid_pipeline_print(stderr);
+    cdcl_print_stats(stderr);
+    grid_arena_print(stderr);
+    if (cache != NULL) {
+      cache_print(cache, stderr);
+    }
+  }
+  cache_free(cache);
+  grid_arena_release();
+
   if (output != stdout) {
     fclose(output);
   }
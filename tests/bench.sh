@@ -0,0 +1,46 @@
+#!/bin/sh
+
+# Compare the solver engines on the grid solver tests (or on the grids given
+# as arguments): wall-clock time in milliseconds per grid and engine, a run
+# being cut after TIMEOUT seconds (default: 20).
+
+bold=`tput bold`
+reset=`tput sgr0`
+
+ENGINES="${ENGINES:-dfs cdcl dlx lean band}"
+TIMEOUT="${TIMEOUT:-20}"
+
+if [ $# -gt 0 ]
+then
+    TEST_FILES="$@"
+else
+    TEST_FILES="tests/grid-solver/*.sku"
+fi
+
+printf "$bold%-60s" "grid"
+for engine in $ENGINES
+do
+    printf "%12s" "$engine"
+done
+printf "$reset\n"
+
+for file in $TEST_FILES
+do
+    printf "%-60s" "$(basename $file)"
+    for engine in $ENGINES
+    do
+        start=$(date +%s%N)
+        timeout $TIMEOUT ./sudoku --engine=$engine $BENCH_FLAGS $file \
+                > /dev/null 2>&1
+        exit_code=$?
+        end=$(date +%s%N)
+
+        if [ $exit_code -eq 124 ]
+        then
+            printf "%12s" "timeout"
+        else
+            printf "%12d" $(( (end - start) / 1000000 ))
+        fi
+    done
+    printf "\n"
+done
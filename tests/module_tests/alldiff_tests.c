@@ -0,0 +1,86 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <stdarg.h>
+#include <string.h>
+
+#include <alldiff.h>
+#include <colors.h>
+
+/* gcc -I ../include -c alldiff_tests.c */
+/* gcc -o alldiff_tests alldiff_tests.o alldiff.o colors.o */
+
+void
+EXPECT(bool test, char* fmt, ...) {
+  fprintf(stdout, "Checking '");
+
+  va_list vargs;
+  va_start(vargs, fmt);
+  vprintf(fmt, vargs);
+  va_end(vargs);
+
+  if (test) {
+    fprintf(stdout, "': (passed)\n");
+  } else {
+    fprintf(stdout, "': (failed!)\n");
+  }
+}
+
+/* Filter a subgrid of 'size' cells starting from an empty matching */
+static subgrid_status_t
+filter(colors_t values[], const size_t size, size_t* eliminations) {
+  colors_t* subgrid[MAX_COLORS];
+  int8_t matching[MAX_COLORS];
+
+  for (size_t i = 0; i < size; i++) {
+    subgrid[i] = &values[i];
+    matching[i] = ALLDIFF_UNMATCHED;
+  }
+  *eliminations = 0;
+  return alldiff_filter(subgrid, size, matching, eliminations);
+}
+
+int
+main(void) {
+  size_t eliminations;
+
+  fputs("alldiff_filter\n"
+        "==============\n",
+        stdout);
+
+  /* Unconstrained cells: nothing to remove */
+  colors_t full[4] = {15, 15, 15, 15};
+  EXPECT((filter(full, 4, &eliminations) == subgrid_unchanged
+          && eliminations == 0),
+         "alldiff_filter([0123] x 4) == unchanged");
+
+  /* Hidden pair: {0,1} only fit in the two first cells */
+  colors_t hidden[4] = {15, 15, 12, 12};
+  EXPECT((filter(hidden, 4, &eliminations) == subgrid_changed
+          && hidden[0] == 3 && hidden[1] == 3 && eliminations == 4),
+         "alldiff_filter([0123],[0123],[23],[23]) == [01],[01],[23],[23]");
+
+  /* Naked triple over three cells, hidden single in the last one */
+  colors_t triple[4] = {3, 6, 5, 15};
+  EXPECT((filter(triple, 4, &eliminations) == subgrid_changed
+          && triple[3] == 8 && eliminations == 3),
+         "alldiff_filter([01],[12],[02],[0123]) == ...,[3]");
+
+  /* Three cells sharing two colors */
+  colors_t pigeons[4] = {3, 3, 3, 15};
+  EXPECT((filter(pigeons, 4, &eliminations) == subgrid_inconsistent),
+         "alldiff_filter([01],[01],[01],[0123]) == inconsistent");
+
+  /* A stale matching is repaired, not trusted */
+  colors_t values[2] = {1, 2};
+  colors_t* subgrid[2] = {&values[0], &values[1]};
+  int8_t matching[2] = {1, 0};
+  eliminations = 0;
+  EXPECT((alldiff_filter(subgrid, 2, matching, &eliminations)
+              == subgrid_unchanged
+          && matching[0] == 0 && matching[1] == 1),
+         "alldiff_filter() repairs a stale matching");
+
+  return EXIT_SUCCESS;
+}
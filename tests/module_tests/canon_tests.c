@@ -0,0 +1,168 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdarg.h>
+
+#include <canon.h>
+
+/* gcc -I ../include -c canon_tests.c */
+/* gcc -o canon_tests canon_tests.o canon.o colors.o grid.o ... -lm -pthread */
+
+void
+EXPECT(bool test, char* fmt, ...) {
+  fprintf(stdout, "Checking '");
+
+  va_list vargs;
+  va_start(vargs, fmt);
+  vprintf(fmt, vargs);
+  va_end(vargs);
+
+  if (test) {
+    fprintf(stdout, "': (passed)\n");
+  } else {
+    fprintf(stdout, "': (failed!)\n");
+  }
+}
+
+/* 17 givens */
+static const char puzzle_9x9[] = ".......1.4.........2...........5.4.7..8..."
+                                 "3....1.9....3..4..2...5.1........8.6...";
+
+static const char puzzle_16x16[] = "...5.C..........D.......1..E.A8."
+                                   "..1......7...3..C..6...B5...4..."
+                                   "...........F...2.B.D.....8.....7"
+                                   "A...3...E..5....4....6.9........"
+                                   "..............A.5..A....7...3..."
+                                   ".E..3.....0..B.....C.8.....E.F.."
+                                   "....A...D.....F......4.....1...."
+                                   "..1........7.4....8...6.A.5.....";
+
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+static size_t
+random_below(const size_t bound) {
+  random_state ^= random_state >> 12;
+  random_state ^= random_state << 25;
+  random_state ^= random_state >> 27;
+  return (random_state * 0x2545F4914F6CDD1DULL >> 33) % bound;
+}
+
+static void
+shuffle(uint8_t* values, const size_t count) {
+  for (size_t i = count; i > 1; i--) {
+    size_t j = random_below(i);
+    uint8_t value = values[i - 1];
+
+    values[i - 1] = values[j];
+    values[j] = value;
+  }
+}
+
+/* Moves the cells by a random symmetry of the grid */
+static void
+scramble(const size_t size, const size_t block, const uint8_t* cells,
+         uint8_t* image) {
+  uint8_t lines[2][MAX_GRID_SIZE];
+  uint8_t blocks[MAX_GRID_SIZE];
+  uint8_t labels[MAX_GRID_SIZE + 1];
+  bool transposed = random_below(2);
+
+  for (size_t axis = 0; axis < 2; axis++) {
+    for (size_t i = 0; i < block; i++) {
+      blocks[i] = i;
+    }
+    shuffle(blocks, block);
+    for (size_t i = 0; i < block; i++) {
+      for (size_t j = 0; j < block; j++) {
+        lines[axis][i * block + j] = blocks[i] * block + j;
+      }
+      shuffle(lines[axis] + i * block, block);
+    }
+  }
+  labels[0] = 0;
+  for (size_t i = 1; i <= size; i++) {
+    labels[i] = i;
+  }
+  shuffle(labels + 1, size);
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < size; j++) {
+      size_t row = lines[0][i];
+      size_t column = lines[1][j];
+      uint8_t cell = transposed ? cells[column * size + row]
+                                : cells[row * size + column];
+
+      image[i * size + j] = labels[cell];
+    }
+  }
+}
+
+/* '.' for the empty cells, then 1 to 9, A to F and 0 */
+static void
+read_cells(const char* text, const size_t size, uint8_t* cells) {
+  const char* digits = "123456789ABCDEF0";
+
+  for (size_t i = 0; i < size * size; i++) {
+    cells[i] = text[i] == '.' ? 0 : strchr(digits, text[i]) - digits + 1;
+  }
+}
+
+static bool
+check_symmetries(const char* text, const size_t size, const size_t block) {
+  static uint8_t cells[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  static uint8_t image[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  static uint8_t back[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  static canon_t canon;
+  static canon_t other;
+  bool ok = true;
+
+  read_cells(text, size, cells);
+  ok = canon_compute(size, cells, &canon);
+
+  for (size_t run = 0; ok && run < 50; run++) {
+    scramble(size, block, cells, image);
+    ok = canon_compute(size, image, &other) && other.hash == canon.hash
+         && !memcmp(other.form, canon.form, size * size);
+
+    /* The transform moves the grid to its form, and back */
+    canon_apply(&other, image, back);
+    ok = ok && !memcmp(back, other.form, size * size);
+    canon_restore(&other, other.form, back);
+    ok = ok && !memcmp(back, image, size * size);
+  }
+  return ok;
+}
+
+int
+main(void) {
+  static uint8_t cells[MAX_GRID_SIZE * MAX_GRID_SIZE];
+  static canon_t canon;
+  static canon_t other;
+
+  fputs("Testing canonical forms\n"
+        "=======================\n",
+        stdout);
+
+  EXPECT(check_symmetries(puzzle_9x9, 9, 3),
+         "canon_compute() of 9x9 grids moved by symmetries");
+  EXPECT(check_symmetries(puzzle_16x16, 16, 4),
+         "canon_compute() of 16x16 grids moved by symmetries");
+
+  /* Empty grids have every symmetry: all of their lines are alike */
+  memset(cells, 0, sizeof(cells));
+  EXPECT(canon_compute(25, cells, &canon) && canon.form[0] == 0,
+         "canon_compute(empty 25x25) is exact");
+
+  /* Moving a given out of its band is not a symmetry */
+  read_cells(puzzle_9x9, 9, cells);
+  canon_compute(9, cells, &canon);
+  cells[7 * 9 + 6] = cells[0 * 9 + 7];
+  cells[0 * 9 + 7] = 0;
+  canon_compute(9, cells, &other);
+  EXPECT(other.hash != canon.hash, "canon_compute() of another grid differs");
+
+  return EXIT_SUCCESS;
+}
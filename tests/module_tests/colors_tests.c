@@ -43,6 +43,23 @@ ASSERT(bool test, char* fmt, ...) {
   }
 }
 
+/* Run the heuristics pipeline on a unit of 4 cells until it is stuck */
+static subgrid_status_t
+pipeline_fixpoint(colors_t values[4]) {
+  colors_t* subgrid[4] = {&values[0], &values[1], &values[2], &values[3]};
+  subgrid_status_t status = subgrid_changed;
+  subgrid_status_t last = subgrid_unchanged;
+
+  while (status == subgrid_changed) {
+    status = subgrid_heuristics(subgrid, 4);
+    if (status == subgrid_unchanged) {
+      status = subgrid_deferred_heuristics(subgrid, 4);
+    }
+    last = status == subgrid_unchanged ? last : status;
+  }
+  return last;
+}
+
 int
 main(void) {
   /* Testing colors_full */
@@ -629,5 +646,44 @@ main(void) {
 
   fputs("\n", stdout);
 
+  /* Testing the heuristics pipeline */
+  /************************************/
+  fputs("subgrid_pipeline_set\n"
+        "====================\n",
+        stdout);
+
+  EXPECT((subgrid_pipeline_set("cross,lone,naked")),
+         "subgrid_pipeline_set (\"cross,lone,naked\")");
+  EXPECT((subgrid_pipeline_set("naked")), "subgrid_pipeline_set (\"naked\")");
+  EXPECT((!subgrid_pipeline_set("cross,cross")),
+         "!subgrid_pipeline_set (\"cross,cross\")");
+  EXPECT((!subgrid_pipeline_set("cross,hidden")),
+         "!subgrid_pipeline_set (\"cross,hidden\")");
+  EXPECT((!subgrid_pipeline_set("")), "!subgrid_pipeline_set (\"\")");
+  EXPECT((subgrid_pipeline_set(NULL)), "subgrid_pipeline_set (NULL)");
+
+  /* Every pipeline with cross-hatching solves [0] [0,1] [1,2] [1,2,3] */
+  const char* pipelines[] = {"adaptive", "cross", "lone,cross",
+                             "naked,lone,cross"};
+  for (size_t i = 0; i < 4; i++) {
+    colors_t unit[4] = {colors_set(0), colors_full(2),
+                        colors_add(colors_set(1), 2),
+                        colors_add(colors_add(colors_set(1), 2), 3)};
+    subgrid_pipeline_set(pipelines[i]);
+    EXPECT((pipeline_fixpoint(unit) == subgrid_changed
+            && unit[0] == colors_set(0) && unit[1] == colors_set(1)
+            && unit[2] == colors_set(2) && unit[3] == colors_set(3)),
+           "pipeline '%s' solves [0] [0,1] [1,2] [1,2,3]", pipelines[i]);
+
+    colors_t twice[4] = {colors_set(0), colors_set(0), colors_full(4),
+                         colors_full(4)};
+    EXPECT((pipeline_fixpoint(twice) == subgrid_inconsistent),
+           "pipeline '%s' finds [0] [0] [0-3] [0-3] inconsistent",
+           pipelines[i]);
+  }
+  subgrid_pipeline_set(NULL);
+
+  fputs("\n", stdout);
+
   return EXIT_SUCCESS;
 }
@@ -1,5 +1,6 @@
 #define _DEFAULT_SOURCE
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,8 +13,13 @@
 #include <colors.h>
 #include <grid.h>
 
+/* Tests of the grid module: allocation, cells and copies on every size, the
+ * incremental consistency state, the engines on empty grids, a stopped search
+ * and its replay. */
+
 /* gcc -I ../include -c grid_tests.c */
-/* gcc -o grid_tests grid_tests.o grid.o colors.o */
+/* gcc -o grid_tests grid_tests.o grid.o colors.o ... -lm -pthread (the objects
+ * of libsudoku.a, see tests/test_suite.sh) */
 
 void
 EXPECT(bool test, char* fmt, ...) {
@@ -78,6 +84,58 @@ grid_tests(size_t size) {
   EXPECT((!grid_check_char(grid, '+')), "grid_check_char('+') == false");
   EXPECT((!grid_check_char(grid, '0')), "grid_check_char('0') == false");
 
+  /* Checking grid_is_solved() and grid_is_consistent() on an empty grid */
+  EXPECT((grid_is_consistent(grid)), "grid_is_consistent(empty grid)");
+  EXPECT((grid_is_solved(grid) == (size == 1)),
+         "grid_is_solved(empty grid) == %s", (size == 1) ? "true" : "false");
+
+  /* Checking that a color placed twice in a row is caught right away */
+  if (size > 1) {
+    grid_t* twice = grid_alloc(size);
+    grid_set_cell(twice, 0, 0, color_table[0]);
+    EXPECT((grid_is_consistent(twice)), "grid_is_consistent(one color set)");
+    grid_set_cell(twice, 0, size - 1, color_table[0]);
+    EXPECT((!grid_is_consistent(twice)),
+           "!grid_is_consistent(same color twice in a row)");
+    grid_set_cell(twice, 0, size - 1, EMPTY_CELL);
+    EXPECT((grid_is_consistent(twice)),
+           "grid_is_consistent(second color reset)");
+    grid_free(twice);
+  }
+
+  /* Checking that cells, however narrow, keep the highest color of the size
+   * and all of them, in the grid and in a copy */
+  grid_t* wide = grid_alloc(size);
+  grid_set_colors(wide, size - 1, 0, colors_set(size - 1));
+  grid_set_colors(wide, 0, size - 1, colors_full(size));
+  grid_t* wide_copy = grid_copy(wide);
+  EXPECT((grid_get_colors(wide_copy, size - 1, 0) == colors_set(size - 1)
+          && grid_get_colors(wide_copy, 0, size - 1) == colors_full(size)),
+         "grid_get_colors() == colors_set(%zu), colors_full(%zu)", size - 1,
+         size);
+  grid_free(wide_copy);
+  grid_free(wide);
+
+  /* Checking that the CDCL, DLX, lean and band engines fill an empty grid */
+  if (size <= 16) {
+    engine_t engines[] = {engine_cdcl, engine_dlx, engine_lean, engine_band};
+    const char* names[] = {"engine_cdcl", "engine_dlx", "engine_lean",
+                           "engine_band"};
+    for (size_t i = 0; i < 4; i++) {
+      grid_set_engine(engines[i]);
+      grid_t* solution = grid_solver(grid, mode_first);
+      EXPECT((solution && grid_is_solved(solution)
+              && grid_is_consistent(solution)),
+             "grid_solver(empty grid) with %s is solved", names[i]);
+      if (solution != grid) {
+        grid_free(solution);
+      }
+    }
+    grid_set_engine(engine_dfs);
+    EXPECT((colors_count(grid_get_colors(grid, 0, 0)) == size),
+           "grid_get_colors(empty grid, 0, 0) == colors_full(%zu)", size);
+  }
+
   /* Checking grid_set_cell() with random initialization of the grid */
   for (size_t i = 0; i < grid_get_size(grid); ++i) {
     for (size_t j = 0; j < grid_get_size(grid); ++j) {
@@ -145,6 +203,205 @@ grid_tests(size_t size) {
   fputs("\n", stdout);
 }
 
+/* First choice of a search, seen by first_choice_monitor() */
+static grid_step_t first_step;
+
+static bool
+first_choice_monitor(const grid_step_t* path, const size_t length,
+                     const size_t solutions, void* data) {
+  (void)solutions;
+  (void)data;
+  if (length == 0) {
+    return true;
+  }
+  first_step = path[0];
+  return false;
+}
+
+/* The solver branches on a cell with the fewest colors, however the cells
+ * got them */
+static void
+mrv_tests(void) {
+  fputs(" Testing the cell picked for branching\n"
+        "=======================================\n",
+        stdout);
+
+  grid_t* grid = grid_alloc(9);
+  grid_set_colors(grid, 2, 3, colors_full(3));
+  grid_set_colors(grid, 7, 1, colors_full(2));
+  grid_set_colors(grid, 4, 5, colors_add(colors_set(3), 8));
+  grid_set_colors(grid, 7, 1, colors_full(9));
+
+  grid_set_engine(engine_dfs);
+  grid_set_monitor(first_choice_monitor, NULL, 1);
+  grid_solver(grid, mode_first);
+  EXPECT((first_step.choice.row == 4 && first_step.choice.column == 5
+          && first_step.candidates == 2),
+         "the first choice is in the cell of 2 colors (%zu, %zu)",
+         first_step.choice.row, first_step.choice.column);
+  grid_set_monitor(NULL, NULL, 0);
+  grid_free(grid);
+
+  fputs("\n", stdout);
+}
+
+/* Where a search stopped by stop_monitor() was */
+static struct {
+  size_t calls; /* Left before the stop */
+  grid_step_t path[64];
+  size_t length;
+  size_t solutions;
+} stop;
+
+static bool
+stop_monitor(const grid_step_t* path, const size_t length,
+             const size_t solutions, void* data) {
+  (void)data;
+  if (--stop.calls > 0) {
+    return true;
+  }
+
+  memcpy(stop.path, path, length * sizeof(grid_step_t));
+  stop.length = length;
+  stop.solutions = solutions;
+  return false;
+}
+
+static void
+count_sink(const grid_t* solution, void* data) {
+  (void)solution;
+  (*(size_t*)data)++;
+}
+
+/* Stop the search of all the solutions of an empty 4x4 grid, then resume it
+ * from where it stopped */
+static void
+replay_tests(void) {
+  fputs(" Testing a stopped search and its replay\n"
+        "=========================================\n",
+        stdout);
+
+  grid_t* grid = grid_alloc(4);
+  size_t before = 0;
+  size_t after = 0;
+
+  grid_set_engine(engine_dfs);
+  grid_set_monitor(stop_monitor, NULL, 1);
+  grid_set_sink(count_sink, &before);
+  stop.calls = 100;
+  grid_solver(grid, mode_all);
+  EXPECT((stop.calls == 0 && stop.length > 0), "the monitor stops the search");
+  EXPECT((stop.solutions == before),
+         "the monitor counts the solutions reported (%zu)", before);
+  grid_free(grid);
+
+  grid = grid_alloc(4);
+  grid_set_monitor(NULL, NULL, 0);
+  grid_set_sink(count_sink, &after);
+  EXPECT((grid_set_replay(stop.path, stop.length, stop.solutions)),
+         "grid_set_replay(path, %zu, %zu)", stop.length, stop.solutions);
+  grid_solver(grid, mode_all);
+  EXPECT((before + after == 288),
+         "%zu solutions before the stop and %zu after it == 288", before,
+         after);
+  grid_set_sink(NULL, NULL);
+  grid_free(grid);
+
+  fputs("\n", stdout);
+}
+
+/* Grids allocated on a thread of their own */
+static void*
+alloc_thread(void* data) {
+  grid_t** grids = data;
+
+  for (size_t i = 0; i < 3; i++) {
+    grids[i] = grid_alloc(4);
+  }
+  return NULL;
+}
+
+/* Slabs allocated so far by the calling thread for its grids of a size */
+static size_t
+slab_allocations(const size_t size) {
+  char line[256];
+  char prefix[32];
+  size_t bytes = 0, high_water = 0, allocations = 0;
+
+  snprintf(prefix, sizeof(prefix), "Grid slabs for size %zu:", size);
+  FILE* counters = tmpfile();
+  grid_arena_print(counters);
+  rewind(counters);
+  while (fgets(line, sizeof(line), counters) != NULL) {
+    if (!strncmp(line, prefix, strlen(prefix))) {
+      sscanf(line + strlen(prefix), " %zu bytes, %zu in use at most, %zu",
+             &bytes, &high_water, &allocations);
+    }
+  }
+  fclose(counters);
+  return allocations;
+}
+
+/* Two searches on a thread of their own: the second one allocates no slab,
+ * the ones of the first being kept across grid_solver() */
+static void*
+solve_thread(void* data) {
+  bool* kept = data;
+  size_t allocations[2];
+
+  grid_set_engine(engine_dfs);
+  for (size_t i = 0; i < 2; i++) {
+    grid_t* grid = grid_alloc(9);
+    grid_t* solution = grid_solver(grid, mode_first);
+
+    if (solution != grid) {
+      grid_free(solution);
+    }
+    grid_free(grid);
+    allocations[i] = slab_allocations(9);
+  }
+  *kept = allocations[0] > 0 && allocations[1] == allocations[0];
+  grid_arena_release();
+  return NULL;
+}
+
+/* Slabs freed by another thread than the one that allocated them are taken in
+ * by the thread freeing them, and counted apart */
+static void
+arena_tests(void) {
+  fputs(" Testing grids freed on another thread\n"
+        "=======================================\n",
+        stdout);
+
+  grid_t* grids[3];
+  pthread_t thread;
+  char line[256] = "";
+
+  pthread_create(&thread, NULL, alloc_thread, grids);
+  pthread_join(thread, NULL);
+  for (size_t i = 0; i < 3; i++) {
+    grid_free(grids[i]);
+  }
+
+  FILE* counters = tmpfile();
+  grid_arena_print(counters);
+  rewind(counters);
+  while (fgets(line, sizeof(line), counters) != NULL
+         && strncmp(line, "Grid slabs for size 4:", 22)) {
+  }
+  fclose(counters);
+  EXPECT((strstr(line, " 3 taken in from other threads") != NULL),
+         "grid_arena_print() counts 3 slabs taken in");
+
+  bool kept = false;
+
+  pthread_create(&thread, NULL, solve_thread, &kept);
+  pthread_join(thread, NULL);
+  EXPECT(kept, "grid_solver() keeps its slabs for the next grids");
+
+  fputs("\n", stdout);
+}
+
 int
 main(void) {
   /* Initializing PRNG */
@@ -194,5 +451,9 @@ main(void) {
   grid_tests(49);
   grid_tests(64);
 
+  arena_tests();
+  mrv_tests();
+  replay_tests();
+
   return EXIT_SUCCESS;
 }
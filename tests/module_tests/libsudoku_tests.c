@@ -0,0 +1,286 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <grid.h>
+#include <libsudoku.h>
+
+/* gcc -I ../include -c libsudoku_tests.c */
+/* gcc -o libsudoku_tests libsudoku_tests.o libsudoku.o grid.o colors.o ...
+ *   -lm -pthread */
+
+void
+EXPECT(bool test, char* fmt, ...) {
+  fprintf(stdout, "Checking '");
+
+  va_list vargs;
+  va_start(vargs, fmt);
+  vprintf(fmt, vargs);
+  va_end(vargs);
+
+  if (test) {
+    fprintf(stdout, "': (passed)\n");
+  } else {
+    fprintf(stdout, "': (failed!)\n");
+  }
+}
+
+static const char empty_4x4[] = "____\n____\n____\n____\n";
+
+/* Unique solution */
+static const char grid_9x9[] = "53__7____\n"
+                               "6__195___\n"
+                               "_98____6_\n"
+                               "8___6___3\n"
+                               "4__8_3__1\n"
+                               "7___2___6\n"
+                               "_6____28_\n"
+                               "___419__5\n"
+                               "____8__79\n";
+
+/* The same grid, its first two rows swapped and its 1s and 2s too */
+static const char moved_9x9[] = "6__295___\n"
+                                "53__7____\n"
+                                "_98____6_\n"
+                                "8___6___3\n"
+                                "4__8_3__2\n"
+                                "7___1___6\n"
+                                "_6____18_\n"
+                                "___429__5\n"
+                                "____8__79\n";
+
+/* Layout of the file of the 9x9 table of a cache (see cache.c): a header,
+ * then slots of a head and two grids of 81 bytes */
+#define HEADER_LENGTH 32
+#define SLOT_HEAD 24
+#define SLOT_STRIDE ((SLOT_HEAD + 2 * 81 + 7) & ~7)
+
+#define THREADS 4
+
+static const char* const engines[THREADS] = {"dfs", "dlx", "cdcl", "lean"};
+
+/* Solutions of each thread, counted by its sink, and its outcome */
+static size_t sunk[THREADS];
+static bool passed[THREADS];
+
+static void
+count_sink(const grid_t* solution, void* data) {
+  size_t* count = data;
+
+  (*count) += grid_is_solved((grid_t*)solution);
+}
+
+static void*
+solve_thread(void* argument) {
+  size_t index = (size_t)argument;
+  sudoku_t* context = sudoku_alloc();
+  grid_t* grid = NULL;
+  grid_t* solution = NULL;
+  size_t count = 0;
+  bool ok = context != NULL;
+
+  ok = ok && sudoku_set_option(context, "engine", engines[index]) == sudoku_ok;
+  sudoku_set_sink(context, count_sink, &sunk[index]);
+
+  for (size_t run = 0; ok && run < 20; run++) {
+    ok = sudoku_parse(context, empty_4x4, &grid) == sudoku_ok
+         && sudoku_solve(context, grid, mode_all, NULL, &count) == sudoku_ok
+         && count == 288;
+    grid_free(grid);
+  }
+  ok = ok && sudoku_parse(context, grid_9x9, &grid) == sudoku_ok
+       && sudoku_solve(context, grid, mode_first, &solution, &count)
+              == sudoku_ok
+       && count == 1 && grid_is_solved(solution);
+  grid_free(solution);
+  grid_free(grid);
+
+  sudoku_free(context);
+  sudoku_release_thread();
+  passed[index] = ok;
+  return NULL;
+}
+
+int
+main(void) {
+  sudoku_t* context = sudoku_alloc();
+  grid_t* grid = NULL;
+  size_t count = 0;
+
+  fputs("Testing solver contexts\n"
+        "=======================\n",
+        stdout);
+
+  EXPECT(context != NULL, "sudoku_alloc() != NULL");
+
+  /* Checking sudoku_set_option() */
+  EXPECT(sudoku_set_option(context, "engine", "dlx") == sudoku_ok,
+         "sudoku_set_option(engine, dlx) == sudoku_ok");
+  EXPECT(sudoku_set_option(context, "engine", "fast") == sudoku_error_option,
+         "sudoku_set_option(engine, fast) == sudoku_error_option");
+  EXPECT(sudoku_set_option(context, "branch", "wdeg,lcv") == sudoku_ok,
+         "sudoku_set_option(branch, wdeg,lcv) == sudoku_ok");
+  EXPECT(sudoku_set_option(context, "chains", NULL) == sudoku_ok,
+         "sudoku_set_option(chains, NULL) == sudoku_ok");
+  EXPECT(sudoku_set_option(context, "seed", "12x") == sudoku_error_option,
+         "sudoku_set_option(seed, 12x) == sudoku_error_option");
+  EXPECT(sudoku_set_option(context, "seed", "-1") == sudoku_error_option,
+         "sudoku_set_option(seed, -1) == sudoku_error_option");
+  EXPECT(sudoku_set_option(context, "speed", "1") == sudoku_error_option,
+         "sudoku_set_option(speed, 1) == sudoku_error_option");
+
+  /* Checking sudoku_parse() */
+  EXPECT(sudoku_parse(context, "12\n3\n", &grid) == sudoku_error_grid
+             && grid == NULL,
+         "sudoku_parse(wrong number of columns) == sudoku_error_grid");
+  EXPECT(sudoku_parse(context, "1x__\n____\n____\n____\n", &grid)
+             == sudoku_error_grid,
+         "sudoku_parse(invalid character) == sudoku_error_grid");
+  EXPECT(sudoku_error_message(context)[0] != '\0',
+         "sudoku_error_message() is set");
+  EXPECT(sudoku_parse(context, "____\n____\n", &grid) == sudoku_error_grid,
+         "sudoku_parse(missing rows) == sudoku_error_grid");
+  EXPECT(sudoku_parse(context, "", &grid) == sudoku_error_grid,
+         "sudoku_parse(empty) == sudoku_error_grid");
+  EXPECT(sudoku_parse(context, "{1} # comment\n", &grid) == sudoku_ok
+             && grid_get_size(grid) == 1,
+         "sudoku_parse(comment and color token) == sudoku_ok");
+  grid_free(grid);
+
+  /* Checking sudoku_solve() */
+  EXPECT(sudoku_parse(context, "11__\n____\n____\n____\n", &grid) == sudoku_ok
+             && sudoku_solve(context, grid, mode_first, NULL, &count)
+                    == sudoku_error_unsolvable
+             && count == 0,
+         "sudoku_solve(inconsistent) == sudoku_error_unsolvable");
+  grid_free(grid);
+
+  /* Checking the limit of the solutions, on every engine */
+  sudoku_t* limited = sudoku_alloc();
+
+  for (size_t i = 0; i < THREADS; i++) {
+    EXPECT(sudoku_set_option(limited, "engine", engines[i]) == sudoku_ok
+               && sudoku_set_option(limited, "limit", "3") == sudoku_ok
+               && sudoku_parse(limited, empty_4x4, &grid) == sudoku_ok
+               && sudoku_solve(limited, grid, mode_all, NULL, &count)
+                      == sudoku_ok
+               && count == 3,
+           "sudoku_solve(limit=3) with engine %s", engines[i]);
+    grid_free(grid);
+  }
+  EXPECT(sudoku_set_option(limited, "limit", "0") == sudoku_error_option,
+         "sudoku_set_option(limit=0) == sudoku_error_option");
+  sudoku_free(limited);
+
+  /* Checking sudoku_set_cache(): the grid moved by a symmetry (rows of a band
+   * swapped, colors relabeled) hits the solution of the first one */
+  cache_t* cache = cache_alloc(64, NULL);
+  grid_t* solution = NULL;
+  grid_t* other = NULL;
+
+  sudoku_set_cache(context, cache);
+  EXPECT(sudoku_parse(context, grid_9x9, &grid) == sudoku_ok
+             && sudoku_solve(context, grid, mode_first, NULL, &count)
+                    == sudoku_ok
+             && sudoku_parse(context, moved_9x9, &other) == sudoku_ok
+             && sudoku_solve(context, other, mode_first, &solution, &count)
+                    == sudoku_ok
+             && count == 1 && grid_is_solved(solution)
+             && grid_get_colors(solution, 0, 0) == grid_get_colors(other, 0, 0),
+         "sudoku_solve() with a cache, of a grid moved by a symmetry");
+  grid_free(solution);
+  grid_free(other);
+  grid_free(grid);
+  sudoku_set_cache(context, NULL);
+  cache_free(cache);
+
+  /* Checking a cache file whose solution was damaged (two cells of a row
+   * swapped): the grid is solved again */
+  char path[64];
+  char file[80];
+  grid_t* expected = NULL;
+
+  snprintf(path, sizeof(path), "/tmp/libsudoku_tests.%d", (int)getpid());
+  snprintf(file, sizeof(file), "%s.9", path);
+  cache = cache_alloc(64, path);
+  sudoku_set_cache(context, cache);
+  sudoku_parse(context, grid_9x9, &grid);
+  sudoku_solve(context, grid, mode_first, &expected, NULL);
+  cache_free(cache);
+
+  FILE* stream = fopen(file, "r+b");
+  unsigned char slot[SLOT_STRIDE];
+  bool damaged = false;
+
+  for (long offset = HEADER_LENGTH; stream != NULL && !damaged
+                                    && fseek(stream, offset, SEEK_SET) == 0
+                                    && fread(slot, sizeof(slot), 1, stream);
+       offset += SLOT_STRIDE) {
+    uint64_t status;
+
+    memcpy(&status, slot + 16, sizeof(status));
+    if (status == 1) {
+      unsigned char* image = slot + SLOT_HEAD + 81;
+      unsigned char cell = image[0];
+
+      image[0] = image[1];
+      image[1] = cell;
+      damaged = fseek(stream, offset, SEEK_SET) == 0
+                && fwrite(slot, sizeof(slot), 1, stream) == 1;
+    }
+  }
+  if (stream != NULL) {
+    fclose(stream);
+  }
+
+  char* printed = NULL;
+  size_t length = 0;
+  FILE* print = open_memstream(&printed, &length);
+  bool same = true;
+
+  cache = cache_alloc(64, path);
+  sudoku_set_cache(context, cache);
+  EXPECT(damaged
+             && sudoku_solve(context, grid, mode_first, &solution, NULL)
+                    == sudoku_ok,
+         "sudoku_solve() with a damaged cache file");
+  for (size_t i = 0; i < 81 && solution != NULL && expected != NULL; i++) {
+    same &= grid_get_colors(solution, i / 9, i % 9)
+            == grid_get_colors(expected, i / 9, i % 9);
+  }
+  cache_print(cache, print);
+  fclose(print);
+  EXPECT(solution != NULL && same
+             && strstr(printed, "0 hits, 1 misses") != NULL,
+         "cache_lookup() of a damaged slot is a miss");
+  free(printed);
+  grid_free(solution);
+  grid_free(expected);
+  grid_free(grid);
+  sudoku_set_cache(context, NULL);
+  cache_free(cache);
+  unlink(file);
+
+  /* Contexts solving side by side, each one with its engine and its sink */
+  pthread_t threads[THREADS];
+  bool started = true;
+
+  for (size_t i = 0; i < THREADS; i++) {
+    started &= !pthread_create(&threads[i], NULL, solve_thread, (void*)i);
+  }
+  for (size_t i = 0; started && i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    EXPECT(passed[i] && sunk[i] == 20 * 288,
+           "sudoku_solve() on a thread with engine %s", engines[i]);
+  }
+  EXPECT(started, "pthread_create() for %d threads", THREADS);
+
+  sudoku_free(context);
+  return EXIT_SUCCESS;
+}
@@ -35,7 +35,7 @@ for test_file in $TEST_FILES
 do
     base_name=$(basename "$test_file" .c)
 
-    gcc -I include -c "$test_file" && gcc -o "$base_name" "${base_name}.o" src/grid.o src/colors.o -lm
+    gcc -I include -c "$test_file" && gcc -o "$base_name" "${base_name}.o" src/grid.o src/colors.o src/alldiff.o src/cdcl.o src/dlx.o src/lean.o src/band.o src/batch.o src/pool.o src/canon.o src/cache.o src/dedup.o src/libsudoku.o -lm -pthread
 
     if [ $? -eq 0 ]; then
         if [ $? -eq 0 ]; then
@@ -80,3 +80,309 @@ do
         echo
     fi
 done
+
+echo "\nRunning option tests..."
+
+# Grid solver tests cheap enough to count all their solutions with any option
+COUNT_FILES=$(ls tests/grid-solver/*.sku | grep -v "grid-16x16-04")
+FILES=$COUNT_FILES
+
+report()
+{
+    if [ -z "$2" ]
+    then
+        echo "$bold$green[OK]$reset $blue--$reset ${blue}sudoku $1$reset"
+    else
+        echo "$bold$red[FAIL]$reset $blue--$reset ${blue}sudoku $1$reset"
+        echo "Failed on:$2"
+        echo
+    fi
+}
+
+# The options find as many solutions of each grid as the dlx engine
+check_counts()
+{
+    failed=""
+    for file in $FILES
+    do
+        expected=$(./sudoku -a -edlx $file 2> /dev/null | grep "solutions:")
+        output=$(./sudoku -a "$@" $file 2> /dev/null | grep "solutions:")
+        if [ "$output" != "$expected" ]
+        then
+            failed="$failed $file"
+        fi
+    done
+    report "-a $*" "$failed"
+}
+
+check_counts -edfs --chains=on
+check_counts -edfs --chains=off
+check_counts -edfs --pipeline=cross,lone,naked
+check_counts -edfs --pipeline=naked,cross
+
+# The options find the solution of each grid with a single one, and fail on
+# the same grids as the dlx engine
+check_first()
+{
+    failed=""
+    for file in $FILES
+    do
+        expected=$(./sudoku -edlx $file 2> /dev/null; echo "exit $?")
+        output=$(./sudoku "$@" $file 2> /dev/null; echo "exit $?")
+        if ./sudoku -a -edlx $file 2> /dev/null | grep -q "solutions: 1 "
+        then
+            [ "$output" = "$expected" ] || failed="$failed $file"
+        elif [ "${output##*exit}" != "${expected##*exit}" ]
+        then
+            failed="$failed $file"
+        fi
+    done
+    report "$*" "$failed"
+}
+
+# The options are rejected
+check_invalid()
+{
+    failed=""
+    if ./sudoku "$@" tests/grid-solver/grid-04x04-01.sku > /dev/null 2>&1
+    then
+        failed=" tests/grid-solver/grid-04x04-01.sku"
+    fi
+    report "$* (rejected)" "$failed"
+}
+
+check_counts -edfs --branch=degree
+check_counts -edfs --branch=wdeg,lcv
+check_counts -edfs --branch=random --seed=7
+check_first -edfs --branch=wdeg,random,lcv --seed=42
+check_invalid --seed=-1
+check_invalid --seed=12x
+check_invalid --branch=widest
+check_first -edfs --restarts
+check_first -edfs --restarts=geometric,16,reset --branch=wdeg
+check_invalid --restarts=luby,0
+check_invalid --restarts=luby,-5
+check_invalid --restarts=geometric,+5
+check_invalid --restarts=luby,2000000000
+check_counts -edfs --backjump
+check_counts -edfs --backjump --bitboards=on --chains=on --alldiff
+check_counts -edfs --bitboards=on
+check_first -edfs --bitboards=off
+check_invalid --bitboards=always
+check_invalid -a --checkpoint=/tmp/sudoku-tests.ckpt -edlx
+
+# The lean engine backtracks on the grids up to 25x25 only
+FILES=$(echo "$COUNT_FILES" | grep -v "grid-25x25-03\|grid-[3-6][0-9]x")
+check_counts -elean
+FILES=$COUNT_FILES
+
+check_counts -edfs
+check_first -edfs
+
+# A 9x9 grid goes to the dfs engine, whose heuristics pipeline shows with -v,
+# once one of its options is given
+failed=""
+for option in --backjump --branch=degree --chains=on --alldiff \
+              --pipeline=cross --restarts --seed=3 --bitboards=on
+do
+    if ! ./sudoku -v $option tests/grid-solver/grid-09x09-01.sku 2>&1 \
+            > /dev/null | grep -q "pipeline for size 9"
+    then
+        failed="$failed $option"
+    fi
+done
+if ./sudoku -v tests/grid-solver/grid-09x09-01.sku 2>&1 > /dev/null \
+        | grep -q "pipeline for size 9"
+then
+    failed="$failed (none)"
+fi
+report "-v OPTION (9x9 grids on dfs with its options only)" "$failed"
+
+# The first options print what the second ones print on each grid
+check_same()
+{
+    failed=""
+    for file in $FILES
+    do
+        expected=$(./sudoku $2 $file 2> /dev/null; echo "exit $?")
+        output=$(./sudoku $1 $file 2> /dev/null; echo "exit $?")
+        if [ "$output" != "$expected" ]
+        then
+            failed="$failed $file"
+        fi
+    done
+    report "$1 (as $2)" "$failed"
+}
+
+# The units of 49x49 and larger grids are propagated on a pool of threads
+FILES=$(echo "$COUNT_FILES" | grep "grid-[4-6][0-9]x")
+check_same "-t 4" "-t 1"
+check_same "-a -t 3" "-a -t 1"
+check_same "-t 2 --alldiff --chains=on" "-t 1 --alldiff --chains=on"
+check_same "-p naked,lone -t 3" "-p naked,lone -t 1"
+# Cross-hatching alone takes minutes on grid-64x64-03
+FILES=$(echo "$FILES" | grep -v "grid-64x64-03")
+check_same "-p cross -t 4" "-p cross -t 1"
+FILES=$COUNT_FILES
+
+echo "\nRunning batch tests..."
+
+TMP_DIR=$(mktemp -d)
+
+# Turn a line of a file of grids into a grid file
+line_to_grid()
+{
+    size=$(awk -v n=${#1} 'BEGIN { print int(sqrt(n) + 0.5) }')
+    echo "$1" | tr -c '1-9A-G\n' '_' | fold -w $size | sed 's/./& /g'
+}
+
+# Each grid of a file of lines has as many solutions with -l as with dlx, and
+# -l without -a prints its solution when it has a single one, '-' with none
+for lines in tests/grid-lines/grids-*.txt
+do
+    ./sudoku -a -l $lines 2> /dev/null | grep -v "search" > $TMP_DIR/counts
+    ./sudoku -l $lines 2> /dev/null > $TMP_DIR/firsts
+    failed=""
+    i=0
+    for line in $(grep -v '^#' $lines)
+    do
+        i=$((i + 1))
+        line_to_grid $line > $TMP_DIR/grid.sku
+        count=$(./sudoku -a -edlx $TMP_DIR/grid.sku 2> /dev/null \
+                    | sed -n 's/^Number of solutions: \([0-9]*\).*/\1/p')
+        first=$(sed -n "${i}p" $TMP_DIR/firsts)
+        if [ "$(sed -n "${i}p" $TMP_DIR/counts)" != "$count" ]
+        then
+            failed="$failed line_$i"
+        elif [ "$count" -eq 1 ] && [ "$first" != "$(./sudoku -edlx \
+                $TMP_DIR/grid.sku | tr -d ' \n')" ]
+        then
+            failed="$failed line_$i"
+        elif [ "$count" -eq 0 ] && [ "$first" != "-" ]
+        then
+            failed="$failed line_$i"
+        fi
+    done
+    report "-l $lines" "$failed"
+done
+
+# The grids of a class, moved by symmetries, are counted in it: each first
+# grid of the file starts a class of four
+moved=tests/grid-lines/grids-09x09-moved.txt
+expected=$(grep -v "^#" $moved | awk 'NR % 4 == 1 { print $0 " 4" }')
+failed=""
+for threads in 1 3
+do
+    if [ "$(./sudoku -D -t $threads $moved 2> /dev/null)" != "$expected" ]
+    then
+        failed="$failed -t_$threads"
+    fi
+done
+report "-D $moved" "$failed"
+
+echo "\nRunning serve tests..."
+
+# Request ID MODE on the grid of a file, with the options that follow
+request()
+{
+    echo "$1 $2 $(wc -c < $3) $4"
+    cat $3
+}
+
+# Header of the response of a request, without its timings
+status()
+{
+    head -n 1 | cut -d ' ' -f 1-3
+}
+
+# A grid solved on the server is solved as on the command line, and counted
+# as by dlx
+failed=""
+for file in $(echo "$COUNT_FILES" | grep "grid-[01][0-9]x")
+do
+    count=$(./sudoku -a -edlx $file 2> /dev/null \
+                | sed -n 's/^Number of solutions: \([0-9]*\).*/\1/p')
+    request first first $file | ./sudoku -S > $TMP_DIR/response
+    if [ "$count" -eq 0 ]
+    then
+        expected="first unsolvable 0"
+    else
+        expected="first ok 1"
+    fi
+    if [ "$(status < $TMP_DIR/response)" != "$expected" ] \
+           || { [ "$count" -ne 0 ] \
+                && [ "$(tail -n +2 $TMP_DIR/response)" != "$(./sudoku $file)" ]; }
+    then
+        failed="$failed $file"
+    fi
+    if [ "$(request all all $file | ./sudoku -S | status)" != "all ok $count" ]
+    then
+        failed="$failed $file"
+    fi
+done
+report "-S (round trip)" "$failed"
+
+# The search of mode all stops at the limit, on every engine
+line_to_grid $(sed -n 6p tests/grid-lines/grids-09x09.txt) > $TMP_DIR/grid.sku
+failed=""
+for engine in dfs cdcl dlx lean band
+do
+    request limit all $TMP_DIR/grid.sku "engine=$engine limit=5" \
+        | ./sudoku -S > $TMP_DIR/response
+    if [ "$(status < $TMP_DIR/response)" != "limit ok 5" ] \
+           || [ $(grep -c '^$' $TMP_DIR/response) -ne 5 ]
+    then
+        failed="$failed $engine"
+    fi
+done
+report "-S (limit)" "$failed"
+
+# Options rejected, each request answered on its own
+failed=""
+for options in "limit=0" "limit=x" "limit" "unknown=1" "engine=none"
+do
+    { request bad all $TMP_DIR/grid.sku "$options"; \
+      request good first tests/grid-solver/grid-09x09-01.sku; } \
+        | ./sudoku -S > $TMP_DIR/response
+    if [ "$(status < $TMP_DIR/response)" != "bad error 0" ] \
+           || [ "$(grep -c "^good ok 1" $TMP_DIR/response)" -ne 1 ]
+    then
+        failed="$failed $options"
+    fi
+done
+report "-S (invalid options)" "$failed"
+
+# A request of an unknown mode is answered with an error, the next ones are
+# served; one that cannot be framed ends its connection
+failed=""
+{ request mode any $TMP_DIR/grid.sku; \
+  request good first tests/grid-solver/grid-09x09-01.sku; } \
+    | ./sudoku -S > $TMP_DIR/response
+if [ "$(status < $TMP_DIR/response)" != "mode error 0" ] \
+       || [ "$(grep -c "^good ok 1" $TMP_DIR/response)" -ne 1 ]
+then
+    failed="$failed mode"
+fi
+{ echo "header first"; request good first tests/grid-solver/grid-09x09-01.sku; } \
+    | ./sudoku -S > $TMP_DIR/response
+if [ "$(status < $TMP_DIR/response)" != "header error 0" ] \
+       || [ "$(grep -c "^good" $TMP_DIR/response)" -ne 0 ]
+then
+    failed="$failed header"
+fi
+{ echo "long first 2000000"; cat tests/grid-solver/grid-09x09-01.sku; } \
+    | ./sudoku -S > $TMP_DIR/response
+if [ "$(status < $TMP_DIR/response)" != "long error 0" ]
+then
+    failed="$failed length"
+fi
+{ echo "short first 1000"; cat tests/grid-solver/grid-09x09-01.sku; } \
+    | ./sudoku -S > $TMP_DIR/response
+if [ "$(status < $TMP_DIR/response)" != "short error 0" ] \
+       || [ "$(tail -n 1 $TMP_DIR/response)" != "truncated grid" ]
+then
+    failed="$failed truncated"
+fi
+report "-S (framing)" "$failed"
+
+rm -rf $TMP_DIR